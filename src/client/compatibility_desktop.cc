@@ -23,6 +23,7 @@ namespace {
     GLFWcursor* cursors[int(Cursor::Last)];
 
     bool mainLoopRunning(true);
+    const int MaxIdleMs(1000);
 
     // server communication
     uWS::Hub hub;
@@ -55,6 +56,7 @@ namespace render {
         // server communication
         hub.onConnection([](uWS::WebSocket<uWS::CLIENT> *ws, uWS::HttpRequest req) {
                 serverRestarted = true;
+                glfwPostEmptyEvent();
             });
         hub.onDisconnection([](uWS::WebSocket<uWS::CLIENT> *ws, int code, char *message, size_t length) {
                 LOG("disconnected");
@@ -72,15 +74,16 @@ namespace render {
                 lock_guard<mutex> guard(serverReadMtx);
                 serverReadData.resize(serverReadData.size() + length);
                 memcpy(serverReadData.data() + serverReadData.size() - length, message, length);
+                glfwPostEmptyEvent(); // wake up the main loop
             });
         hub.connect("ws://"s + serverIp + ':' + serverPort);
         thread networking([]() { hub.run(); });
         this_thread::sleep_for(chrono::milliseconds(10));
 
-        // synchronous main loop
+        // event-driven main loop: sleeps until an input event or a message from the networking thread
         while (mainLoopRunning) {
             loop();
-            this_thread::sleep_for(chrono::milliseconds(10));
+            glfwWaitEventsTimeout(MaxIdleMs * 0.001);
         };
 
         networking.join();
@@ -88,6 +91,7 @@ namespace render {
 
     void cancelMainLoop() {
         mainLoopRunning = false;
+        glfwPostEmptyEvent(); // from the networking thread
     }
 
     int defaultWidth() {
@@ -10,6 +10,10 @@
 #include "protocol.h"
 #include "uWS.h"
 #include <thread>
+#include <cctype>
+#include <cstdlib>
+#include <strings.h>
+#include <algorithm>
 #include <sstream>
 #include <fstream>
 #include <iostream>
@@ -17,6 +21,17 @@
 using namespace std;
 using namespace prot;
 
+namespace {
+
+    // precompressed variants of documents (file.gz, file.zz next to file) are served if the client accepts them
+    struct Encoding {
+        const char* name;
+        const char* extension;
+    };
+    const Encoding encodings[] = { { "gzip", ".gz" }, { "deflate", ".zz" } };
+
+}
+
 namespace server {
 
     Server::Server():
@@ -59,11 +74,35 @@ namespace server {
                 auto urlHeader(req.getUrl());
                 auto url(string(urlHeader.value, urlHeader.valueLength));
                 if (url == "/") url = "/index.html";
+                auto acceptHeader(req.getHeader("accept-encoding"));
+                string accept(acceptHeader.value ? string(acceptHeader.value, acceptHeader.valueLength) : string());
+                // existing variant of highest quality (first one on ties)
+                const char* encoding(nullptr);
+                float quality(0);
+                ifstream file;
+                for (const auto& enc: encodings) {
+                    float q(encodingQuality(accept, enc.name));
+                    if (q > quality) {
+                        ifstream variant(documentRoot + url + enc.extension, ios::binary);
+                        if (variant) {
+                            file = move(variant);
+                            encoding = enc.name;
+                            quality = q;
+                        }
+                    }
+                }
+                if (!encoding) file.open(documentRoot + url, ios::binary);
                 stringstream ss;
-                ss << ifstream(documentRoot + url).rdbuf();
+                ss << file.rdbuf();
                 auto content(ss.str());
+                if (encoding) {
+                    // own head (the default one has no content encoding)
+                    string head("HTTP/1.1 200 OK\r\nContent-Encoding: " + string(encoding) +
+                                "\r\nVary: Accept-Encoding\r\nContent-Length: " + to_string(content.size()) + "\r\n\r\n");
+                    res->write(head.data(), head.size());
+                }
                 res->end(content.data(), content.size());
-                cout << "HTTP: " << url << endl;
+                cout << "HTTP: " << url << (encoding ? " (" + string(encoding) + ')' : string()) << endl;
             });
 
         hub.listen(port);
@@ -80,4 +119,26 @@ namespace server {
         return true;
     }
 
+    float Server::encodingQuality(const string& accept, const char* coding) {
+        // comma separated codings with optional parameters: gzip;q=0.5, deflate, *;q=0
+        float quality(-1), any(0);
+        for (size_t pos = 0; pos < accept.size(); pos++) {
+            auto end(min(accept.find(',', pos), accept.size()));
+            auto start(accept.find_first_not_of(" \t", pos));
+            pos = end;
+            if (start >= end) continue;
+            auto nameEnd(min(accept.find_first_of(" \t;", start), end));
+            float q(1);
+            for (auto param = accept.find(';', nameEnd); param < end; param = accept.find(';', param + 1)) {
+                auto p(accept.find_first_not_of(" \t", param + 1));
+                if (p < end && p + 2 < end && tolower(accept[p]) == 'q' && accept[p + 1] == '=')
+                    q = max(0.f, min(1.f, strtof(&accept[p + 2], nullptr)));
+            }
+            string name(accept, start, nameEnd - start);
+            if (!strcasecmp(name.c_str(), coding)) quality = q;
+            else if (name == "*") any = q;
+        }
+        return quality >= 0 ? quality : any;
+    }
+
 }
@@ -26,6 +26,9 @@ namespace server {
 
         const std::string& getDocumentRoot() const { return documentRoot; }
 
+        // quality (0 to 1) of a content coding in an Accept-Encoding header: its q-value, or the one of "*"
+        static float encodingQuality(const std::string& acceptEncoding, const char* coding);
+
     private:
         // resources
         std::string documentRoot;
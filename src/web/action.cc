@@ -10,7 +10,16 @@
 #include "widget.h"
 #include "context.h"
 #include "ml_parser.h"
+#include "display_list.h"
 #include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <unordered_set>
+
+// threaded dispatch (labels as values) when the compiler supports it, switch otherwise
+#if defined(__GNUC__) || defined(__clang__)
+#  define THREADED_DISPATCH
+#endif
 
 using namespace std;
 using namespace webui;
@@ -21,6 +30,7 @@ namespace {
     Stack stack;
     vector<int> locations;
     Widget* execWidget;
+    Widget* ptrWidget;               // widget of the last property pointer pushed (assignments make it dirty)
 
     Type VoidPrototype[] =         { Type::LastType };
     Type FloatPrototype[] =        { Type::Float,   Type::LastType };
@@ -39,86 +49,88 @@ namespace {
     Type TextCharPtrPrototype[] =  { Type::Text,    Type::Float,    Type::Float, Type::LastType };
     Type QueryPrototype[] =        { Type::Id,      Type::StrId,    Type::LastType };
     Type AssignPrototype[] =       { Type::Unknown, Type::VoidPtr,  Type::LastType };
+    Type RectColorPrototype[] =    { Type::Color,   Type::Float,    Type::Float, Type::Float, Type::Float, Type::Float, Type::LastType };
+    Type RectVertGradPrototype[] = { Type::Color,   Type::Color,    Type::Float, Type::Float,
+                                     Type::Float,   Type::Float,    Type::Float, Type::Float, Type::Float, Type::LastType };
 
-    void FunctionError() {
+    StackFrame* FunctionError(StackFrame* sp) {
         DIAG(LOG("error function"));
+        return sp;
     }
 
-    void FunctionBeginPath() {
+    StackFrame* FunctionBeginPath(StackFrame* sp) {
         Context::render.beginPath();
+        return sp;
     }
 
-    void FunctionMoveto() {
-        assert(stack.size() >= 2);
-        auto* s(&stack.back() - 1);
-        Context::render.moveto(s[0].f, s[1].f);
-        stack.resize(stack.size() - 2);
+    StackFrame* FunctionMoveto(StackFrame* sp) {
+        sp -= 2;
+        Context::render.moveto(sp[0].f, sp[1].f);
+        return sp;
     }
 
-    void FunctionLineto() {
-        assert(stack.size() >= 2);
-        auto* s(&stack.back() - 1);
-        Context::render.lineto(s[0].f, s[1].f);
-        stack.resize(stack.size() - 2);
+    StackFrame* FunctionLineto(StackFrame* sp) {
+        sp -= 2;
+        Context::render.lineto(sp[0].f, sp[1].f);
+        return sp;
     }
 
-    void FunctionBezierto() {
-        assert(stack.size() >= 6);
-        auto* s(&stack.back() - 5);
-        Context::render.bezierto(s[0].f, s[1].f, s[2].f, s[3].f, s[4].f, s[5].f);
-        stack.resize(stack.size() - 6);
+    StackFrame* FunctionBezierto(StackFrame* sp) {
+        sp -= 6;
+        Context::render.bezierto(sp[0].f, sp[1].f, sp[2].f, sp[3].f, sp[4].f, sp[5].f);
+        return sp;
     }
 
-    void FunctionClosePath() {
+    StackFrame* FunctionClosePath(StackFrame* sp) {
         Context::render.beginPath();
+        return sp;
     }
 
-    void FunctionRoundedRect() {
-        assert(stack.size() >= 5);
-        auto* s(&stack.back() - 4);
-        Context::render.roundedRect(s[0].f, s[1].f, s[2].f, s[3].f, s[4].f);
-        stack.resize(stack.size() - 5);
+    StackFrame* FunctionRoundedRect(StackFrame* sp) {
+        sp -= 5;
+        Context::render.roundedRect(sp[0].f, sp[1].f, sp[2].f, sp[3].f, sp[4].f);
+        return sp;
     }
 
-    void FunctionFillColor() {
-        assert(stack.size() >= 1);
-        Context::render.fillColor(stack.back().color);
-        stack.pop_back();
+    StackFrame* FunctionFillColor(StackFrame* sp) {
+        --sp;
+        Context::render.fillColor(sp[0].color);
+        return sp;
     }
 
-    void FunctionFillVertGrad() {
-        assert(stack.size() >= 4);
-        auto* s(&stack.back() - 3);
-        Context::render.fillVertGrad(s[0].f, s[1].f, s[2].color, s[3].color);
-        stack.resize(stack.size() - 4);
+    StackFrame* FunctionFillVertGrad(StackFrame* sp) {
+        sp -= 4;
+        Context::render.fillVertGrad(sp[0].f, sp[1].f, sp[2].color, sp[3].color);
+        return sp;
     }
 
-    void FunctionFill() {
+    StackFrame* FunctionFill(StackFrame* sp) {
         Context::render.fill();
+        return sp;
     }
 
-    void FunctionStrokeWidth() {
-        assert(stack.size() >= 1);
-        Context::render.strokeWidth(stack.back().f);
-        stack.pop_back();
+    StackFrame* FunctionStrokeWidth(StackFrame* sp) {
+        --sp;
+        Context::render.strokeWidth(sp[0].f);
+        return sp;
     }
 
-    void FunctionStrokeColor() {
-        assert(stack.size() >= 1);
-        Context::render.strokeColor(stack.back().color);
-        stack.pop_back();
+    StackFrame* FunctionStrokeColor(StackFrame* sp) {
+        --sp;
+        Context::render.strokeColor(sp[0].color);
+        return sp;
     }
 
-    void FunctionStroke() {
+    StackFrame* FunctionStroke(StackFrame* sp) {
         Context::render.stroke();
+        return sp;
     }
 
-    void FunctionFont() {
-        assert(stack.size() >= 2);
-        auto* s(&stack.back() - 1);
-        Context::render.font(s[0].l);
-        Context::render.fontSize(s[1].f);
-        stack.resize(stack.size() - 2);
+    StackFrame* FunctionFont(StackFrame* sp) {
+        sp -= 2;
+        Context::render.font(sp[0].l);
+        Context::render.fontSize(sp[1].f);
+        return sp;
     }
 
     inline float FunctionTextCommon(float x, float y, const char* text) {
@@ -128,20 +140,16 @@ namespace {
         return Context::render.text(pos.x, pos.y, text);
     }
 
-    void FunctionText() {
-        assert(stack.size() >= 3);
-        auto* s(&stack.back() - 2);
-        float end(FunctionTextCommon(s[0].f, s[1].f, Context::strMng.get(s[2].l)));
-        stack.resize(stack.size() - 2);
-        stack.back().f = end;
+    StackFrame* FunctionText(StackFrame* sp) {
+        sp -= 3;
+        sp[0].f = FunctionTextCommon(sp[0].f, sp[1].f, Context::strMng.get(sp[2].l));
+        return sp + 1;
     }
 
-    void FunctionTextCharPtr() {
-        assert(stack.size() >= 3);
-        auto* s(&stack.back() - 2);
-        float end(FunctionTextCommon(s[0].f, s[1].f, s[2].text));
-        stack.resize(stack.size() - 2);
-        stack.back().f = end;
+    StackFrame* FunctionTextCharPtr(StackFrame* sp) {
+        sp -= 3;
+        sp[0].f = FunctionTextCommon(sp[0].f, sp[1].f, sp[2].text);
+        return sp + 1;
     }
 
     inline float FunctionTextLeftCommon(float x, float y, const char* text) {
@@ -152,160 +160,218 @@ namespace {
         return Context::render.text(pos.x, pos.y, text);
     }
 
-    void FunctionTextLeft() {
-        assert(stack.size() >= 3);
-        auto* s(&stack.back() - 2);
-        float end(FunctionTextLeftCommon(s[0].f, s[1].f, Context::strMng.get(s[2].l)));
-        stack.resize(stack.size() - 2);
-        stack.back().f = end;
+    StackFrame* FunctionTextLeft(StackFrame* sp) {
+        sp -= 3;
+        sp[0].f = FunctionTextLeftCommon(sp[0].f, sp[1].f, Context::strMng.get(sp[2].l));
+        return sp + 1;
     }
 
-    void FunctionTextLeftCharPtr() {
-        assert(stack.size() >= 3);
-        auto* s(&stack.back() - 2);
-        float end(FunctionTextLeftCommon(s[0].f, s[1].f, s[2].text));
-        stack.resize(stack.size() - 2);
-        stack.back().f = end;
+    StackFrame* FunctionTextLeftCharPtr(StackFrame* sp) {
+        sp -= 3;
+        sp[0].f = FunctionTextLeftCommon(sp[0].f, sp[1].f, sp[2].text);
+        return sp + 1;
     }
 
-    void FunctionTextWidth() {
-        assert(stack.size() >= 1);
-        stack.back().f = Context::render.textWidth(Context::strMng.get(stack.back().l));
+    StackFrame* FunctionTextWidth(StackFrame* sp) {
+        sp[-1].f = Context::render.textWidth(Context::strMng.get(sp[-1].l));
+        return sp;
     }
 
-    void FunctionTextWidthCPtr() {
-        assert(stack.size() >= 1);
-        stack.back().f = Context::render.textWidth(stack.back().text);
+    StackFrame* FunctionTextWidthCPtr(StackFrame* sp) {
+        sp[-1].f = Context::render.textWidth(sp[-1].text);
+        return sp;
     }
 
-    void FunctionTranslate() {
-        assert(stack.size() >= 2);
-        auto* s(&stack.back() - 1);
-        Context::render.translate(s[0].f, s[1].f);
-        stack.resize(stack.size() - 2);
+    StackFrame* FunctionTranslate(StackFrame* sp) {
+        sp -= 2;
+        Context::render.translate(sp[0].f, sp[1].f);
+        return sp;
     }
 
-    void FunctionScale() {
-        assert(stack.size() >= 1);
-        Context::render.scale(stack.back().f, stack.back().f);
-        stack.pop_back();
+    StackFrame* FunctionScale(StackFrame* sp) {
+        --sp;
+        Context::render.scale(sp[0].f, sp[0].f);
+        return sp;
     }
 
-    void FunctionResetTransform() {
+    StackFrame* FunctionResetTransform(StackFrame* sp) {
         Context::render.resetTransform();
+        return sp;
     }
 
-    void FunctionScissor() {
-        assert(stack.size() >= 4);
-        auto* s(&stack.back() - 3);
-        Context::render.scissor(s[0].f, s[1].f, s[2].f, s[3].f);
-        stack.resize(stack.size() - 4);
+    StackFrame* FunctionScissor(StackFrame* sp) {
+        sp -= 4;
+        Context::render.scissor(sp[0].f, sp[1].f, sp[2].f, sp[3].f);
+        return sp;
     }
 
-    void FunctionResetScissor() {
+    StackFrame* FunctionResetScissor(StackFrame* sp) {
         Context::render.resetScissor();
+        return sp;
     }
 
-    void FunctionQuery() {
-        assert(stack.size() >= 2);
-        auto* s(&stack.back() - 1);
-        if (!Context::app.executeQuery(s[0].strId, s[1].strId))
+    StackFrame* FunctionQuery(StackFrame* sp) {
+        sp -= 2;
+        // template execution could run nested programs: they start again from the stack base,
+        // which is safe as query is a statement and there is nothing below its parameters
+        if (!Context::app.executeQuery(sp[0].strId, sp[1].strId))
             DIAG(LOG("error executing query"));
-        stack.clear(); // template execution could be messing with the stack: stack.resize(stack.size() - 2);
+        return sp;
     }
 
-    void FunctionTriggerTimers() {
+    StackFrame* FunctionTriggerTimers(StackFrame* sp) {
         Context::app.triggerTimers();
+        return sp;
     }
 
-    void FunctionLog() {
-        LOG("%s", Context::strMng.get(stack.back().strId));
-        stack.pop_back();
+    StackFrame* FunctionLog(StackFrame* sp) {
+        --sp;
+        LOG("%s", Context::strMng.get(sp[0].strId));
+        return sp;
     }
 
-    void FunctionAdd() {
-        float f(stack.back().f);
-        stack.pop_back();
-        stack.back().f += f;
+    StackFrame* FunctionAdd(StackFrame* sp) {
+        sp[-2].f += sp[-1].f;
+        return sp - 1;
     }
 
-    void FunctionSub() {
-        float f(stack.back().f);
-        stack.pop_back();
-        stack.back().f -= f;
+    StackFrame* FunctionSub(StackFrame* sp) {
+        sp[-2].f -= sp[-1].f;
+        return sp - 1;
     }
 
-    void FunctionMul() {
-        float f(stack.back().f);
-        stack.pop_back();
-        stack.back().f *= f;
+    StackFrame* FunctionMul(StackFrame* sp) {
+        sp[-2].f *= sp[-1].f;
+        return sp - 1;
     }
 
-    void FunctionDiv() {
-        float f(stack.back().f);
-        stack.pop_back();
-        stack.back().f /= f;
+    StackFrame* FunctionDiv(StackFrame* sp) {
+        sp[-2].f /= sp[-1].f;
+        return sp - 1;
     }
 
-    void FunctionMod() {
-        float f(stack.back().f);
-        stack.pop_back();
-        stack.back().color.multRGB(f * 2.56f);
+    StackFrame* FunctionMod(StackFrame* sp) {
+        sp[-2].color.multRGB(sp[-1].f * 2.56f);
+        return sp - 1;
     }
 
-    void FunctionAssignUint32() {
-        assert(stack.size() >= 2);
-        auto* s(&stack.back() - 1);
-        *reinterpret_cast<uint32_t*>(s[0].voidPtr) = s[1].u32;
-        stack.resize(stack.size() - 2);
+    // properties of the widget class can change its layout; user ones (defined in ML, after the class) are
+    // only painted and need a new frame
+    void assigned(const void* ptr) {
+        const TypeWidget* type(ptrWidget->typeWidget);
+        while (type->getBase() && type->type != ptrWidget->baseType()) type = type->getBase();
+        if (reinterpret_cast<const char*>(ptr) - reinterpret_cast<const char*>(ptrWidget) < type->size)
+            ptrWidget->setLayoutDirty();
+        else
+            ctx.forceRender();
+    }
+
+    // unchanged values do not make anything dirty (onRender assignments would never let the layout settle)
+    template <typename T>
+    inline StackFrame* assign(StackFrame* sp, T value) {
+        T& dst(*reinterpret_cast<T*>(sp[0].voidPtr));
+        if (memcmp(&dst, &value, sizeof(T))) {
+            dst = value;
+            assigned(&dst);
+        }
+        return sp;
     }
 
-    void FunctionAssignSizeRel() {
-        assert(stack.size() >= 2);
-        auto* s(&stack.back() - 1);
-        *reinterpret_cast<SizeRelative*>(s[0].voidPtr) = SizeRelative(s[1].f < 0 ? -s[1].f : s[1].f, s[1].f < 0);
-        stack.resize(stack.size() - 2);
+    StackFrame* FunctionAssignUint32(StackFrame* sp) {
+        sp -= 2;
+        return assign(sp, sp[1].u32);
     }
 
-    void FunctionAssignUint8() {
-        assert(stack.size() >= 2);
-        auto* s(&stack.back() - 1);
-        *reinterpret_cast<uint8_t*>(s[0].voidPtr) = uint8_t(s[1].f);
-        stack.resize(stack.size() - 2);
+    StackFrame* FunctionAssignSizeRel(StackFrame* sp) {
+        sp -= 2;
+        return assign(sp, SizeRelative(sp[1].f < 0 ? -sp[1].f : sp[1].f, sp[1].f < 0));
     }
 
-    void FunctionAssignInt16() {
-        assert(stack.size() >= 2);
-        auto* s(&stack.back() - 1);
-        *reinterpret_cast<int16_t*>(s[0].voidPtr) = int16_t(s[1].f);
-        stack.resize(stack.size() - 2);
+    StackFrame* FunctionAssignUint8(StackFrame* sp) {
+        sp -= 2;
+        return assign(sp, uint8_t(sp[1].f));
     }
 
-    void FunctionAssignInt32() {
-        assert(stack.size() >= 2);
-        auto* s(&stack.back() - 1);
-        *reinterpret_cast<int32_t*>(s[0].voidPtr) = int32_t(s[1].f);
-        stack.resize(stack.size() - 2);
+    StackFrame* FunctionAssignInt16(StackFrame* sp) {
+        sp -= 2;
+        return assign(sp, int16_t(sp[1].f));
     }
 
-    void FunctionAssignText() {
-        assert(stack.size() >= 2);
-        auto* s(&stack.back() - 1);
-        char*& text(*reinterpret_cast<char**>(s[0].voidPtr));
+    StackFrame* FunctionAssignInt32(StackFrame* sp) {
+        sp -= 2;
+        return assign(sp, int32_t(sp[1].f));
+    }
+
+    StackFrame* FunctionAssignText(StackFrame* sp) {
+        sp -= 2;
+        char*& text(*reinterpret_cast<char**>(sp[0].voidPtr));
+        if (text && sp[1].text && !strcmp(text, sp[1].text)) return sp;
         free(text);
-        text = strdup(s[1].text);
-        stack.resize(stack.size() - 2);
+        text = strdup(sp[1].text);
+        assigned(&text);
+        return sp;
     }
 
     template <int bit>
-    void FunctionAssignBit() {
-        assert(stack.size() >= 2);
-        auto* s(&stack.back() - 1);
-        if (s[1].f > 0.5f)
-            *reinterpret_cast<uint8_t*>(s[0].voidPtr) |= 1 << bit;
-        else
-            *reinterpret_cast<uint8_t*>(s[0].voidPtr) &= ~(1 << bit);
-        stack.resize(stack.size() - 2);
+    StackFrame* FunctionAssignBit(StackFrame* sp) {
+        sp -= 2;
+        uint8_t bits(*reinterpret_cast<uint8_t*>(sp[0].voidPtr));
+        return assign(sp, uint8_t(sp[1].f > 0.5f ? bits | 1 << bit : bits & ~(1 << bit)));
+    }
+
+    StackFrame* FunctionBeginPathRoundedRect(StackFrame* sp) {
+        sp -= 5;
+        Context::render.beginPath();
+        Context::render.roundedRect(sp[0].f, sp[1].f, sp[2].f, sp[3].f, sp[4].f);
+        return sp;
+    }
+
+    StackFrame* FunctionFillColorFill(StackFrame* sp) {
+        --sp;
+        Context::render.fillColor(sp[0].color);
+        Context::render.fill();
+        return sp;
+    }
+
+    StackFrame* FunctionFillVertGradFill(StackFrame* sp) {
+        sp -= 4;
+        Context::render.fillVertGrad(sp[0].f, sp[1].f, sp[2].color, sp[3].color);
+        Context::render.fill();
+        return sp;
+    }
+
+    StackFrame* FunctionStrokeColorStroke(StackFrame* sp) {
+        --sp;
+        Context::render.strokeColor(sp[0].color);
+        Context::render.stroke();
+        return sp;
+    }
+
+    StackFrame* FunctionRoundedRectFill(StackFrame* sp) {
+        sp -= 6;
+        Context::render.beginPath();
+        Context::render.roundedRect(sp[0].f, sp[1].f, sp[2].f, sp[3].f, sp[4].f);
+        Context::render.fillColor(sp[5].color);
+        Context::render.fill();
+        return sp;
+    }
+
+    StackFrame* FunctionRoundedRectFillVertGrad(StackFrame* sp) {
+        sp -= 9;
+        Context::render.beginPath();
+        Context::render.roundedRect(sp[0].f, sp[1].f, sp[2].f, sp[3].f, sp[4].f);
+        Context::render.fillVertGrad(sp[5].f, sp[6].f, sp[7].color, sp[8].color);
+        Context::render.fill();
+        return sp;
+    }
+
+    StackFrame* FunctionRoundedRectStroke(StackFrame* sp) {
+        sp -= 6;
+        Context::render.beginPath();
+        Context::render.roundedRect(sp[0].f, sp[1].f, sp[2].f, sp[3].f, sp[4].f);
+        Context::render.strokeColor(sp[5].color);
+        Context::render.stroke();
+        return sp;
     }
 
     const struct FunctionList {
@@ -361,8 +427,41 @@ namespace {
         { Identifier::assign,          FunctionAssignBit<5>,   AssignPrototype,       Type::LastType },
         { Identifier::assign,          FunctionAssignBit<6>,   AssignPrototype,       Type::LastType },
         { Identifier::assign,          FunctionAssignBit<7>,   AssignPrototype,       Type::LastType },
+        // superinstructions: named after an already listed function so they are never found by name
+        { Identifier::roundedRect,     FunctionBeginPathRoundedRect,    Float5Prototype,       Type::LastType },
+        { Identifier::fill,            FunctionFillColorFill,           ColorPrototype,        Type::LastType },
+        { Identifier::fill,            FunctionFillVertGradFill,        FillVertGradPrototype, Type::LastType },
+        { Identifier::stroke,          FunctionStrokeColorStroke,       ColorPrototype,        Type::LastType },
+        { Identifier::fill,            FunctionRoundedRectFill,         RectColorPrototype,    Type::LastType },
+        { Identifier::fill,            FunctionRoundedRectFillVertGrad, RectVertGradPrototype, Type::LastType },
+        { Identifier::stroke,          FunctionRoundedRectStroke,       RectColorPrototype,    Type::LastType },
     };
 
+    // superinstructions: a call to first, the evaluation of the arguments of second and the call to second
+    // become the evaluation of the arguments of second and a call to fused (that calls first and second)
+    const struct Fusion {
+        Function first, second, fused;
+    } fusionList[] = {
+        { Function::BeginPath,            Function::RoundedRect,       Function::BeginPathRoundedRect },
+        { Function::FillColor,            Function::Fill,              Function::FillColorFill },
+        { Function::FillVertGrad,         Function::Fill,              Function::FillVertGradFill },
+        { Function::StrokeColor,          Function::Stroke,            Function::StrokeColorStroke },
+        { Function::BeginPathRoundedRect, Function::FillColorFill,     Function::RoundedRectFill },
+        { Function::BeginPathRoundedRect, Function::FillVertGradFill,  Function::RoundedRectFillVertGrad },
+        { Function::BeginPathRoundedRect, Function::StrokeColorStroke, Function::RoundedRectStroke },
+    };
+
+    // functions without side effects: can be folded and can be moved around
+    inline bool isPure(int iFunction) {
+        return iFunction >= int(Function::Add) && iFunction <= int(Function::Mod);
+    }
+
+    inline int paramCount(int iFunction) {
+        int n(0);
+        for (const Type* proto = functionList[iFunction].prototype; *proto != Type::LastType; proto++) n++;
+        return n;
+    }
+
     DIAG(const char* toString(Function func) {
             return Context::strMng.get(functionList[int(func)].id);
         });
@@ -390,17 +489,66 @@ namespace webui {
         actions(1, Command(Instruction::Return)) {
     }
 
+    int Actions::instructionSize(const Command& com) {
+        switch (com.inst()) {
+        case Instruction::PushConstant:                return 2 + com.param;
+        case Instruction::PushParentProperty:
+        case Instruction::PushParentPropertyPtr:       return 2;
+        case Instruction::PushForeignProperty:
+        case Instruction::PushForeignPropertyPtr:
+        case Instruction::PushDoubleProperty:
+        case Instruction::PushDoublePropertyPtr:       return 2 + DispatchCacheSize;
+        case Instruction::PushDoubleParentProperty:
+        case Instruction::PushDoubleParentPropertyPtr: return 3 + DispatchCacheSize;
+        default:                                       return 1;
+        }
+    }
+
     int Actions::add(MLParser& parser, int iEntry, int fEntry) {
         int dev(actions.size());
         if (parser[iEntry].type() == MLParser::EntryType::List) iEntry++; // list
         if (!addRecur(parser, iEntry, fEntry)) return 0;
+        // one frame is kept for the property pointer that evalProperty() pushes in front of the program
+        if (stackDepth(dev, actions.size()) >= Stack::Capacity) {
+            DIAG(LOG("action needs more than %d stack frames", Stack::Capacity - 1));
+            actions.resize(dev);
+            return 0;
+        }
         actions.push_back(Command(Instruction::Return));
         return dev;
     }
 
+    int Actions::stackDepth(int iAction, int fAction) const {
+        // upper bound before property resolution: an argument can take two frames (widget.property or string view)
+        vector<int> args; // frames taken by each argument in the stack
+        int depth(0), maxDepth(0);
+        while (iAction < fAction) {
+            const auto& com(actions[iAction]);
+            if (com.inst() == Instruction::PushConstant) {
+                args.push_back(1 + com.param);
+                depth += args.back();
+                iAction += com.param + 1;
+            } else if (com.inst() == Instruction::FunctionCall) {
+                const auto& func(functionList[com.param]);
+                for (const Type* proto = func.prototype; *proto != Type::LastType && !args.empty(); proto++) {
+                    depth -= args.back();
+                    args.pop_back();
+                }
+                if (func.retType != Type::LastType) {
+                    args.push_back(1);
+                    depth++;
+                }
+            }
+            maxDepth = max(maxDepth, depth);
+            ++iAction;
+        }
+        return maxDepth;
+    }
+
     template <bool DryRun>
     bool Actions::execute(int iAction, Widget* widget) {
         if (!iAction) return true;
+        if (!DryRun) return run(iAction, widget);
         DIAG(int iActionOrig(iAction));
         //DIAG(LOG("execute on %p: %s", widget, DryRun ? "dry run" : "for real"); dump(iAction));
         stack.clear();
@@ -428,70 +576,81 @@ namespace webui {
                 stack.push_back(StackFrame(getPropertyData(widget, action)));
                 if (DryRun) locations.push_back(iAction);
                 break;
-            case Instruction::PushForeignProperty:
-                stack.push_back(StackFrame(getPropertyData(actions[iAction + 1].widget, action)));
+            case Instruction::PushForeignProperty: {
+                auto* resolved(resolveWidget(actions[iAction + 1].strId));
+                if (!resolved) return false;
+                stack.push_back(StackFrame(getPropertyData(resolved, action)));
                 if (DryRun) locations.push_back(iAction);
-                ++iAction;
+                iAction += 1 + DispatchCacheSize;
                 break;
+            }
             case Instruction::PushDoubleProperty: {
-                auto* resolved(resolveDoubleDispatch(actions[iAction + 1].l, widget));
+                auto* resolved(resolveWidget(reinterpret_cast<StringId*>(widget)[actions[iAction + 1].l]));
                 DIAG(if (!resolved) { LOG("double dispatch failed"); return false; });
                 stack.push_back(StackFrame(getPropertyData(resolved, action)));
                 if (DryRun) locations.push_back(iAction);
-                iAction += 2;
+                iAction += 1 + DispatchCacheSize;
                 break;
             }
             case Instruction::PushParentProperty: {
                 auto* parent(ancestor(widget, actions[iAction + 1].l));
                 stack.push_back(StackFrame(getPropertyData(parent, action)));
                 if (DryRun) locations.push_back(iAction);
+                ++iAction;
                 break;
             }
             case Instruction::PushDoubleParentProperty: {
                 auto* parent(ancestor(widget, actions[iAction + 2].l));
-                auto* resolved(resolveDoubleDispatch(actions[iAction + 1].l, parent));
+                auto* resolved(resolveWidget(reinterpret_cast<StringId*>(parent)[actions[iAction + 1].l]));
                 DIAG(if (!resolved) { LOG("double parent dispatch failed"); return false; });
                 stack.push_back(StackFrame(getPropertyData(resolved, action)));
                 if (DryRun) locations.push_back(iAction);
-                iAction += 2;
+                iAction += 2 + DispatchCacheSize;
                 break;
             }
             case Instruction::PushPropertyPtr:
+                ptrWidget = widget;
                 stack.push_back(StackFrame(long(widget) + action.param));
                 if (DryRun) locations.push_back(iAction);
                 break;
-            case Instruction::PushForeignPropertyPtr:
-                stack.push_back(StackFrame(actions[iAction + 1].l + action.param));
+            case Instruction::PushForeignPropertyPtr: {
+                auto* resolved(resolveWidget(actions[iAction + 1].strId));
+                if (!resolved) return false;
+                ptrWidget = resolved;
+                stack.push_back(StackFrame(long(resolved) + action.param));
                 if (DryRun) locations.push_back(iAction);
-                ++iAction;
+                iAction += 1 + DispatchCacheSize;
                 break;
+            }
             case Instruction::PushDoublePropertyPtr: {
-                auto* resolved(resolveDoubleDispatch(actions[iAction + 1].l, widget));
+                auto* resolved(resolveWidget(reinterpret_cast<StringId*>(widget)[actions[iAction + 1].l]));
                 DIAG(if (!resolved) { LOG("double dispatch ptr failed"); return false; });
+                ptrWidget = resolved;
                 stack.push_back(StackFrame(long(resolved) + action.param));
                 if (DryRun) locations.push_back(iAction);
-                iAction += 2;
+                iAction += 1 + DispatchCacheSize;
                 break;
             }
             case Instruction::PushParentPropertyPtr: {
                 auto* parent(ancestor(widget, actions[iAction + 1].l));
+                ptrWidget = parent;
                 stack.push_back(StackFrame(long(parent) + action.param));
                 if (DryRun) locations.push_back(iAction);
+                ++iAction;
                 break;
             }
             case Instruction::PushDoubleParentPropertyPtr: {
                 auto* parent(ancestor(widget, actions[iAction + 2].l));
-                auto* resolved(resolveDoubleDispatch(actions[iAction + 1].l, parent));
+                auto* resolved(resolveWidget(reinterpret_cast<StringId*>(parent)[actions[iAction + 1].l]));
                 DIAG(if (!resolved) { LOG("double parent dispatch ptr failed"); return false; });
+                ptrWidget = resolved;
                 stack.push_back(StackFrame(long(resolved) + action.param));
                 if (DryRun) locations.push_back(iAction);
-                iAction += 2;
+                iAction += 2 + DispatchCacheSize;
                 break;
             }
             case Instruction::FunctionCall: {
-                auto& func(functionList[action.param]);
-                if (!DryRun) func.func();
-                else if (!checkFunctionParams(action.param, iAction, widget)) {
+                if (!checkFunctionParams(action.param, iAction, widget)) {
                     DIAG(LOG("failed dry run"); dump(iActionOrig));
                     return false;
                 }
@@ -505,6 +664,354 @@ namespace webui {
         }
     }
 
+    bool Actions::run(int iAction, Widget* widget) {
+        Command* pc(&actions[iAction]);
+        StackFrame* sp(stack.frames);
+        execWidget = widget;
+
+#ifdef THREADED_DISPATCH
+        // same order as enum Instruction
+        static const void* dispatchTable[] = {
+            &&LabelReturn,
+            &&LabelNop,
+            &&LabelPushConstant,
+            &&LabelPushProperty,
+            &&LabelPushForeignProperty,
+            &&LabelPushDoubleProperty,
+            &&LabelPushParentProperty,
+            &&LabelPushDoubleParentProperty,
+            &&LabelPushPropertyPtr,
+            &&LabelPushForeignPropertyPtr,
+            &&LabelPushDoublePropertyPtr,
+            &&LabelPushParentPropertyPtr,
+            &&LabelPushDoubleParentPropertyPtr,
+            &&LabelFunctionCall,
+        };
+#  define DISPATCH_BEGIN     goto *dispatchTable[pc->instruction];
+#  define DISPATCH_END
+#  define INSTRUCTION(inst)  Label##inst:
+#  define NEXT(n)            pc += n; goto *dispatchTable[pc->instruction]
+#else
+#  define DISPATCH_BEGIN     while (true) switch (pc->inst()) {
+#  define DISPATCH_END       default: DIAG(LOG("unknown instruction: %d", pc->instruction)); abort(); }
+#  define INSTRUCTION(inst)  case Instruction::inst:
+#  define NEXT(n)            pc += n; break
+#endif
+
+        DISPATCH_BEGIN
+            INSTRUCTION(Return) {
+                stack.sp = sp;
+                return true;
+            }
+            INSTRUCTION(Nop) {
+                NEXT(1);
+            }
+            INSTRUCTION(PushConstant) {
+                (sp++)->l = pc[1].l;
+                if (pc->param) {
+                    (sp++)->l = pc[2].l;
+                    NEXT(3);
+                }
+                NEXT(2);
+            }
+            INSTRUCTION(PushProperty) {
+                (sp++)->l = getPropertyData(widget, *pc);
+                NEXT(1);
+            }
+            INSTRUCTION(PushForeignProperty) {
+                auto* resolved(resolveWidgetCached(pc[1].strId, pc + 2));
+                if (!resolved) { stack.sp = sp; return false; } // destroyed
+                (sp++)->l = getPropertyData(resolved, *pc);
+                NEXT(2 + DispatchCacheSize);
+            }
+            INSTRUCTION(PushDoubleProperty) {
+                auto* resolved(resolveWidgetCached(reinterpret_cast<StringId*>(widget)[pc[1].l], pc + 2));
+                DIAG(if (!resolved) { LOG("double dispatch failed"); stack.sp = sp; return false; });
+                (sp++)->l = getPropertyData(resolved, *pc);
+                NEXT(2 + DispatchCacheSize);
+            }
+            INSTRUCTION(PushParentProperty) {
+                (sp++)->l = getPropertyData(ancestor(widget, pc[1].l), *pc);
+                NEXT(2);
+            }
+            INSTRUCTION(PushDoubleParentProperty) {
+                auto* resolved(resolveWidgetCached(reinterpret_cast<StringId*>(ancestor(widget, pc[2].l))[pc[1].l], pc + 3));
+                DIAG(if (!resolved) { LOG("double parent dispatch failed"); stack.sp = sp; return false; });
+                (sp++)->l = getPropertyData(resolved, *pc);
+                NEXT(3 + DispatchCacheSize);
+            }
+            INSTRUCTION(PushPropertyPtr) {
+                ptrWidget = widget;
+                (sp++)->l = long(widget) + pc->param;
+                NEXT(1);
+            }
+            INSTRUCTION(PushForeignPropertyPtr) {
+                auto* resolved(resolveWidgetCached(pc[1].strId, pc + 2));
+                if (!resolved) { stack.sp = sp; return false; } // destroyed
+                ptrWidget = resolved;
+                (sp++)->l = long(resolved) + pc->param;
+                NEXT(2 + DispatchCacheSize);
+            }
+            INSTRUCTION(PushDoublePropertyPtr) {
+                auto* resolved(resolveWidgetCached(reinterpret_cast<StringId*>(widget)[pc[1].l], pc + 2));
+                DIAG(if (!resolved) { LOG("double dispatch ptr failed"); stack.sp = sp; return false; });
+                ptrWidget = resolved;
+                (sp++)->l = long(resolved) + pc->param;
+                NEXT(2 + DispatchCacheSize);
+            }
+            INSTRUCTION(PushParentPropertyPtr) {
+                ptrWidget = ancestor(widget, pc[1].l);
+                (sp++)->l = long(ptrWidget) + pc->param;
+                NEXT(2);
+            }
+            INSTRUCTION(PushDoubleParentPropertyPtr) {
+                auto* resolved(resolveWidgetCached(reinterpret_cast<StringId*>(ancestor(widget, pc[2].l))[pc[1].l], pc + 3));
+                DIAG(if (!resolved) { LOG("double parent dispatch ptr failed"); stack.sp = sp; return false; });
+                ptrWidget = resolved;
+                (sp++)->l = long(resolved) + pc->param;
+                NEXT(3 + DispatchCacheSize);
+            }
+            INSTRUCTION(FunctionCall) {
+                sp = functionList[pc->param].func(sp);
+                NEXT(1);
+            }
+        DISPATCH_END
+
+#undef DISPATCH_BEGIN
+#undef DISPATCH_END
+#undef INSTRUCTION
+#undef NEXT
+    }
+
+    int Actions::optimize(int iAction) {
+        if (!iAction) return 0;
+
+        // decode, dropping padding and folding pure functions with constant arguments
+        struct Op {
+            Command com[3 + DispatchCacheSize];
+            int n;
+        };
+        vector<Op> ops;
+        int i(iAction);
+        DIAG(int before(0));
+        for (; actions[i].inst() != Instruction::Return; i += instructionSize(actions[i])) {
+            DIAG(before++);
+            const auto& com(actions[i]);
+            if (com.inst() == Instruction::Nop) continue;
+            if (com.inst() == Instruction::FunctionCall && isPure(com.param)) {
+                const auto& func(functionList[com.param]);
+                int nParams(paramCount(com.param)), iOp(int(ops.size()) - nParams);
+                bool constant(iOp >= 0);
+                for (int p = 0; constant && p < nParams; p++) {
+                    const auto& arg(ops[iOp + p].com[0]);
+                    constant = arg.inst() == Instruction::PushConstant && !arg.param &&
+                        arg.type() == func.prototype[nParams - 1 - p];
+                }
+                if (constant) {
+                    StackFrame frames[Stack::Capacity];
+                    for (int p = 0; p < nParams; p++) frames[p].l = ops[iOp + p].com[1].l;
+                    func.func(frames + nParams);
+                    ops.resize(iOp + 1);
+                    ops.back().com[0] = Command(Instruction::PushConstant, func.retType);
+                    ops.back().com[1] = Command(frames[0].l);
+                    continue;
+                }
+            }
+            Op op;
+            op.n = instructionSize(com);
+            for (int c = 0; c < op.n; c++) op.com[c] = actions[i + c];
+            ops.push_back(op);
+        }
+        int fAction(i); // position of return
+
+        // superinstructions
+        auto fused(ops);
+        bool changed(true);
+        while (changed) {
+            changed = false;
+            for (int iOp = 0; iOp < int(fused.size()); iOp++) {
+                const auto& first(fused[iOp].com[0]);
+                if (first.inst() != Instruction::FunctionCall) continue;
+                // arguments of the next impure function have to be evaluated just with pushes and pure functions
+                int frames(0), jOp(iOp + 1);
+                for (; jOp < int(fused.size()); jOp++) {
+                    const auto& com(fused[jOp].com[0]);
+                    if (com.inst() == Instruction::PushConstant) frames += 1 + com.param;
+                    else if (com.inst() != Instruction::FunctionCall) frames++;
+                    else if (isPure(com.param)) frames += 1 - paramCount(com.param);
+                    else break;
+                    if (frames < 0) break;
+                }
+                if (jOp == int(fused.size()) || frames != paramCount(fused[jOp].com[0].param)) continue;
+                for (const auto& fusion: fusionList)
+                    if (int(fusion.first) == first.param && int(fusion.second) == fused[jOp].com[0].param) {
+                        fused[jOp].com[0].param = int(fusion.fused);
+                        fused.erase(fused.begin() + iOp);
+                        changed = true;
+                        break;
+                    }
+            }
+        }
+        // fused functions keep their first arguments in the stack for longer
+        int depth(0), maxDepth(0);
+        for (const auto& op: fused) {
+            const auto& com(op.com[0]);
+            if (com.inst() == Instruction::FunctionCall)
+                depth += (functionList[com.param].retType != Type::LastType) - paramCount(com.param);
+            else
+                depth += com.inst() == Instruction::PushConstant ? 1 + com.param : 1;
+            maxDepth = max(maxDepth, depth);
+        }
+        if (maxDepth < Stack::Capacity) ops.swap(fused);
+
+        // encode in place (it is never longer than the original)
+        i = iAction;
+        for (const auto& op: ops)
+            for (int c = 0; c < op.n; c++) actions[i++] = op.com[c];
+        assert(i <= fAction);
+        actions[i] = Command(Instruction::Return);
+        while (i < fAction) actions[++i] = Command(Instruction::Nop);
+        DIAG(optimizeStats[iAction] = OptimizeStats{ before, int(ops.size()) });
+        return int(ops.size());
+    }
+
+    bool Actions::addDependencies(int iAction, Widget* widget, DisplayList& list) const {
+        while (true) {
+            const auto& com(actions[iAction]);
+            const void* data(nullptr);
+            switch (com.inst()) {
+            case Instruction::Return:
+                return true;
+            case Instruction::Nop:
+            case Instruction::PushConstant:
+                break;
+            case Instruction::PushProperty:
+                data = widget;
+                break;
+            case Instruction::PushForeignProperty:
+                if (!(data = resolveWidget(actions[iAction + 1].strId))) return false;
+                list.addWidgetDependency(static_cast<const Widget*>(data));
+                break;
+            case Instruction::PushParentProperty:
+                data = ancestor(widget, actions[iAction + 1].l);
+                break;
+            case Instruction::PushDoubleProperty:
+            case Instruction::PushDoubleParentProperty: {
+                // the variable holding the widget id and the property of that widget
+                auto* parent(com.inst() == Instruction::PushDoubleProperty ? widget : ancestor(widget, actions[iAction + 2].l));
+                list.addDependency(reinterpret_cast<StringId*>(parent) + actions[iAction + 1].l, sizeof(StringId));
+                if (!(data = resolveWidget(reinterpret_cast<StringId*>(parent)[actions[iAction + 1].l]))) return false;
+                list.addWidgetDependency(static_cast<const Widget*>(data));
+                break;
+            }
+            case Instruction::FunctionCall:
+                // render and pure functions only
+                if (com.param == int(Function::Query) || com.param == int(Function::TriggerTimers) ||
+                    com.param == int(Function::Log) ||
+                    (com.param >= int(Function::AssignUint32) && com.param <= int(Function::AssignBit7)))
+                    return false;
+                break;
+            default:
+                // property pointers are only used to write
+                return false;
+            }
+            if (data) {
+                // memory read by getPropertyData()
+                auto* bytes(reinterpret_cast<const char*>(data));
+                switch (com.type()) {
+                case Type::Bit:          list.addDependency(bytes + (com.param >> 3), 1); break;
+                case Type::Uint8:        list.addDependency(bytes + com.param, 1); break;
+                case Type::Int16:
+                case Type::SizeRelative: list.addDependency(bytes + com.param * 2, 2); break;
+                case Type::Text:         list.addTextDependency(reinterpret_cast<const char* const*>(bytes) + com.param); break;
+                case Type::VoidPtr:      list.addDependency(bytes + com.param * sizeof(long), sizeof(long)); break;
+                default:                 list.addDependency(bytes + com.param * 4, 4); break;
+                }
+            }
+            iAction += instructionSize(com);
+        }
+    }
+
+    void Actions::invalidateDispatchCache() {
+        for (int i = 0, n; i < int(actions.size()); i += n) {
+            n = instructionSize(actions[i]);
+            switch (actions[i].inst()) {
+            case Instruction::PushForeignProperty:
+            case Instruction::PushForeignPropertyPtr:
+            case Instruction::PushDoubleProperty:
+            case Instruction::PushDoublePropertyPtr:
+            case Instruction::PushDoubleParentProperty:
+            case Instruction::PushDoubleParentPropertyPtr:
+                // cache at the end of the instruction
+                for (int k = n - DispatchCacheSize; k < n; k++)
+                    actions[i + k] = Command(0L);
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    int Actions::programSize(int iAction) const {
+        int i(iAction);
+        while (actions[i].inst() != Instruction::Return) i += instructionSize(actions[i]);
+        return i + 1 - iAction;
+    }
+
+    void Actions::markStrings(int iAction, StringManager& strMng) const {
+        for (; actions[iAction].inst() != Instruction::Return; iAction += instructionSize(actions[iAction])) {
+            const auto& com(actions[iAction]);
+            if (com.inst() == Instruction::PushConstant && (com.type() == Type::Id || com.type() == Type::StrId))
+                for (int i = 0; i <= com.param; i++)
+                    strMng.mark(actions[iAction + 1 + i].strId);
+        }
+    }
+
+    int Actions::compact(const vector<int*>& iActions) {
+        // live programs in order, moved down
+        vector<int> live;
+        for (auto* i: iActions)
+            if (*i) live.push_back(*i);
+        sort(live.begin(), live.end());
+        live.erase(unique(live.begin(), live.end()), live.end());
+        vector<int> moved(live.size());
+        unordered_set<const char*> liveTexts;
+        int write(1); // 0 is the empty action
+        for (size_t k = 0; k < live.size(); k++) {
+            int n(programSize(live[k]));
+            moved[k] = write;
+            memmove(&actions[write], &actions[live[k]], n * sizeof(Command));
+            for (int i = write; i < write + n; i += instructionSize(actions[i]))
+                if (actions[i].inst() == Instruction::PushConstant &&
+                    (actions[i].type() == Type::Text || actions[i].type() == Type::StrView))
+                    liveTexts.insert(actions[i + 1].text);
+            write += n;
+        }
+        for (auto* i: iActions)
+            if (*i) *i = moved[lower_bound(live.begin(), live.end(), *i) - live.begin()];
+        DIAG(
+            unordered_map<int, OptimizeStats> stats;
+            for (const auto& s: optimizeStats) {
+                auto it(lower_bound(live.begin(), live.end(), s.first));
+                if (it != live.end() && *it == s.first) stats[moved[it - live.begin()]] = s.second;
+            }
+            swap(stats, optimizeStats));
+
+        // text constants of released programs
+        size_t nTexts(0);
+        for (auto* text: texts)
+            if (liveTexts.count(text)) texts[nTexts++] = text; else free(text);
+        texts.resize(nTexts);
+
+        int released(int(actions.size()) - write);
+        actions.resize(write);
+        actions.shrink_to_fit();
+        // positions changed
+        invalidateDispatchCache();
+        DisplayList::invalidateAll();
+        return released;
+    }
+
     bool Actions::evalProperty(MLParser& parser, int iEntry, int fEntry, StringId propId, Widget* widget, bool onlyIfTemplated, bool define) {
         // creating actions: prop = expression
         int iAction(actions.size());
@@ -542,6 +1049,7 @@ namespace webui {
                     // this avoids a strdup
                     auto* com(&actions[iAction]);
                     *(const char**)((char*)widget + com[0].param) = com[3].text;
+                    if (!texts.empty() && texts.back() == com[3].text) texts.pop_back(); // owned by widget
                 } else {
                     // execution
                     if (!execute(iAction, widget)) {
@@ -552,6 +1060,7 @@ namespace webui {
                 // remove operation
                 actions.resize(iAction);
             }
+            widget->setLayoutDirty();
         } else {
             // remove operation
             actions.resize(iAction);
@@ -574,6 +1083,9 @@ namespace webui {
                 if (attr) {
                     entry = &parser[++iEntry];
                     actions.push_back(Command(Context::strMng.add(entry->pos, parser.size(iEntry))));
+                    // room for the cache in case it is resolved to a double dispatch
+                    for (int i = 0; i < DispatchCacheSize; i++)
+                        actions.push_back(Command(Instruction::Nop));
                 }
                 break;
             case MLParser::EntryType::Number:
@@ -676,7 +1188,7 @@ namespace webui {
                 // foreign: widget.property
                 widget = Context::app.getWidgets()[widgetId];
                 type = DispatchForeign;
-                param = long(widget);
+                param = long(widgetId.getId());
             }
             propId = command[2].strId;
             DIAG(if (!propId.valid()) LOG("invalid property id"));
@@ -708,19 +1220,23 @@ namespace webui {
     void Actions::resolvePropertyRecode(const Property* prop, DispatchType type, long param, Command* command, bool ptr) {
         auto pos(!ptr && prop->type == Type::Bit ? (prop->pos << 3 | prop->bit) : ptr ? prop->pos * prop->size : prop->pos);
         int instBase = ptr ? int(Instruction::PushPropertyPtr) : int(Instruction::PushProperty);
-        int commandSize(1 + 1 + command->param);
+        int commandSize(1 + 1 + command->param + (command->param ? DispatchCacheSize : 0));
         int commandNow(1);
         command[0] = Command(Instruction(instBase + type), prop->type, pos);
         switch (type) {
         case DispatchNormal:
             break;
         case DispatchForeign:
-            command[1] = Command(param);           // foreign widget
-            commandNow++;
+            command[1] = Command(StringId(param)); // foreign widget id
+            command[2] = Command(0L);              // empty cache
+            command[3] = Command(0L);
+            commandNow += 1 + DispatchCacheSize;
             break;
         case DispatchDouble:
             command[1] = Command(param);           // variable id position in widget
-            commandNow++;
+            command[2] = Command(0L);              // empty cache
+            command[3] = Command(0L);
+            commandNow += 1 + DispatchCacheSize;
             break;
         case DispatchParent:
             command[1] = Command(param);           // ancestor level
@@ -729,7 +1245,9 @@ namespace webui {
         case DispatchDoubleParent:
             command[1] = Command(param & 0xfffff); // variable id position in widget
             command[2] = Command(param >> 20);     // ancestor level
-            commandNow += 2;
+            command[3] = Command(0L);              // empty cache
+            command[4] = Command(0L);
+            commandNow += 2 + DispatchCacheSize;
             break;
         case DispatchUnknown:
         default:
@@ -741,14 +1259,27 @@ namespace webui {
             command[commandNow++] = Command(Instruction::Nop);
     }
 
-    Widget* Actions::resolveDoubleDispatch(int pos, Widget* widget) {
-        auto widgetId(reinterpret_cast<StringId*>(widget)[pos]);
+    Widget* Actions::resolveWidget(StringId widgetId) {
         assert(widgetId.valid());
-        DIAG(if (!Context::app.getWidgets().count(widgetId)) {
-                LOG("failed double dispatch, cannot find widget: %s", Context::strMng.get(widgetId));
-                return nullptr;
-            });
-        return Context::app.getWidgets()[widgetId];
+        const auto& widgets(Context::app.getWidgets());
+        auto it(widgets.find(widgetId));
+        if (it == widgets.end()) {
+            DIAG(LOG("failed dispatch, cannot find widget: %s", Context::strMng.get(widgetId)));
+            return nullptr;
+        }
+        return it->second;
+    }
+
+    Widget* Actions::resolveWidgetCached(StringId widgetId, Command* cache) {
+        // cached widget while alive and with the same id (the id of double dispatch can change)
+        auto* cached(Widget::fromHandle(Widget::Handle{ uint32_t(cache[0].l), uint32_t(cache[1].l) }));
+        if (cached && cached->getId() == widgetId) return cached;
+        auto* resolved(resolveWidget(widgetId));
+        if (!resolved) return nullptr;
+        auto handle(resolved->getHandle());
+        cache[0] = Command(long(handle.slot));
+        cache[1] = Command(long(handle.serial));
+        return resolved;
     }
 
     long Actions::getPropertyData(const void* data, Command command) {
@@ -779,7 +1310,7 @@ namespace webui {
     bool Actions::checkFunctionParams(int iFunction, int iAction, Widget* widget) {
         DIAG(int stackSizeOrig(stack.size()));
         const auto& func(functionList[iFunction]);
-        assert(stack.size() == locations.size());
+        assert(stack.size() == int(locations.size()));
         const Type* proto(func.prototype);
         int iStack(stack.size() - 1);
         while (*proto != Type::LastType) {
@@ -822,6 +1353,7 @@ namespace webui {
                         value[0].sub = int(Type::Text);
                         value[0].param = 0;
                         value[1].text = strndup(value[1].text, value[2].l);
+                        texts.push_back(const_cast<char*>(value[1].text));
                         value[2] = Command(Instruction::Nop);
                         valueType = prop->type;
                     }
@@ -924,7 +1456,11 @@ namespace webui {
         });
 
     DIAG(void Actions::dump(int i) const {
-            LOG("actions entry: %d", i);
+            auto stats(optimizeStats.find(i));
+            if (stats != optimizeStats.end())
+                LOG("actions entry: %d (optimized: %d -> %d instructions)", i, stats->second.before, stats->second.after);
+            else
+                LOG("actions entry: %d", i);
             char buffer[512];
             char buffer2[512];
             while (true) {
@@ -949,14 +1485,14 @@ namespace webui {
                         i, "Push prop", ::toString(actions[i].type()), actions[i].param);
                     break;
                 case Instruction::PushForeignProperty:
-                    LOG("%6d " GREEN "%-20s " RESET ": type(%s), offset(%d), widget(%p)",
-                        i, "Push foreign prop", ::toString(actions[i].type()), actions[i].param, actions[i+1].widget);
-                    i++;
+                    LOG("%6d " GREEN "%-20s " RESET ": type(%s), offset(%d), widget(%s)",
+                        i, "Push foreign prop", ::toString(actions[i].type()), actions[i].param, Context::strMng.get(actions[i+1].strId));
+                    i += 1 + DispatchCacheSize;
                     break;
                 case Instruction::PushDoubleProperty:
                     LOG("%6d " GREEN "%-20s " RESET ": type(%s), offset(%d), variable pos(%ld)",
                         i, "Push double prop", ::toString(actions[i].type()), actions[i].param, actions[i+1].l);
-                    i++;
+                    i += 1 + DispatchCacheSize;
                     break;
                 case Instruction::PushParentProperty:
                     LOG("%6d " GREEN "%-20s " RESET ": type(%s), offset(%d), parentAncestor(%ld)",
@@ -966,21 +1502,21 @@ namespace webui {
                 case Instruction::PushDoubleParentProperty:
                     LOG("%6d " GREEN "%-20s " RESET ": type(%s), offset(%d), variable pos(%ld) parentAncestor(%ld)",
                         i, "Push 2 parent prop", ::toString(actions[i].type()), actions[i].param, actions[i+1].l, actions[i+2].l);
-                    i += 2;
+                    i += 2 + DispatchCacheSize;
                     break;
                 case Instruction::PushPropertyPtr:
                     LOG("%6d " GREEN "%-20s " RESET ": type(%s), offset(%d)",
                         i, "Push prop ptr", ::toString(actions[i].type()), actions[i].param);
                     break;
                 case Instruction::PushForeignPropertyPtr:
-                    LOG("%6d " GREEN "%-20s " RESET ": type(%s), offset(%d), widget(%p)",
-                        i, "Push foreign prop ptr", ::toString(actions[i].type()), actions[i].param, actions[i+1].widget);
-                    i++;
+                    LOG("%6d " GREEN "%-20s " RESET ": type(%s), offset(%d), widget(%s)",
+                        i, "Push foreign prop ptr", ::toString(actions[i].type()), actions[i].param, Context::strMng.get(actions[i+1].strId));
+                    i += 1 + DispatchCacheSize;
                     break;
                 case Instruction::PushDoublePropertyPtr:
                     LOG("%6d " GREEN "%-20s " RESET ": type(%s), offset(%d), variable pos(%ld)",
                         i, "Push double prop ptr", ::toString(actions[i].type()), actions[i].param, actions[i+1].l);
-                    i++;
+                    i += 1 + DispatchCacheSize;
                     break;
                 case Instruction::PushParentPropertyPtr:
                     LOG("%6d " GREEN "%-20s " RESET ": type(%s), offset(%d), parentAncestor(%ld)",
@@ -990,11 +1526,13 @@ namespace webui {
                 case Instruction::PushDoubleParentPropertyPtr:
                     LOG("%6d " GREEN "%-20s " RESET ": type(%s), offset(%d), variable pos(%ld) parentAncestor(%ld)",
                         i, "Push 2 parent ptr", ::toString(actions[i].type()), actions[i].param, actions[i+1].l, actions[i+2].l);
-                    i += 2;
+                    i += 2 + DispatchCacheSize;
                     break;
                 case Instruction::FunctionCall:
-                    LOG("%6d " GREEN "%-20s " RESET ": func(" CYAN "%s" RESET ") -> %s   type(%s)",
-                        i, "Function call", ::toString(Function(actions[i].param)), toString(functionList[actions[i].param].retType), toString(com.type()));
+                    LOG("%6d " GREEN "%-20s " RESET ": func(" CYAN "%s%s" RESET ") -> %s   type(%s)",
+                        i, "Function call", ::toString(Function(actions[i].param)),
+                        actions[i].param >= int(Function::BeginPathRoundedRect) ? " superinstruction" : "",
+                        toString(functionList[actions[i].param].retType), toString(com.type()));
                     break;
                 default:
                     LOG("%6d " RED "%-20s" RESET, i, "internal error");
@@ -1005,7 +1543,7 @@ namespace webui {
         });
 
     DIAG(void Actions::dumpStack() {
-            LOG("stack: %zu", stack.size());
+            LOG("stack: %d", stack.size());
             for (int i = 0; i < int(stack.size()); i++)
                 LOG("%4d " GREEN "float(%f), uint32_t(%ld), ptr(%p)" RESET,
                     i, stack[i].f, stack[i].l, stack[i].voidPtr);
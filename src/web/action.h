@@ -21,6 +21,7 @@ namespace webui {
     class Widget;
     class Actions;
     class MLParser;
+    class DisplayList;
 
     struct StackFrame {
         StackFrame() { }
@@ -35,9 +36,28 @@ namespace webui {
             void* voidPtr;
         };
     };
-    typedef std::vector<StackFrame> Stack;
 
-    typedef void (*FunctionProto)();
+    // fixed capacity execution stack; Actions::add() rejects programs that could overflow it
+    class Stack {
+    public:
+        enum { Capacity = 64 };
+
+        inline Stack(): sp(frames) { }
+        inline void clear() { sp = frames; }
+        inline int size() const { return int(sp - frames); }
+        inline bool empty() const { return sp == frames; }
+        inline StackFrame& back() { return sp[-1]; }
+        inline void push_back(StackFrame frame) { *sp++ = frame; }
+        inline void pop_back() { --sp; }
+        inline StackFrame& operator[](int i) { return frames[i]; }
+        inline const StackFrame& operator[](int i) const { return frames[i]; }
+
+        StackFrame frames[Capacity];
+        StackFrame* sp;              // one past the top of the stack
+    };
+
+    // functions receive the top of the stack and return the new top
+    typedef StackFrame* (*FunctionProto)(StackFrame* sp);
 
     enum class Function: uint16_t {
         Error,
@@ -87,6 +107,14 @@ namespace webui {
         AssignBit5,                  //
         AssignBit6,                  //
         AssignBit7,                  //
+        // superinstructions, only generated by Actions::optimize()
+        BeginPathRoundedRect,        // beginPath, roundedRect
+        FillColorFill,               // fillColor, fill
+        FillVertGradFill,            // fillVertGrad, fill
+        StrokeColorStroke,           // strokeColor, stroke
+        RoundedRectFill,             // beginPath, roundedRect, fillColor, fill
+        RoundedRectFillVertGrad,     // beginPath, roundedRect, fillVertGrad, fill
+        RoundedRectStroke,           // beginPath, roundedRect, strokeColor, stroke
     };
 
     enum class Instruction: uint8_t {
@@ -95,28 +123,31 @@ namespace webui {
         Nop,                         // [ ins, 0x00, 0x0000 ]
         PushConstant,                // [ ins, type, elems  ] [ value]
         PushProperty,                // [ ins, type, offset ]
-        PushForeignProperty,         // [ ins, type, offset ] [ widget* ]
-        PushDoubleProperty,          // [ ins, type, offset ] [ variable prop position ]
+        PushForeignProperty,         // [ ins, type, offset ] [ widget id ] [ cache slot ] [ cache serial ]
+        PushDoubleProperty,          // [ ins, type, offset ] [ variable prop position ] [ cache slot ] [ cache serial ]
         PushParentProperty,          // [ ins, type, offset ] [ ancestor level ]
-        PushDoubleParentProperty,    // [ ins, type, offset ] [ variable prop position ] [ ancestor level ]
+        PushDoubleParentProperty,    // [ ins, type, offset ] [ variable prop position ] [ ancestor level ] [ cache slot ] [ cache serial ]
         PushPropertyPtr,             // [ ins, type, offset ]
-        PushForeignPropertyPtr,      // [ ins, type, offset ] [ widget* ]
-        PushDoublePropertyPtr,       // [ ins, type, offset ] [ variable prop position ]
+        PushForeignPropertyPtr,      // [ ins, type, offset ] [ widget id ] [ cache slot ] [ cache serial ]
+        PushDoublePropertyPtr,       // [ ins, type, offset ] [ variable prop position ] [ cache slot ] [ cache serial ]
         PushParentPropertyPtr,       // [ ins, type, offset ] [ ancestor level ]
-        PushDoubleParentPropertyPtr, // [ ins, type, offset ] [ variable prop position ] [ ancestor level ]
+        PushDoubleParentPropertyPtr, // [ ins, type, offset ] [ variable prop position ] [ ancestor level ] [ cache slot ] [ cache serial ]
         FunctionCall,                // [ ins, type, func   ]
     };
 
     // property resolution types
     enum DispatchType {
         DispatchNormal       = 0,    // property                              param: none
-        DispatchForeign      = 1,    // widget.property                       param: foreign widget
+        DispatchForeign      = 1,    // widget.property                       param: foreign widget id
         DispatchDouble       = 2,    // (variable->widget).property           param: variable position
         DispatchParent       = 3,    // property (found in ancestor)          param: ancestor
         DispatchDoubleParent = 4,    // (ancestor:variable->widget).property  param: variable position | ancestor << 20
         DispatchUnknown
     };
 
+    // inline cache of foreign and double dispatch instructions: handle of the resolved widget (see Widget::Handle)
+    enum { DispatchCacheSize = 2 };
+
 
     struct Command {
         Command() { }
@@ -154,6 +185,8 @@ namespace webui {
 
 
     class Actions {
+        friend class Image;
+
     public:
         Actions();
 
@@ -165,6 +198,26 @@ namespace webui {
         bool execute(int iAction, Widget* widget); // false on error
         bool executeOrEmpty(int iAction, Widget* widget) { return iAction ? execute(iAction, widget) : false; } // false on error or empty
 
+        // optimize an action already prepared by a dry run: constant folding, padding removal and
+        // superinstructions; returns the number of instructions of the optimized action
+        int optimize(int iAction);
+
+        // empties all dispatch caches (each cache is also checked against the widget it holds on use)
+        void invalidateDispatchCache();
+
+        // adds to the list the memory read by an action already prepared by a dry run;
+        // returns false if the action has side effects (its result cannot be replayed)
+        bool addDependencies(int iAction, Widget* widget, DisplayList& list) const;
+
+        // memory reclamation: keeps only the programs in iActions (rewritten with their new positions) and
+        // releases the rest; returns the number of commands released
+        int compact(const std::vector<int*>& iActions);
+        void markStrings(int iAction, StringManager& strMng) const; // strings used by the program
+        inline int size() const { return int(actions.size()); }    // commands of all programs
+
+        // number of commands of an instruction and its operands
+        static int instructionSize(const Command& com);
+
         // evaluate property: executes an action and sets corresponding value to property
         bool evalProperty(MLParser& parser, int iEntry, int fEntry, StringId propId, Widget* widget, bool onlyIfTemplated, bool define);
 
@@ -176,15 +229,26 @@ namespace webui {
     private:
         // compiled actions
         std::vector<Command> actions;
+        std::vector<char*> texts; // text constants owned by the programs
         bool templateFound;
         bool defining;
 
+        // instruction count of optimized actions
+        struct OptimizeStats {
+            int before, after;
+        };
+        DIAG(std::unordered_map<int, OptimizeStats> optimizeStats);
+
         bool addRecur(MLParser& parser, int iEntry, int fEntry);
+        bool run(int iAction, Widget* widget);
+        int stackDepth(int iAction, int fAction) const;
+        int programSize(int iAction) const;
         bool checkFunctionParams(int iFunction, int iAction, Widget* widget);
         static long getPropertyData(const void* data, Command command);
         const Property* resolveProperty(Command* command, Widget* widget, DispatchType& type, long& param);
         void resolvePropertyRecode(const Property* prop, DispatchType type, long param, Command* command, bool ptr);
-        static Widget* resolveDoubleDispatch(int pos, Widget* widget);
+        static Widget* resolveWidget(StringId widgetId); // null if not registered
+        Widget* resolveWidgetCached(StringId widgetId, Command* cache);
 
         DIAG(const char* valueToString(Type type, const Command& action, char* buffer, int nBuffer) const);
     };
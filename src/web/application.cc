@@ -8,6 +8,7 @@
 
 #include "application.h"
 #include "input.h"
+#include "image.h"
 #include "widget.h"
 #include "context.h"
 #include "widget_timer.h"
@@ -27,22 +28,54 @@ using namespace webui;
 namespace {
 
     template <typename T>
-    inline void* getPtr(int objectSize) {
-        size_t size(objectSize ? objectSize : sizeof(T));
-        //DIAG(LOG("object memory: %zu", size));
-        void* ptr(malloc(size));
-        memset(ptr, 0, size); // so that default value of properties is reset
-        return ptr;
+    inline void* getPtr(Arena& arena, int objectSize) {
+        int size(objectSize ? objectSize : sizeof(T));
+        //DIAG(LOG("object memory: %d", size));
+        return arena.alloc(size);
     }
 
-    priority_queue<WidgetTimer*, vector<WidgetTimer*>, WidgetTimerSorter> timers;
+    // never destroyed: the application is cleared at exit, after the statics of this file could be gone
+    typedef priority_queue<WidgetTimer*, vector<WidgetTimer*>, WidgetTimerSorter> Timers;
+    Timers& timers = *new Timers;
+
+    const int AnimationFrameMs(16); // while layout is not stable
+    const int MaxIdleMs(1000);
+
+    void removeTimer(WidgetTimer* timer) {
+        Timers t;
+        for (; !timers.empty(); timers.pop())
+            if (timers.top() != timer) t.push(timers.top());
+        swap(t, timers);
+    }
+
+    // length of the longest strictly increasing subsequence
+    int longestIncreasing(const vector<int>& seq) {
+        vector<int> tails;
+        for (auto value: seq) {
+            auto it(lower_bound(tails.begin(), tails.end(), value));
+            if (it == tails.end()) tails.push_back(value);
+            else *it = value;
+        }
+        return tails.size();
+    }
+
+    // row key or id written in template data (quotes are optional)
+    StringId valueKey(const MLParser& parser, int iEntry) {
+        bool quoted(parser[iEntry].type() == MLParser::EntryType::String);
+        return Context::strMng.search(parser[iEntry].pos + quoted, parser.size(iEntry) - 2 * quoted);
+    }
+
+    bool isPatch(const MLParser& parser) {
+        return parser.size() > 0 && parser[0].type() == MLParser::EntryType::Object && parser.asId(0) == Identifier::Patch;
+    }
 
 }
 
 namespace webui {
 
-    Application::Application(): iTpl(0), fTpl(0), startedTpl(false), layoutStable(false),
-                                actionTables(1), root(nullptr) {
+    Application::Application(): iTpl(0), fTpl(0), startedTpl(false), reconcileStats{ }, requestStats{ },
+                                dispatching(false), hoverPainted(nullptr), hoverBox(0.0f, 0.0f, 0.0f, 0.0f), actionTables(1), memoryStats{ },
+                                root(nullptr), internalId(0) {
     }
 
     DIAG(Application::~Application() {
@@ -54,21 +87,32 @@ namespace webui {
     void Application::initialize() {
         DIAG(clear());
         // widget inheritance
-        auto begin(Widget::getType().begin());
-        auto end(Widget::getType().end());
-        WidgetTimer::getType().insert(begin, end);
-        WidgetLayout::getTypeHor().insert(begin, end);
-        WidgetLayout::getTypeVer().insert(begin, end);
-        WidgetTemplate::getType().insert(begin, end);
-        WidgetApplication::getType().insert(begin, end);
+        const auto& base(Widget::getType());
+        WidgetTimer::getType().inherit(base);
+        WidgetLayout::getTypeHor().inherit(base);
+        WidgetLayout::getTypeVer().inherit(base);
+        WidgetTemplate::getType().inherit(base);
+        WidgetApplication::getType().inherit(base);
     }
 
     void Application::refresh() {
-        if (root && ((Input::refresh() | refreshTimers()) || !layoutStable)) {
+        // out of action execution: programs can be moved
+        if (needsCompaction()) compact();
+        // dirty layout: changed or not stable yet
+        if (root && ((Input::refresh() | refreshTimers()) || root->isLayoutDirty())) {
             ctx.forceRender();
         }
     }
 
+    int Application::getIdleMs() const {
+        if (!root) return MaxIdleMs;
+        auto now(getTimeNowMs());
+        int idle(root->isLayoutDirty() ? ctx.getTimeMs() + AnimationFrameMs - now : MaxIdleMs);
+        if (!timers.empty()) idle = min(idle, timers.top()->nextExecutionMs - now);
+        if (Input::hoverTime) idle = min(idle, Input::hoverTime + 1 - now);
+        return max(idle, 0);
+    }
+
     bool Application::refreshTimers() {
         bool dev(false);
         auto now(ctx.getTimeMs());
@@ -91,6 +135,12 @@ namespace webui {
         return dev;
     }
 
+    void Application::addTimer(WidgetTimer* timer) {
+        timer->nextExecutionMs = ctx.getTimeMs();
+        if (!timer->repeat) timer->nextExecutionMs += timer->delay;
+        timers.push(timer);
+    }
+
     void Application::triggerTimers() {
         auto t(timers);
         while (!t.empty()) {
@@ -109,22 +159,27 @@ namespace webui {
         return dev;
     }
 
-    DIAG(void Application::clear() {
-            root = nullptr;
-            // get all new types for removal
-            unordered_set<TypeWidget*> types;
-            for (auto& widget: widgets) {
-                auto* type(widget.second->typeWidget);
-                if (type && type->type > Identifier::WLast) types.insert(type);
-            }
-            // delete widgets
-            for (auto& widget: widgets)
-                delete widget.second;
-            widgets.clear();
-            // delete new types
-            for (auto type: types)
-                delete type;
-        });
+    void Application::clear() {
+        root = nullptr;
+        // get all new types for removal
+        unordered_set<TypeWidget*> types;
+        for (auto& widget: widgets) {
+            auto* type(widget.second->typeWidget);
+            if (type && type->type > Identifier::WLast) types.insert(type);
+        }
+        // delete widgets
+        for (auto& widget: widgets)
+            freeWidget(widget.second);
+        widgets.clear();
+        Context::actions.invalidateDispatchCache();
+        timers = Timers();
+        streams.clear();
+        requests.clear(); // requests in flight are not delivered
+        requestStats = RequestStats{ };
+        // delete new types
+        for (auto type: types)
+            delete type;
+    }
 
     void Application::resize(int width, int height) {
         if (root) {
@@ -133,33 +188,80 @@ namespace webui {
         }
     }
 
-    void Application::render() {
-        if (root) {
-            layoutStable = root->layout(Box4f(0.f, 0.f, float(Context::render.getWidth()), float(Context::render.getHeight())));
-            Context::render.beginFrame();
-            root->render(0x100);
-            if (Input::hoverWidget) {
-                const auto& actionTable(getActionTable(Input::hoverWidget->actions));
-                assert(actionTable.onHover);
-                Context::render.resetScissor();
-                Context::actions.execute(actionTable.onHover, Input::hoverWidget);
-            }
-            Context::render.endFrame();
+    bool Application::render() {
+        if (!root) return false;
+        root->layout(Box4f(0.f, 0.f, float(Context::render.getWidth()), float(Context::render.getHeight())));
+
+        // damage pass: find out what changed since the last frame
+        Context::render.setDamagePass(true);
+        DisplayList::beginDamagePass();
+        root->render(0x100);
+        if (Input::hoverWidget != hoverPainted || (hoverPainted && Input::hoverCursor != hoverCursor)) {
+            // the hover action paints on top of anything: where it was and, as a first guess, its widget
+            Context::render.damage(hoverBox);
+            if (Input::hoverWidget) Context::render.damage(Input::hoverWidget->box);
+        }
+        DisplayList::endDamagePass();
+        Context::render.setDamagePass(false);
+        if (!Context::render.isDamaged()) return false;
+
+        // a new hover is measured while painted: the frame is repeated if it painted out of the clip
+        renderFrame();
+        if (Context::render.isDamaged()) renderFrame();
+        return true;
+    }
+
+    void Application::renderFrame() {
+        // render clipped to the damaged region
+        Context::render.beginFrame();
+        DisplayList::beginFrame();
+        root->render(0x100);
+        hoverPainted = Input::hoverWidget;
+        hoverBox = Box4f(0.0f, 0.0f, 0.0f, 0.0f);
+        if (Input::hoverWidget) {
+            const auto& actionTable(getActionTable(Input::hoverWidget->actions));
+            assert(actionTable.onHover);
+            Context::render.resetScissor();
+            Context::render.beginBounds();
+            Context::actions.execute(actionTable.onHover, Input::hoverWidget);
+            hoverBox = Context::render.endBounds();
+            hoverCursor = Input::hoverCursor;
         }
+        bool hoverClipped(Context::render.isClipped() && !hoverBox.empty() && !Context::render.getClip().contains(hoverBox));
+        Context::render.endFrame();
+        if (hoverClipped) Context::render.damage(hoverBox);
     }
 
     bool Application::onLoad(RequestXHR* xhr) {
+        if (!completeRequest(xhr)) {
+            streams.erase(xhr);
+            delete xhr;
+            return true;
+        }
+        auto it(streams.find(xhr));
+        if (it != streams.end()) {
+            bool dev(onLoadStream(xhr, it->second));
+            streams.erase(it);
+            delete xhr;
+            return dev;
+        }
         DIAG(if (!xhr->getData() || !xhr->getNData()) { LOG("empty xhr response"); return false; });
         bool dev(true);
         switch (Identifier(xhr->getId().getId())) {
         case Identifier::Application:
             // main application definition
             assert(!root);
-            if (!tree.parse(xhr->getData(), xhr->getNData()) || !(root = initializeConstruct()) || !checkActions()) {
+            if (Image::isImage(xhr->getData(), xhr->getNData()) ?
+                !Image::load(xhr->getData(), xhr->getNData()) :
+                !tree.parse(xhr->getData(), xhr->getNData()) || !(root = initializeConstruct()) || !checkActions()) {
                 DIAG(
-                    xhr->makeCString();
-                    LOG("cannot parse: %s", xhr->getData());
-                    clear());
+                    if (Image::isImage(xhr->getData(), xhr->getNData()))
+                        LOG("cannot load application image");
+                    else {
+                        xhr->makeCString();
+                        LOG("cannot parse: %s", xhr->getData());
+                    });
+                clear();
                 dev = false;
             } else
                 resize(Context::render.getWidth(), Context::render.getHeight());
@@ -179,6 +281,7 @@ namespace webui {
                     font.second = (char*)malloc(xhr->getNData());
                     memcpy(font.second, xhr->getData(), xhr->getNData());
                     int vgId(Context::render.loadFont(Context::strMng.get(id), font.second, xhr->getNData()));
+                    DisplayList::invalidateAll(); // text metrics change
                     if (vgId == &font - fonts.data())
                         ok = true;
                     break;
@@ -192,6 +295,13 @@ namespace webui {
         }
         default: {
             // pass directly to the widget(s)
+            // data of a template identical to the last applied (like a revalidated response) is skipped
+            auto* tplWidget(getTemplate(xhr->getId()));
+            uint32_t hash(hashString(xhr->getData(), xhr->getNData()));
+            if (tplWidget && tplWidget->hash == hash) {
+                DIAG(LOG("unchanged data for template %s", Context::strMng.get(xhr->getId())));
+                break;
+            }
             // parse received ML
             if (!tpl.parse(xhr->getData(), xhr->getNData())) {
                 DIAG(LOG("cannot parse server ML"));
@@ -201,6 +311,10 @@ namespace webui {
                     if (tpl[0].type() == MLParser::EntryType::List) {
                         // provide server info to single widget
                         dev = setData(xhr->getId(), 1, tpl[0].next);
+                        if (dev && tplWidget) tplWidget->hash = hash;
+                    } else if (isPatch(tpl)) {
+                        // changes to the rows of a template
+                        dev = applyPatch(xhr->getId(), 1, tpl[0].next);
                     } else if (tpl[0].type() == MLParser::EntryType::Object) {
                         // several initialization lists
                         dev = setDataMultiple(1, tpl[0].next);
@@ -214,6 +328,119 @@ namespace webui {
         return dev;
     }
 
+    bool Application::onProgress(RequestXHR* xhr, const char* data, int nData) {
+        // only template data is parsed while received
+        auto id(Identifier(xhr->getId().getId()));
+        if (id == Identifier::Application || id == Identifier::font) return false;
+        auto* request(findRequest(xhr));
+        if (request && request->superseded) return true; // discarded
+        bool first(!streams.count(xhr));
+        auto& stream(streams[xhr]);
+        if (first) {
+            stream.parser.begin();
+            stream.iEntry = 1;
+            stream.rows = StringId();
+            stream.hash = hashString(nullptr, 0);
+            stream.ok = true;
+        }
+        stream.hash = hashString(data, nData, stream.hash); // continued over the chunks
+        if (stream.ok && !(stream.ok = stream.parser.feed(data, nData)))
+            DIAG(LOG("cannot parse server ML"));
+        if (stream.ok && !stream.parser.empty()) {
+            tpl.swap(stream.parser);
+            if (tpl[0].type() == MLParser::EntryType::List)
+                // single template: rows received so far
+                stream.ok = streamRows(stream, xhr->getId(), 0);
+            else if (tpl[0].type() == MLParser::EntryType::Object && !isPatch(tpl)) {
+                // several templates: completed key: [ ... ] items and rows of the one being received
+                int i(stream.iEntry);
+                for (; stream.ok && i + 1 < tpl.size() && tpl[i].type() == MLParser::EntryType::Id && tpl[i + 1].next; i = tpl[i + 1].next)
+                    stream.ok = setDataStreamed(stream, tpl.asId(i), i + 1);
+                stream.iEntry = i;
+                if (stream.ok && i + 1 < tpl.size() && tpl[i].type() == MLParser::EntryType::Id)
+                    stream.ok = streamRows(stream, tpl.asId(i), i + 1);
+            }
+            tpl.swap(stream.parser);
+        }
+        return true;
+    }
+
+    bool Application::onLoadStream(RequestXHR* xhr, Stream& stream) {
+        if (!stream.ok || !stream.parser.end()) {
+            DIAG(LOG("cannot parse server ML"));
+            return false;
+        }
+        tpl.swap(stream.parser);
+        if (tpl.empty()) return true;
+        if (tpl[0].type() == MLParser::EntryType::List) {
+            auto* tplWidget(getTemplate(xhr->getId()));
+            if (stream.rows.valid()) {
+                // rows already instantiated while received
+                if (!setDataStreamed(stream, xhr->getId(), 0)) return false;
+            } else if (tplWidget && tplWidget->hash == stream.hash) {
+                DIAG(LOG("unchanged data for template %s", Context::strMng.get(xhr->getId())));
+                return true;
+            } else if (!setData(xhr->getId(), 1, tpl[0].next))
+                return false;
+            if (tplWidget) tplWidget->hash = stream.hash;
+            return true;
+        }
+        if (isPatch(tpl))
+            return applyPatch(xhr->getId(), 1, tpl[0].next);
+        if (tpl[0].type() == MLParser::EntryType::Object)
+            return setDataMultiple(stream.iEntry, tpl[0].next);
+        return true;
+    }
+
+    bool Application::setDataStreamed(Stream& stream, StringId widgetId, int iData) {
+        // complete data of a template: rows instantiated while received are completed (the rest of the data,
+        // if any, is applied as a whole)
+        if (tpl[iData].type() != MLParser::EntryType::List) {
+            DIAG(LOG("expecting list as value"));
+            return false;
+        }
+        if (stream.rows != widgetId)
+            return setData(widgetId, iData + 1, tpl[iData].next);
+        bool dev(streamRows(stream, widgetId, iData));
+        stream.rows = StringId();
+        if (dev && tpl[iData + 1].next != tpl[iData].next)
+            dev = setData(widgetId, iData + 1, tpl[iData].next);
+        return dev;
+    }
+
+    bool Application::streamRows(Stream& stream, StringId widgetId, int iData) {
+        // tpl[iData] is the data of a template starting by the list of rows of its loop: the first rows
+        // received update the template, the following ones are appended
+        int iRows(iData + 1);
+        if (iRows >= tpl.size() || tpl[iRows].type() != MLParser::EntryType::List) return true;
+        int fRows(tpl[iRows].next ? tpl[iRows].next : tpl.size());
+        if (!stream.rows.valid()) {
+            auto* tplWidget(getTemplate(widgetId));
+            if (!tplWidget || rowsLoop(tplWidget->getParser()) < 0 || iRows + 1 >= fRows) return true;
+            stream.rows = widgetId;
+            stream.iRow = fRows;
+            int next(tpl[iRows].next);
+            tpl[iRows].next = fRows; // rows so far
+            bool dev(tplWidget->setData(iRows, fRows));
+            tpl[iRows].next = next;
+            return dev;
+        }
+        auto* tplWidget(getTemplate(widgetId));
+        if (!tplWidget) {
+            DIAG(LOG("internal: cannot find template %s", Context::strMng.get(widgetId)));
+            return false;
+        }
+        bool dev(stream.iRow >= fRows || appendTemplate(tplWidget, stream.iRow, fRows));
+        stream.iRow = fRows;
+        return dev;
+    }
+
+    WidgetTemplate* Application::getTemplate(StringId widgetId) {
+        auto it(widgets.find(widgetId));
+        if (it == widgets.end() || it->second->baseType() != Identifier::Template) return nullptr;
+        return reinterpret_cast<WidgetTemplate*>(it->second);
+    }
+
     bool Application::setData(StringId widgetId, int iTpl, int fTpl) {
         auto it(widgets.find(widgetId));
         if (it == widgets.end()) {
@@ -249,24 +476,311 @@ namespace webui {
         bool dev(true);
         iTpl = iTpl_;
         fTpl = fTpl_;
+        reconcileStats = ReconcileStats{ };
 
         tree.swap(tplWidget->getParser());
         //DIAG(LOG("template with description:"); tree.dumpTree());
-        Construct cons(tplWidget, 0, tree.size(), true, false);
+        Construct cons(tplWidget, tree.firstEntry(), tree.size(), true, false);
         if (!initializeConstructCheckUpdate(cons)) {
             DIAG(LOG("error: update template"));
             dev = false;
         } else {
             //DIAG(dump());
-            layoutStable = false;
+            tplWidget->setLayoutDirty();
             ctx.forceRender();
         }
         tree.swap(tplWidget->getParser());
         return dev;
     }
 
+    int Application::rowsLoop(const MLParser& tree) {
+        // row object of a template whose values are the rows of its last top-level loop (-1 otherwise)
+        int iLoop(-1);
+        for (int i = tree.firstEntry(); i < tree.size(); i = tree[i].type() == MLParser::EntryType::Id ? tree[i + 1].next : tree[i].next)
+            iLoop = i;
+        if (iLoop < 0 || tree[iLoop].type() != MLParser::EntryType::Block || iLoop + 1 >= tree[iLoop].next ||
+            tree[iLoop + 1].type() != MLParser::EntryType::Object || tree[iLoop + 1].next != tree[iLoop].next)
+            return -1;
+        for (int i = tree.firstEntry(); i < iLoop; i++)
+            if (tree[i].type() == MLParser::EntryType::Wildcar || tree[i].type() == MLParser::EntryType::Block)
+                return -1;
+        return iLoop + 1;
+    }
+
+    bool Application::appendTemplate(WidgetTemplate* tplWidget, int iRow, int fRow) {
+        // rows [iRow, fRow) of tpl added at the end of the loop of the template (see rowsLoop)
+        bool dev(true);
+        tplWidget->hash = 0;
+        tree.swap(tplWidget->getParser());
+        int iObject(rowsLoop(tree));
+        Construct cons(tplWidget, iObject, tree[iObject].next, true, false);
+        for (; dev && iRow < fRow; iRow = tpl[iRow].next) {
+            if (tpl[iRow].type() != MLParser::EntryType::List) {
+                DIAG(
+                    LOG("expected widget []");
+                    tpl.error(tpl[iRow].pos, "=>", tpl[iRow].line));
+                dev = false;
+                break;
+            }
+            iTpl = iRow + 1;
+            fTpl = tpl[iRow].next;
+            cons.iEntry = iObject;
+            cons.iChild = tplWidget->getChildren().size();
+            if (!initializeConstructRecur(cons)) {
+                DIAG(LOG("error: append template rows"));
+                dev = false;
+            }
+        }
+        tree.swap(tplWidget->getParser());
+        tplWidget->setLayoutDirty();
+        ctx.forceRender();
+        return dev;
+    }
+
+    bool Application::applyPatch(StringId widgetId, int iEntry, int fEntry) {
+        auto* tplWidget(getTemplate(widgetId));
+        if (!tplWidget) {
+            DIAG(LOG("internal: cannot find template %s", Context::strMng.get(widgetId)));
+            return false;
+        }
+        tplWidget->hash = 0;
+
+        // sequence number and snapshot
+        int seq(-1), data(-1);
+        for (int i = iEntry; i < fEntry; i = tpl[i].type() == MLParser::EntryType::Id ? tpl[i + 1].next : tpl[i].next)
+            if (tpl[i].type() == MLParser::EntryType::Id) {
+                auto type(tpl[i + 1].type());
+                bool valid(false);
+                switch (tpl.asId(i)) {
+                case Identifier::seq:  valid = type == MLParser::EntryType::Number; seq = atoi(tpl[i + 1].pos); break;
+                case Identifier::data: valid = type == MLParser::EntryType::List;   data = i + 1; break;
+                default: break;
+                }
+                if (!valid) {
+                    DIAG(LOG("unknown patch attribute: %.*s", tpl.size(i), tpl[i].pos));
+                    return false;
+                }
+            } else if (tpl[i].type() != MLParser::EntryType::Object) {
+                DIAG(LOG("expecting patch operation"));
+                return false;
+            }
+        if (seq < 0) {
+            DIAG(LOG("patch without sequence number"));
+            return false;
+        }
+        if (seq <= tplWidget->seq) {
+            DIAG(LOG("stale patch %d for template %s at %d", seq, Context::strMng.get(widgetId), tplWidget->seq));
+            return false;
+        }
+        if (data < 0 && (tplWidget->seq < 0 || seq != tplWidget->seq + 1)) {
+            DIAG(LOG("missing patches before %d for template %s: expecting a snapshot", seq, Context::strMng.get(widgetId)));
+            return false;
+        }
+
+        bool dev(true);
+        if (data >= 0)
+            dev = updateTemplate(tplWidget, data + 1, tpl[data].next);
+        else
+            reconcileStats = ReconcileStats{ };
+        if (dev) {
+            tree.swap(tplWidget->getParser());
+            for (int i = iEntry; dev && i < fEntry; i = tpl[i].type() == MLParser::EntryType::Id ? tpl[i + 1].next : tpl[i].next)
+                if (tpl[i].type() == MLParser::EntryType::Object)
+                    dev = patchOperation(tplWidget, i);
+            tree.swap(tplWidget->getParser());
+        }
+        tplWidget->seq = dev ? seq : -1; // partially applied: out of sequence
+        tplWidget->setLayoutDirty();
+        ctx.forceRender();
+        return dev;
+    }
+
+    bool Application::patchOperation(WidgetTemplate* tplWidget, int iOp) {
+        // attributes
+        int path(-1), field(-1), value(-1), row(-1), before(-1);
+        for (int i = iOp + 1; i < tpl[iOp].next; i = tpl[i + 1].next) {
+            if (tpl[i].type() != MLParser::EntryType::Id) {
+                DIAG(LOG("expecting key: value in patch operation"));
+                return false;
+            }
+            auto type(tpl[i + 1].type());
+            bool valid(true);
+            switch (tpl.asId(i)) {
+            case Identifier::path:   valid = type == MLParser::EntryType::List;   path = i + 1; break;
+            case Identifier::field:  valid = type == MLParser::EntryType::Number; field = atoi(tpl[i + 1].pos); break;
+            case Identifier::value:  value = i + 1; break;
+            case Identifier::row:    valid = type == MLParser::EntryType::List;   row = i + 1; break;
+            case Identifier::before: before = i + 1; break;
+            default:                 valid = false; break;
+            }
+            if (!valid) {
+                DIAG(LOG("unknown patch operation attribute: %.*s", tpl.size(i), tpl[i].pos));
+                return false;
+            }
+        }
+        if (path < 0) {
+            DIAG(LOG("patch operation without path"));
+            return false;
+        }
+
+        // follow the path: loop (value index) of the current row, then row in it (key)
+        Widget* widget(tplWidget);
+        int iEntry(tree.firstEntry()), fEntry(tree.size()), iRow(-1);
+        PatchTarget loop{ };
+        bool inLoop(false);
+        auto findRow = [&loop](StringId key) {
+            auto& children(loop.widget->getChildren());
+            for (int i = loop.iChild; i < loop.iChild + loop.nChild; i++)
+                if (children[i]->getId() == key) return i;
+            return -1;
+        };
+        for (int i = path + 1; i < tpl[path].next; i = tpl[i].next) {
+            if (!inLoop) {
+                int index(tpl[i].type() == MLParser::EntryType::Number ? atoi(tpl[i].pos) : -1);
+                if (index < 0 || !patchField(loop, widget, iEntry, fEntry, index, true) ||
+                    tree[loop.iEntry].type() != MLParser::EntryType::Block ||
+                    loop.iEntry + 1 >= tree[loop.iEntry].next || tree[loop.iEntry + 1].type() != MLParser::EntryType::Object) {
+                    DIAG(LOG("patch path: no loop at value %.*s", tpl.size(i), tpl[i].pos));
+                    return false;
+                }
+            } else {
+                if ((iRow = findRow(valueKey(tpl, i))) < 0) {
+                    DIAG(LOG("patch path: no row %.*s", tpl.size(i), tpl[i].pos));
+                    return false;
+                }
+                widget = loop.widget->getChildren()[iRow];
+                iEntry = loop.iEntry + 2; // row object items
+                fEntry = tree[loop.iEntry + 1].next;
+            }
+            inLoop = !inLoop;
+        }
+
+        auto& children(loop.widget ? loop.widget->getChildren() : widget->getChildren());
+        int iBefore(loop.iChild + loop.nChild); // end of the loop by default
+        if (before >= 0 && loop.widget && (iBefore = findRow(valueKey(tpl, before))) < 0) {
+            DIAG(LOG("patch: no row %.*s to insert before", tpl.size(before), tpl[before].pos));
+            return false;
+        }
+        bool applied(false);
+        switch (tpl.asId(iOp)) {
+        case Identifier::update:
+            if (inLoop || field < 0 || value < 0) break;
+            {
+                PatchTarget target{ };
+                if (!patchField(target, widget, iEntry, fEntry, field, true) || !target.widget ||
+                    tree[target.iEntry].type() != MLParser::EntryType::Id || tree.asId(target.iEntry) == Identifier::id) {
+                    DIAG(LOG("patch: cannot update value %d (only single wildcars and not row keys)", field));
+                    return false;
+                }
+                iTpl = value;
+                fTpl = tpl[value].next;
+                if (!Context::actions.evalProperty(tree, target.iEntry + 1, tree[target.iEntry + 1].next,
+                                                   tree.asId(target.iEntry), target.widget, true, false)) {
+                    DIAG(LOG("patch: evaluating value %d", field));
+                    return false;
+                }
+                target.widget->setLayoutDirty();
+                reconcileStats.reused++;
+            }
+            applied = true;
+            break;
+        case Identifier::insert:
+            if (!inLoop || row < 0) break;
+            {
+                int iObject(loop.iEntry + 1), iKey(rowKeyIndex(iObject)), iValue;
+                if (iKey >= 0 && (iValue = rowValue(row, iKey)) >= 0 && findRow(valueKey(tpl, iValue)) >= 0) {
+                    DIAG(LOG("patch: duplicated row %.*s", tpl.size(iValue), tpl[iValue].pos));
+                    return false;
+                }
+                Construct cons(loop.widget, iObject, tree[iObject].next, true, false);
+                cons.iChild = iBefore;
+                cons.keyed = true;
+                cons.row = nullptr;
+                iTpl = row + 1;
+                fTpl = tpl[row].next;
+                if (!initializeConstructRecur(cons)) {
+                    DIAG(LOG("patch: cannot construct row"));
+                    return false;
+                }
+            }
+            applied = true;
+            break;
+        case Identifier::remove:
+            if (inLoop || iRow < 0) break;
+            destroyWidget(children[iRow]);
+            children.erase(children.begin() + iRow);
+            reconcileStats.destroyed++;
+            applied = true;
+            break;
+        case Identifier::move:
+            if (inLoop || iRow < 0) break;
+            {
+                auto* moved(children[iRow]);
+                children.erase(children.begin() + iRow);
+                if (iBefore > iRow) iBefore--;
+                children.insert(children.begin() + iBefore, moved);
+                reconcileStats.moved++;
+            }
+            applied = true;
+            break;
+        default:
+            break;
+        }
+        if (!applied) {
+            DIAG(LOG("invalid patch operation: %.*s", tpl.size(iOp), tpl[iOp].pos));
+            return false;
+        }
+        (loop.widget ? loop.widget : widget)->setLayoutDirty();
+        return true;
+    }
+
+    bool Application::patchField(PatchTarget& target, Widget* widget, int iEntry, int fEntry, int& field, bool recurse) {
+        // definition items in template value order, matching children as the construction does: each wildcar
+        // takes one value and each loop the list of its rows (nested templates do not construct children)
+        auto& children(widget->getChildren());
+        size_t iChild(0);
+        while (iEntry < fEntry) {
+            const auto& entry(tree[iEntry]);
+            if (entry.type() == MLParser::EntryType::Id) {
+                int valEntry(iEntry + 1), n(0);
+                for (int i = valEntry; i < tree[valEntry].next; i++)
+                    n += tree[i].type() == MLParser::EntryType::Wildcar;
+                if (field < n) {
+                    target.widget = n == 1 ? widget : nullptr; // values combined in an expression are not patched
+                    target.iEntry = iEntry;
+                    return true;
+                }
+                field -= n;
+                iEntry = tree[valEntry].next;
+            } else {
+                if (recurse && entry.type() == MLParser::EntryType::Object) {
+                    auto type(tree.asId(iEntry));
+                    while (iChild < children.size() && children[iChild]->type() != type) iChild++;
+                    if (iChild == children.size()) return false;
+                    auto* child(children[iChild++]);
+                    if (patchField(target, child, iEntry + 1, entry.next, field, child->baseType() != Identifier::Template))
+                        return true;
+                } else if (recurse && entry.type() == MLParser::EntryType::Block) {
+                    auto type(iEntry + 1 < entry.next ? tree.asId(iEntry + 1) : Identifier::InvalidId);
+                    size_t n(iChild);
+                    while (n < children.size() && children[n]->type() == type) n++;
+                    if (!field) {
+                        target = PatchTarget{ widget, iEntry, int(iChild), int(n - iChild) };
+                        return true;
+                    }
+                    field--;
+                    iChild = n;
+                }
+                iEntry = entry.next;
+            }
+        }
+        return false;
+    }
+
     void Application::onError(RequestXHR* xhr) {
+        completeRequest(xhr);
         LOG("lost query: %s", Context::strMng.get(xhr->getId()));
+        streams.erase(xhr);
         delete xhr;
     }
 
@@ -288,17 +802,87 @@ namespace webui {
         for (auto child: cons.widget->getChildren()) child->constUpdated = 0;
         auto widget(initializeConstructRecur(cons));
         if (widget) {
-            // remove non-updated children
+            widget->setLayoutDirty();
+            // remove non-updated children (memory is recycled for next template rows)
             auto& children(widget->getChildren());
-            for (auto it = children.begin(); it != children.end(); )
-                if (!(*it)->constUpdated && !(*it)->constStructural)
-                    it = children.erase(it);
-                else
-                    ++it;
+            children.erase(remove_if(children.begin(), children.end(), [this](Widget* child) {
+                        if (child->constUpdated || child->constStructural) return false;
+                        destroyWidget(child);
+                        reconcileStats.destroyed++;
+                        return true;
+                    }), children.end());
         }
         return widget;
     }
 
+    int Application::rowKeyIndex(int iObject) const {
+        // 'id: @' in the row object: index of its wildcar among the ones of the row (in evaluation order)
+        int fObject(tree[iObject].next), iValue(-1);
+        for (int i = iObject + 1; i < fObject; i = tree[i].next)
+            if (tree[i].type() == MLParser::EntryType::Id && tree.asId(i) == Identifier::id) {
+                iValue = i + 1;
+                break;
+            }
+        if (iValue < 0 || tree[iValue].type() != MLParser::EntryType::Wildcar || tree[iValue].next != iValue + 1)
+            return -1;
+        int index(0);
+        for (int i = iObject + 1; i < iValue; i++)
+            if (tree[i].type() == MLParser::EntryType::Block) { // own template iteration: one value
+                index++;
+                i = tree[i].next - 1;
+            } else if (tree[i].type() == MLParser::EntryType::Wildcar)
+                index++;
+        return index;
+    }
+
+    int Application::rowValue(int iRow, int index) const {
+        int i(iRow + 1), fRow(tpl[iRow].next);
+        for (int k = 0; k < index && i < fRow; k++) i = tpl[i].next;
+        return i < fRow ? i : -1;
+    }
+
+    bool Application::reconcileRows(Construct& cons, int iObject, int iIter, int fIter, vector<Widget*>& rows) {
+        int iKey(rowKeyIndex(iObject));
+        if (iKey < 0) return false;
+
+        // existing children by id
+        auto type(tree.asId(iObject));
+        auto& children(cons.widget->getChildren());
+        unordered_map<int, int> byId;
+        for (size_t i = cons.iChild; i < children.size(); i++)
+            if (children[i]->getId().valid() && children[i]->type() == type)
+                byId[int(children[i]->getId().getId())] = i;
+
+        // match rows by key
+        vector<int> positions; // of reused children, in row order
+        vector<bool> reused(children.size(), false);
+        for (int iRow = iIter; iRow < fIter; iRow = tpl[iRow].next) {
+            Widget* widget(nullptr);
+            int i(tpl[iRow].type() == MLParser::EntryType::List ? rowValue(iRow, iKey) : -1);
+            if (i >= 0) {
+                auto key(valueKey(tpl, i));
+                auto it(byId.find(int(key.getId())));
+                if (key.valid() && it != byId.end()) {
+                    widget = children[it->second];
+                    positions.push_back(it->second);
+                    reused[it->second] = true;
+                    byId.erase(it);
+                }
+            }
+            rows.push_back(widget);
+        }
+
+        // reused children out of the longest increasing run of positions are the ones moved
+        reconcileStats.moved += int(positions.size()) - longestIncreasing(positions);
+        vector<Widget*> reordered(children.begin(), children.begin() + cons.iChild);
+        for (auto* widget: rows)
+            if (widget) reordered.push_back(widget);
+        for (size_t i = cons.iChild; i < children.size(); i++)
+            if (!reused[i]) reordered.push_back(children[i]); // destroyed after the update unless structural
+        children.swap(reordered);
+        return true;
+    }
+
     Widget* Application::initializeConstructRecur(Construct& cons) {
         auto iEntryOrig(cons.iEntry);
         while (cons.iEntry < cons.fEntry) {
@@ -381,7 +965,10 @@ namespace webui {
                     // child widget
                     bool update(false);
                     Widget* widgetChild;
-                    while (cons.iChild < cons.widget->getChildren().size()) {
+                    if (cons.keyed) { // keyed template row
+                        widgetChild = cons.row;
+                        update = widgetChild != nullptr;
+                    } else while (cons.iChild < cons.widget->getChildren().size()) {
                         if (cons.widget->getChildren()[cons.iChild]->type() == key) {
                             widgetChild = cons.widget->getChildren()[cons.iChild]; // reuse child from current widget
                             //DIAG(LOG("reusing widget: %s", Context::strMng.get(widgetChild->getId())));
@@ -407,16 +994,19 @@ namespace webui {
                     if (!(widgetChild = initializeConstructCheckUpdate(consChild)) || (!consChild.update && !registerWidget(widgetChild)))
                         return nullptr;
                     if (!consChild.define) {
-                        if (!consChild.update) cons.widget->addChild(widgetChild);
+                        auto& children(cons.widget->getChildren());
+                        if (consChild.update)
+                            reconcileStats.reused++;
+                        else {
+                            reconcileStats.created++;
+                            if (cons.keyed) children.insert(children.begin() + cons.iChild, widgetChild);
+                            else cons.widget->addChild(widgetChild);
+                        }
                         cons.iChild++;
                     }
-                    if (widgetChild->baseType() == Identifier::Timer) {
-                        // add to list of timers
-                        auto* timer(reinterpret_cast<WidgetTimer*>(widgetChild));
-                        timer->nextExecutionMs = ctx.getTimeMs();
-                        if (!timer->repeat) timer->nextExecutionMs += timer->delay;
-                        timers.push(timer);
-                    }
+                    cons.keyed = false;
+                    if (widgetChild->baseType() == Identifier::Timer)
+                        addTimer(reinterpret_cast<WidgetTimer*>(widgetChild));
                 }
                 cons.iEntry = tree[cons.iEntry].next;
 
@@ -437,7 +1027,7 @@ namespace webui {
                             }
                         } else {
                             DIAG(LOG("run out of template values while preparing template loop %d %d", iTpl, fTpl));
-                            delete cons.widget;
+                            freeWidget(cons.widget);
                             return nullptr;
                         }
                     } else
@@ -446,7 +1036,10 @@ namespace webui {
                     //LOG("ITERATION: %d %d", iIter, fIter);
                     int iEntry(cons.iEntry);
                     int fEntry(cons.fEntry);
-                    while (iIter < fIter) {
+                    vector<Widget*> rows;
+                    bool keyed(valEntry < cons.fEntry && tree[valEntry].type() == MLParser::EntryType::Object &&
+                               reconcileRows(cons, valEntry, iIter, fIter, rows));
+                    for (int iRow = 0; iIter < fIter; iRow++) {
                         // template iteration list (widget)
                         int iWidget(-1), fWidget(-1);
                         assert(iIter >= 0);
@@ -463,6 +1056,8 @@ namespace webui {
                         fTpl = fWidget;
                         cons.iEntry = valEntry;
                         cons.fEntry = tree[valEntry].next;
+                        cons.keyed = keyed;
+                        cons.row = keyed ? rows[iRow] : nullptr;
                         if (!initializeConstructRecur(cons)) {
                             DIAG(LOG("template loop initialize construct"));
                             return nullptr;
@@ -474,6 +1069,7 @@ namespace webui {
                         // prepare next template list (widget)
                         iIter = fWidget; // next widget
                     }
+                    cons.keyed = false;
                     iTpl = fIter;
                     fTpl = fTplSave;
                     cons.iEntry = iEntry;
@@ -487,7 +1083,7 @@ namespace webui {
 
     Widget* Application::createType(Widget* widget, Identifier typeId, int iEntry, int fEntry) {
         TypeWidget* type = new TypeWidget(typeId, widget->typeSize(), { });
-        type->insert(widget->typeWidget->begin(), widget->typeWidget->end());
+        type->inherit(*widget->typeWidget);
         // add new properties
         while (iEntry < fEntry) {
             const auto& entryKey(tree[iEntry]);
@@ -517,7 +1113,7 @@ namespace webui {
                     prop.pos = type->size / prop.size;                      // store pos in size units
                     type->size += prop.size;                                // increase size
                     auto propId(tree.asIdAdd(iEntry + 1));
-                    type->insert(make_pair(propId, prop));
+                    type->add(propId, prop);
                     DIAG(LOG("adding property: %s.%s at %d+%d of type %s",
                              Context::strMng.get(typeId), Context::strMng.get(propId), prop.pos * prop.size, prop.size, toString(prop.type)));
                 }
@@ -533,7 +1129,7 @@ namespace webui {
         widgetNew->typeWidget = widget->typeWidget;
         widgetNew->copyFrom(widget);
         widgetNew->typeWidget = type;
-        delete widget;
+        freeWidget(widget);
         return widgetNew;
     }
 
@@ -565,12 +1161,12 @@ namespace webui {
 
     Widget* Application::createWidget(Identifier id, Widget* parent, int objectSize) {
         switch (id) {
-        case Identifier::Application: return new (getPtr<WidgetApplication>(objectSize)) WidgetApplication(parent);
-        case Identifier::Widget:      return new (getPtr<Widget>(objectSize)) Widget(parent);
-        case Identifier::LayoutHor:   return new (getPtr<WidgetLayout>(objectSize)) WidgetLayout(parent, 0);
-        case Identifier::LayoutVer:   return new (getPtr<WidgetLayout>(objectSize)) WidgetLayout(parent, 1);
-        case Identifier::Template:    return new (getPtr<WidgetTemplate>(objectSize)) WidgetTemplate(parent);
-        case Identifier::Timer:       return new (getPtr<WidgetTimer>(objectSize)) WidgetTimer(parent);
+        case Identifier::Application: return new (getPtr<WidgetApplication>(arena, objectSize)) WidgetApplication(parent);
+        case Identifier::Widget:      return new (getPtr<Widget>(arena, objectSize)) Widget(parent);
+        case Identifier::LayoutHor:   return new (getPtr<WidgetLayout>(arena, objectSize)) WidgetLayout(parent, 0);
+        case Identifier::LayoutVer:   return new (getPtr<WidgetLayout>(arena, objectSize)) WidgetLayout(parent, 1);
+        case Identifier::Template:    return new (getPtr<WidgetTemplate>(arena, objectSize)) WidgetTemplate(parent);
+        case Identifier::Timer:       return new (getPtr<WidgetTimer>(arena, objectSize)) WidgetTimer(parent);
         default:                      break;
         }
         // copy from other widget by id
@@ -587,9 +1183,8 @@ namespace webui {
     bool Application::registerWidget(Widget* widget) {
         if (!widget->getId().valid()) {
             // set an internal id
-            static int id(0);
             char buffer[16];
-            int nBuffer(snprintf(buffer, sizeof(buffer), "@%x", id++));
+            int nBuffer(snprintf(buffer, sizeof(buffer), "@%x", internalId++));
             widget->setId(Context::strMng.add(buffer, nBuffer));
         }
         const auto& id(widget->getId());
@@ -601,6 +1196,108 @@ namespace webui {
         return true;
     }
 
+    void Application::destroyWidget(Widget* widget) {
+        for (auto* child: widget->getChildren())
+            destroyWidget(child);
+        // unregister and forget references to it
+        auto it(widgets.find(widget->getId()));
+        if (it != widgets.end() && it->second == widget) widgets.erase(it);
+        if (widget->baseType() == Identifier::Timer) removeTimer(reinterpret_cast<WidgetTimer*>(widget));
+        if (Input::mouseButtonWidget == widget) Input::mouseButtonWidget = nullptr;
+        if (Input::hoverWidget == widget) Input::hoverWidget = nullptr;
+        if (Context::hoverWidget == widget) Context::hoverWidget = nullptr;
+        if (hoverPainted == widget) { Context::render.damage(hoverBox); hoverPainted = nullptr; }
+        auto* parent(widget->parent);
+        if (parent && (parent->baseType() == Identifier::LayoutHor || parent->baseType() == Identifier::LayoutVer))
+            reinterpret_cast<WidgetLayout*>(parent)->forget(widget);
+        freeWidget(widget);
+    }
+
+    void Application::freeWidget(Widget* widget) {
+        int size(widget->typeSize());
+        widget->~Widget();
+        arena.free(widget, size);
+    }
+
+    bool Application::needsCompaction() const {
+        // amortized: when memory doubles
+        return Context::actions.size() * int(sizeof(Command)) > 2 * memoryStats.actionsLive + 64 * 1024 ||
+            Context::strMng.getLiveBytes() > 2 * memoryStats.stringsLive + 64 * 1024 ||
+            int(actionTables.size() * sizeof(ActionTable)) > 2 * memoryStats.tablesLive + 16 * 1024;
+    }
+
+    void Application::compact() {
+        // live widgets: registered ones and their descendants
+        vector<Widget*> live;
+        for (const auto& idWidget: widgets)
+            live.push_back(idWidget.second);
+        for (size_t i = 0; i < live.size(); i++)
+            for (auto* child: live[i]->getChildren()) {
+                auto it(widgets.find(child->getId()));
+                if (it == widgets.end() || it->second != child) live.push_back(child);
+            }
+
+        // action tables (0 is the empty one)
+        vector<int> tableMap(actionTables.size(), 0);
+        for (auto* widget: live)
+            tableMap[widget->actions] = 1;
+        int nTables(1);
+        for (size_t i = 1; i < actionTables.size(); i++)
+            if (tableMap[i]) {
+                actionTables[nTables] = actionTables[i];
+                tableMap[i] = nTables++;
+            }
+        memoryStats.tablesDead = int((actionTables.size() - nTables) * sizeof(ActionTable));
+        memoryStats.tablesLive = int(nTables * sizeof(ActionTable));
+        actionTables.resize(nTables);
+        actionTables.shrink_to_fit();
+        for (auto* widget: live)
+            widget->actions = tableMap[widget->actions];
+
+        // action programs
+        vector<int*> iActions;
+        for (auto& table: actionTables)
+            for (auto& iAction: table.actions)
+                iActions.push_back(&iAction);
+        memoryStats.actionsDead = Context::actions.compact(iActions) * int(sizeof(Command));
+        memoryStats.actionsLive = Context::actions.size() * int(sizeof(Command));
+
+        // strings
+        auto& strMng(Context::strMng);
+        int stringsBefore(strMng.getLiveBytes());
+        strMng.beginMark();
+        for (auto* widget: live) {
+            for (auto offset: widget->typeWidget->getStringIds())
+                strMng.mark(*reinterpret_cast<const StringId*>(reinterpret_cast<const char*>(widget) + offset));
+            for (const TypeWidget* type = widget->typeWidget; type; type = type->getBase()) {
+                strMng.mark(StringId(type->type));
+                for (const auto& entry: type->getProperties())
+                    strMng.mark(StringId(entry.id));
+            }
+        }
+        for (const auto& idWidget: widgets)
+            strMng.mark(idWidget.first);
+        for (const auto& table: actionTables)
+            for (auto iAction: table.actions)
+                if (iAction) Context::actions.markStrings(iAction, strMng);
+        for (const auto& font: fonts)
+            strMng.mark(font.first);
+        for (const auto* xhr: RequestXHR::getPending()) {
+            strMng.mark(xhr->getId());
+            strMng.mark(xhr->getReq());
+        }
+        for (const auto& request: requests) {
+            strMng.mark(request.id);
+            strMng.mark(request.req);
+        }
+        strMng.sweep();
+        memoryStats.stringsLive = strMng.getLiveBytes();
+        memoryStats.stringsDead = stringsBefore - memoryStats.stringsLive;
+        DIAG(LOG("compaction: strings %d/%d, actions %d/%d, tables %d/%d bytes live/released",
+                 memoryStats.stringsLive, memoryStats.stringsDead, memoryStats.actionsLive, memoryStats.actionsDead,
+                 memoryStats.tablesLive, memoryStats.tablesDead));
+    }
+
     bool Application::checkActions() {
         bool dev(true);
         unordered_set<int> iActions;
@@ -609,7 +1306,10 @@ namespace webui {
             for (auto action: table.actions) {
                 if (!iActions.count(action)) {
                     iActions.insert(action);
-                    dev &= Context::actions.execute<true>(action, idWidget.second);
+                    if (Context::actions.execute<true>(action, idWidget.second))
+                        Context::actions.optimize(action);
+                    else
+                        dev = false;
                 }
             }
         }
@@ -644,15 +1344,92 @@ namespace webui {
             if (font.first == str) return &font - fonts.data();
         // add font
         fonts.push_back(make_pair(str, nullptr));
-        new RequestXHR(Identifier::font, str);
+        request(Identifier::font, str);
         return fonts.size() - 1;
     }
 
     bool Application::executeQuery(StringId query, StringId widgetId) {
-        new RequestXHR(widgetId, query);
+        return request(widgetId, query);
+    }
+
+    bool Application::request(StringId id, StringId req) {
+        char buffer[1024];
+        string query(RequestXHR::buildQuery(id, req, buffer, sizeof(buffer)));
+        bool isWidget(id != Identifier::font && id != Identifier::Application);
+        for (auto& request: requests) {
+            if (request.superseded || request.id != id) continue;
+            if (request.query == query) {
+                requestStats.collapsed++;
+                return true;
+            }
+            if (isWidget) {
+                requestStats.superseded++;
+                if (!request.xhr) {
+                    // not sent yet: send the new one instead
+                    request.req = req;
+                    request.query = query;
+                    return true;
+                }
+                request.superseded = true;
+            }
+        }
+        requests.push_back(Request{ id, req, query, nullptr, false });
+        dispatchRequests();
         return true;
     }
 
+    void Application::dispatchRequests() {
+        if (dispatching) return; // a request completed while being sent
+        dispatching = true;
+        while (true) {
+            // best queued request, if there is room
+            int inFlight(0), best(-1), bestPriority(-1);
+            for (int i = 0; i < int(requests.size()); i++)
+                if (requests[i].xhr)
+                    inFlight++;
+                else {
+                    int priority(2);
+                    if (requests[i].id != Identifier::font) {
+                        auto it(widgets.find(requests[i].id));
+                        priority = it != widgets.end() && it->second->isGloballyVisible();
+                    }
+                    if (priority > bestPriority) {
+                        best = i;
+                        bestPriority = priority;
+                    }
+                }
+            if (best < 0 || inFlight >= MaxRequests) break;
+            auto* xhr(new RequestXHR(requests[best].id, requests[best].req, nullptr, 0));
+            requests[best].xhr = xhr;
+            requestStats.sent++;
+            xhr->query(); // can complete right away
+        }
+        dispatching = false;
+    }
+
+    Application::Request* Application::findRequest(const RequestXHR* xhr) {
+        for (auto& request: requests)
+            if (request.xhr == xhr) return &request;
+        return nullptr;
+    }
+
+    bool Application::completeRequest(RequestXHR* xhr) {
+        auto* request(findRequest(xhr));
+        if (!request) return true; // not scheduled
+        bool superseded(request->superseded);
+        requests.erase(requests.begin() + (request - requests.data()));
+        dispatchRequests();
+        return !superseded;
+    }
+
+    Application::RequestStats Application::getRequestStats() const {
+        auto stats(requestStats);
+        stats.inFlight = stats.queued = 0;
+        for (const auto& request: requests)
+            (request.xhr ? stats.inFlight : stats.queued)++;
+        return stats;
+    }
+
     int Application::getWidgetRange(StringId widgetId) const {
         const char* id(Context::strMng.get(widgetId));
         int len(strlen(id));
@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include "arena.h"
 #include "types.h"
 #include "vector.h"
 #include "ml_parser.h"
@@ -24,15 +25,18 @@ namespace webui {
     class MLParser;
     struct Property;
     class WidgetTemplate;
+    class WidgetTimer;
 
     class Application {
+        friend class Image;
+
     public:
         Application();
         DIAG(~Application());
         void initialize();
 
-        // wipes-out application definition
-        DIAG(void clear());
+        // wipes-out application definition (also after a failed load)
+        void clear();
 
         // resize
         void resize(int width, int height);
@@ -40,9 +44,10 @@ namespace webui {
         // check if application status needs update
         void refresh();
         bool update();
+        int getIdleMs() const; // until refresh() has work without new input (animation frame, timers, hover)
 
-        // render
-        void render();
+        // render (only the damaged region); returns false if nothing changed
+        bool render();
 
         // actions
         struct ActionTable {
@@ -68,6 +73,17 @@ namespace webui {
         // XHR
         bool onLoad(RequestXHR* xhr);
         void onError(RequestXHR* xhr);
+        bool onProgress(RequestXHR* xhr, const char* data, int nData); // returns true if data is consumed
+
+        // scheduled requests (fonts and queries): an identical one in flight or queued absorbs the new one, a
+        // different query for the same widget supersedes the previous one (its response is discarded) and at
+        // most MaxRequests are in flight, sending first fonts, then queries of visible widgets
+        bool request(StringId id, StringId req);
+        struct RequestStats {
+            int sent, collapsed, superseded; // totals
+            int inFlight, queued;
+        };
+        RequestStats getRequestStats() const;
 
         // template
         bool updateTemplate(WidgetTemplate* widget, int iTpl, int fTpl);
@@ -75,55 +91,142 @@ namespace webui {
         bool startTemplate(int& iTpl, int& fTpl);
         bool endTemplate();
 
+        // children of the last template update: rows with an id from template data ('id: @') are matched by
+        // key with the existing children, which are reordered moving the ones out of the longest run kept
+        struct ReconcileStats {
+            int reused, moved, created, destroyed;
+        };
+        inline const ReconcileStats& getReconcileStats() const { return reconcileStats; }
+
+        // template data patch: response 'Patch { seq: <n> ... }' to a template query, with operations applied
+        // in place to the rows of the template ('data: [ ... ]' replaces all of them first, as a snapshot)
+        //   update { path: <row> field: <index> value: <value> }
+        //   insert { path: <loop> row: [ ... ] before: <key> }
+        //   remove { path: <row> }
+        //   move   { path: <row> before: <key> }
+        // paths alternate value index (of a loop) and row key from the template, like [ 0, key, 4, key ];
+        // 'before' is optional (end of the loop); patches apply in sequence: stale ones are rejected, and
+        // after a gap or an error only a snapshot is accepted
+        bool applyPatch(StringId widgetId, int iEntry, int fEntry);
+
         // timers
         void triggerTimers();
 
+        // memory reclamation: releases strings, action programs and action tables not used by any widget
+        // (called from refresh() when they have grown enough since the last time)
+        struct MemoryStats {
+            // bytes kept and released by the last compaction
+            int stringsLive, stringsDead;
+            int actionsLive, actionsDead;
+            int tablesLive, tablesDead;
+        };
+        void compact();
+        inline const MemoryStats& getMemoryStats() const { return memoryStats; }
+
         // debug
         DIAG(void dump(bool detail = false, bool actions = false) const);
         inline auto* getRoot() { return root; }
         inline auto& getWidgets() { return widgets; }
-        /*TODO*/bool executeQuery(StringId query, StringId widgetId);
+        inline const Arena& getArena() const { return arena; }
+        bool executeQuery(StringId query, StringId widgetId);
         Widget* createWidget(Identifier id, Widget* parent, int objectSize = 0);
 
     private:
         MLParser tree, tpl;    // application tree description and template data
         int iTpl, fTpl;
         bool startedTpl;
+        ReconcileStats reconcileStats;
+
+        // template data parsed (and instantiated) while it is received
+        struct Stream {
+            MLParser parser;
+            int iEntry;        // next root item to instantiate
+            StringId rows;     // template whose rows are being instantiated while received
+            int iRow;          // next row to append to it
+            uint32_t hash;     // of the data received
+            bool ok;
+        };
+        std::unordered_map<const RequestXHR*, Stream> streams;
+        bool onLoadStream(RequestXHR* xhr, Stream& stream);
+        bool setDataStreamed(Stream& stream, StringId widgetId, int iData);
+        bool streamRows(Stream& stream, StringId widgetId, int iData);
+        static int rowsLoop(const MLParser& tree);
+        bool appendTemplate(WidgetTemplate* tplWidget, int iRow, int fRow);
+
+        // scheduled requests
+        enum { MaxRequests = 4 };
+        struct Request {
+            StringId id, req;
+            std::string query;  // with the parameters of the widget when requested
+            RequestXHR* xhr;    // in flight (null if queued)
+            bool superseded;
+        };
+        std::vector<Request> requests;
+        RequestStats requestStats;
+        bool dispatching;
+        Request* findRequest(const RequestXHR* xhr);
+        bool completeRequest(RequestXHR* xhr); // false if the response is discarded
+        void dispatchRequests();
 
-        // layout
-        bool layoutStable;
+        // render
+        const Widget* hoverPainted;  // hover action in the last frame (compared only), its cursor and bounds
+        V2f hoverCursor;
+        Box4f hoverBox;
+        void renderFrame();
 
         std::vector<ActionTable> actionTables;
+        MemoryStats memoryStats;
+        bool needsCompaction() const;
 
         // widget tree and registration
+        Arena arena;
         Widget* root;
         std::unordered_map<StringId, Widget*, StringId> widgets;
+        int internalId;        // next id for widgets without one
 
         // fonts
         std::vector<std::pair<StringId, char*>> fonts;
 
         struct Construct {
             Construct(Widget* widget, int iEntry, int fEntry, bool recurse, bool update):
-                widget(widget), iEntry(iEntry), fEntry(fEntry), define(false), recurse(recurse), update(update), iChild(0) { }
+                widget(widget), iEntry(iEntry), fEntry(fEntry), define(false), recurse(recurse), update(update),
+                keyed(false), row(nullptr), iChild(0) { }
             Widget* widget;
             int iEntry, fEntry;
             bool define;    // if a definition in this object is found, is set to true
             bool recurse;   // whether to get into children or not
             bool update;    // object has to update only his templatized attributes
             bool constUpdatedOrig;
+            bool keyed;     // next child is a keyed template row: row (or a new widget if null) at iChild
+            Widget* row;
             size_t iChild;
         };
         Widget* initializeConstruct();
         Widget* initializeConstructRecur(Construct& cons);
         Widget* initializeConstructCheckUpdate(Construct& cons);
+        int rowKeyIndex(int iObject) const;
+        int rowValue(int iRow, int index) const;
+        bool reconcileRows(Construct& cons, int iObject, int iIter, int fIter, std::vector<Widget*>& rows);
+
+        // template data patches
+        struct PatchTarget {
+            Widget* widget;     // owner of the value
+            int iEntry;         // key: value or loop of the definition taking it
+            int iChild, nChild; // loop: children made by it
+        };
+        bool patchField(PatchTarget& target, Widget* widget, int iEntry, int fEntry, int& field, bool recurse);
+        bool patchOperation(WidgetTemplate* tplWidget, int iOp);
 
         // widget factory and registration
         bool isWidget(Identifier id) const;
         bool registerWidget(Widget* widget);
+        void destroyWidget(Widget* widget); // with its children, unregistering them
+        void freeWidget(Widget* widget);
         int getWidgetRange(StringId widgetId) const;
         Widget* createType(Widget* widget, Identifier typeId, int iEntry, int fEntry);
 
         // provide server data to widget(s)
+        WidgetTemplate* getTemplate(StringId widgetId);
         bool setData(StringId widgetId, int iTpl, int fTpl);
         bool setDataMultiple(int iEntry, int fEntry);
 
@@ -132,6 +235,7 @@ namespace webui {
 
         // timers
         bool refreshTimers(); // returns true on command execution
+        void addTimer(WidgetTimer* timer);
     };
 
 }
@@ -0,0 +1,72 @@
+/*  -*- mode: c++; coding: utf-8; c-file-style: "stroustrup"; -*-
+
+    Contributors: Asier Aguirre
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include "arena.h"
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+using namespace std;
+
+namespace webui {
+
+    Arena::~Arena() {
+        for (auto* slab: slabs)
+            ::free(slab);
+    }
+
+    void* Arena::alloc(int size) {
+        auto& pool(getPool(roundSize(size)));
+        char* ptr;
+        if (pool.freeList) {
+            // recycle
+            ptr = reinterpret_cast<char*>(pool.freeList);
+            pool.freeList = pool.freeList->next;
+            recycled++;
+        } else {
+            if (pool.pos + pool.size > pool.end) {
+                // new slab for this size (the rest of the previous one is wasted)
+                int n(max(int(SlabSize), pool.size));
+                slabs.push_back(reinterpret_cast<char*>(malloc(n)));
+                pool.pos = slabs.back();
+                pool.end = pool.pos + n;
+            }
+            ptr = pool.pos;
+            pool.pos += pool.size;
+        }
+        memset(ptr, 0, pool.size);
+        live++;
+        return ptr;
+    }
+
+    void Arena::free(void* ptr, int size) {
+        if (!ptr) return;
+        auto& pool(getPool(roundSize(size)));
+        auto* obj(reinterpret_cast<FreeObject*>(ptr));
+        obj->next = pool.freeList;
+        pool.freeList = obj;
+        live--;
+    }
+
+    int Arena::getFree(int size) const {
+        int n(0);
+        size = roundSize(size);
+        for (const auto& pool: pools)
+            if (pool.size == size)
+                for (auto* obj = pool.freeList; obj; obj = obj->next) n++;
+        return n;
+    }
+
+    Arena::Pool& Arena::getPool(int size) {
+        for (auto& pool: pools)
+            if (pool.size == size) return pool;
+        pools.push_back(Pool{ size, nullptr, nullptr, nullptr });
+        return pools.back();
+    }
+
+}
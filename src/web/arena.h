@@ -0,0 +1,54 @@
+/*  -*- mode: c++; coding: utf-8; c-file-style: "stroustrup"; -*-
+
+    Contributors: Asier Aguirre
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include <vector>
+
+namespace webui {
+
+    // slab allocator for widgets: objects of the same (rounded) size share a pool carved from big slabs,
+    // freed objects are kept in a per-size free list and recycled by the next allocation of that size
+    class Arena {
+    public:
+        Arena(): live(0), recycled(0) { }
+        ~Arena();
+
+        // zero initialized memory (so that default value of properties is reset)
+        void* alloc(int size);
+        void free(void* ptr, int size);
+
+        // statistics
+        inline int getSlabs() const { return int(slabs.size()); }
+        inline int getLive() const { return live; }
+        inline int getRecycled() const { return recycled; }
+        int getFree(int size) const;
+
+    private:
+        enum { SlabSize = 64 * 1024, Align = 16 };
+
+        struct FreeObject {
+            FreeObject* next;
+        };
+
+        struct Pool {
+            int size;
+            FreeObject* freeList;
+            char* pos;           // bump allocation in current slab
+            char* end;
+        };
+
+        std::vector<Pool> pools; // few sizes: linear search
+        std::vector<char*> slabs;
+        int live, recycled;
+
+        static inline int roundSize(int size) { return (size + Align - 1) & -Align; }
+        Pool& getPool(int size);
+    };
+
+}
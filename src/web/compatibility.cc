@@ -11,6 +11,7 @@
 #include "context.h"
 #include "application.h"
 #include <stdlib.h>
+#include <algorithm>
 
 #ifdef __EMSCRIPTEN__
 #  include "compatibility_emscripten.cc"
@@ -37,12 +38,23 @@ namespace webui {
     }
 
     // class RequestXHR common part
+    vector<RequestXHR*> RequestXHR::pending;
+
     RequestXHR::RequestXHR(StringId id, StringId req):
-        id(id), req(req), data(nullptr), nData(0) {
+        id(id), req(req), data(nullptr), nData(0), capacity(0), transfer(nullptr) {
+        addPending();
         query();
     }
 
-    char* RequestXHR::buildQuery(char* buffer, int nBuffer) {
+    void RequestXHR::addPending() {
+        pending.push_back(this);
+    }
+
+    void RequestXHR::removePending() {
+        pending.erase(find(pending.begin(), pending.end(), this));
+    }
+
+    char* RequestXHR::buildQuery(StringId id, StringId req, char* buffer, int nBuffer) {
         int iBuffer(snprintf(buffer, nBuffer, "%s?id=%s", Context::strMng.get(req), Context::strMng.get(id)));
 
         // get params from widget
@@ -83,7 +95,7 @@ namespace webui {
 
     void RequestXHR::makeCString() {
         // add zero at the end (required by JSON)
-        data = (char*)realloc(data, nData + 1);
+        if (nData + 1 > capacity) data = (char*)realloc(data, capacity = nData + 1);
         data[nData] = 0;
     }
 
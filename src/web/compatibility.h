@@ -82,8 +82,17 @@ namespace webui {
         inline StringId getId() const { return id; }
         inline StringId getReq() const { return req; }
 
+        // requests not yet destroyed
+        static inline const std::vector<RequestXHR*>& getPending() { return pending; }
+
+        // query of a request: url with the parameters of the widget
+        static char* buildQuery(StringId id, StringId req, char* buffer, int nBuffer);
+
+        // delivers completed requests (desktop transfers progress only here, browser ones by themselves);
+        // returns the number of transfers in flight
+        static int poll();
+
     private:
-        char* buildQuery(char* buffer, int nBuffer);
         static void onLoadStatic(void* ctx, void* buffer, int nBuffer);
         static void onErrorStatic(void* ctx);
         static size_t onAddDataStatic(char* data, size_t size, size_t nmemb, RequestXHR* xhr);
@@ -94,7 +103,12 @@ namespace webui {
         StringId id;
         StringId req;
         char* data;
-        int nData;
+        int nData, capacity;
+        void* transfer;     // desktop: transfer in flight
+
+        static std::vector<RequestXHR*> pending;
+        void addPending();
+        void removePending();
     };
 
 }
@@ -6,10 +6,23 @@
     BSD-style license that can be found in the LICENSE.txt file.
 */
 
+#include "http_cache.h"
+#include <mutex>
 #include <thread>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cstdio>
 #include <cstring>
 #include <cassert>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <strings.h>
 #include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <condition_variable>
 #include <curl/curl.h>
 
 using namespace std;
@@ -17,9 +30,160 @@ using namespace webui;
 
 namespace {
 
-    char curlErrorBuffer[CURL_ERROR_SIZE];
     const char* curlServerAddr("127.0.0.1:9999");
 
+    // asynchronous requests: transfers of a multi handle, progressed by RequestXHR::poll() from the main
+    // loop; the multi handle keeps a pool of connections alive between requests and finished easy handles
+    // are reused
+    const long MaxHostConnections(6); // in parallel, as browsers do
+    const int MaxIdleHandles(8);
+    const int TransferPollMs(10);     // transfers without sockets yet (name resolution)
+    CURLM* curlMulti(nullptr);
+    vector<CURL*> curlIdle;
+    int curlRunning(0);
+
+    CURLM* multi() {
+        if (!curlMulti && (curlMulti = curl_multi_init())) {
+            curl_multi_setopt(curlMulti, CURLMOPT_MAX_HOST_CONNECTIONS, MaxHostConnections);
+            curl_multi_setopt(curlMulti, CURLMOPT_MAXCONNECTS, MaxHostConnections); // idle ones kept alive
+        }
+        return curlMulti;
+    }
+
+    void releaseHandle(CURL* conn) {
+        if (int(curlIdle.size()) < MaxIdleHandles)
+            curlIdle.push_back(conn);
+        else
+            curl_easy_cleanup(conn);
+    }
+
+    // HTTP cache (files in the cache directory, if any)
+    HttpCache httpCache;
+
+    // state of a request in flight
+    struct Transfer {
+        CURL* conn;
+        string url;
+        curl_slist* headers;      // validators sent
+        HttpCache::Entry response; // validators and body received (if cacheable)
+    };
+
+    size_t onHeader(char* header, size_t size, size_t nitems, Transfer* transfer) {
+        size_t n(size * nitems);
+        string line(header, n);
+        while (!line.empty() && (line.back() == '\r' || line.back() == '\n' || line.back() == ' ')) line.pop_back();
+        HttpCache::parseHeader(transfer->response, line);
+        return n;
+    }
+
+    void finishTransfer(Transfer* transfer) {
+        curl_multi_remove_handle(curlMulti, transfer->conn);
+        releaseHandle(transfer->conn);
+        curl_slist_free_all(transfer->headers);
+        delete transfer;
+    }
+
+    // main loop wake-up by transfers: while the main loop sleeps, a thread waits on the sockets of the
+    // transfers and posts an empty event as soon as any of them is ready
+    thread watcher;
+    mutex watchMtx;
+    condition_variable watchCond;
+    vector<pollfd> watchFds;
+    bool watchArmed(false), watchStop(false);
+    int watchPipe[2] = { -1, -1 }; // interrupts the wait when the main loop wakes up by other means
+
+    void watchTransfers() {
+        vector<pollfd> fds;
+        while (true) {
+            {
+                unique_lock<mutex> lock(watchMtx);
+                watchCond.wait(lock, []() { return watchArmed || watchStop; });
+                if (watchStop) return;
+                fds = watchFds;
+            }
+            fds.push_back(pollfd{ watchPipe[0], POLLIN, 0 });
+            poll(fds.data(), fds.size(), -1);
+            char buffer[16];
+            while (read(watchPipe[0], buffer, sizeof(buffer)) > 0) ;
+            bool ready(false);
+            for (size_t i = 0; i < fds.size() - 1; i++) ready |= fds[i].revents != 0;
+            lock_guard<mutex> lock(watchMtx);
+            if (watchArmed && ready) {
+                watchArmed = false;
+                glfwPostEmptyEvent();
+            }
+        }
+    }
+
+    bool armWatcher() {
+        fd_set fdRead, fdWrite, fdExcept;
+        FD_ZERO(&fdRead);
+        FD_ZERO(&fdWrite);
+        FD_ZERO(&fdExcept);
+        int maxFd(-1);
+        if (!curlRunning || CURLM_OK != curl_multi_fdset(curlMulti, &fdRead, &fdWrite, &fdExcept, &maxFd) || maxFd < 0)
+            return false;
+        if (watchPipe[0] < 0) {
+            if (pipe(watchPipe)) return false;
+            fcntl(watchPipe[0], F_SETFL, O_NONBLOCK);
+            watcher = thread(watchTransfers);
+        }
+        lock_guard<mutex> lock(watchMtx);
+        watchFds.clear();
+        for (int fd = 0; fd <= maxFd; fd++) {
+            short events((FD_ISSET(fd, &fdRead) ? POLLIN : 0) | (FD_ISSET(fd, &fdWrite) ? POLLOUT : 0) |
+                         (FD_ISSET(fd, &fdExcept) ? POLLPRI : 0));
+            if (events) watchFds.push_back(pollfd{ fd, events, 0 });
+        }
+        watchArmed = true;
+        watchCond.notify_one();
+        return true;
+    }
+
+    void disarmWatcher() {
+        lock_guard<mutex> lock(watchMtx);
+        if (watchArmed) {
+            watchArmed = false;
+            if (write(watchPipe[1], "", 1) < 0) LOG("cannot interrupt transfer watch");
+        }
+    }
+
+    void stopWatcher() {
+        if (!watcher.joinable()) return;
+        {
+            lock_guard<mutex> lock(watchMtx);
+            watchStop = true;
+            watchCond.notify_one();
+        }
+        if (write(watchPipe[1], "", 1) < 0) LOG("cannot interrupt transfer watch");
+        watcher.join();
+    }
+
+    // main loop sleep: until the application or the transfers have work, or an input or transfer wakes it up
+    void sleepIdle() {
+        int idleMs(ctx.getIdleMs());
+        if (curlRunning) {
+            long curlMs(-1);
+            curl_multi_timeout(curlMulti, &curlMs);
+            if (curlMs >= 0) idleMs = min(idleMs, int(curlMs));
+        }
+        if (idleMs <= 0) return;
+        if (armWatcher()) {
+            glfwWaitEventsTimeout(idleMs * 0.001);
+            disarmWatcher();
+        } else
+            glfwWaitEventsTimeout((curlRunning ? min(idleMs, TransferPollMs) : idleMs) * 0.001);
+    }
+
+    // main loop statistics (logged periodically)
+    DIAG(const int LoopStatsMs(10000));
+    DIAG(int cpuTimeMs() {
+            struct rusage usage;
+            getrusage(RUSAGE_SELF, &usage);
+            return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000 +
+                (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000;
+        });
+
     // cursors
     GLFWcursor* cursors[int(Cursor::Last)];
 
@@ -40,6 +204,17 @@ namespace webui {
             LOG("no server address specified, using: %s", curlServerAddr);
             LOG("use: %s [<domain | IP>[:<port>]]", argv[0]);
         }
+
+        // disk cache
+        const char* xdgCache(getenv("XDG_CACHE_HOME"));
+        const char* home(getenv("HOME"));
+        if (xdgCache || home) {
+            string cacheDir(xdgCache ? xdgCache : home + "/.cache"s);
+            mkdir(cacheDir.c_str(), 0700);
+            cacheDir += "/nanoWeb";
+            mkdir(cacheDir.c_str(), 0700);
+            httpCache.setDirectory(cacheDir);
+        }
     }
 
     void setMainLoop(void (*loop)(void)) {
@@ -47,11 +222,26 @@ namespace webui {
         cursors[1] = glfwCreateStandardCursor(GLFW_CROSSHAIR_CURSOR);
         cursors[2] = glfwCreateStandardCursor(GLFW_HAND_CURSOR);
 
-        // synchronous main loop
+        // event-driven main loop
+        DIAG(int statsMs(getTimeNowMs()); int statsCpuMs(cpuTimeMs()); auto stats(ctx.getLoopStats()));
         while (mainLoopRunning) {
             loop();
-            this_thread::sleep_for(chrono::milliseconds(10));
+            sleepIdle();
+            DIAG(
+                // idle cost and responsiveness
+                auto now(getTimeNowMs());
+                if (now - statsMs >= LoopStatsMs) {
+                    const auto& s(ctx.getLoopStats());
+                    int cpuMs(cpuTimeMs());
+                    LOG("main loop: %d iterations, %d frames in %d ms, cpu %.1f%%, input latency %d ms (max %d ms)",
+                        s.iterations - stats.iterations, s.frames - stats.frames, now - statsMs,
+                        100.f * (cpuMs - statsCpuMs) / (now - statsMs), s.inputLatencyMs, s.maxInputLatencyMs);
+                    statsMs = now;
+                    statsCpuMs = cpuMs;
+                    stats = s;
+                });
         };
+        stopWatcher();
     }
 
     void cancelMainLoop() {
@@ -82,66 +272,125 @@ namespace webui {
 
     // class RequestXHR
     RequestXHR::RequestXHR(StringId id, StringId req, const char* data_, int nData):
-        id(id), req(req), data(nullptr), nData(nData) {
+        id(id), req(req), data(nullptr), nData(nData), capacity(0), transfer(nullptr) {
+        addPending();
         if (nData && data_) {
-            data = (char*)malloc(nData);
+            data = (char*)malloc(capacity = nData);
             memcpy(data, data_, nData);
         }
     }
 
     RequestXHR::~RequestXHR() {
+        removePending();
+        if (transfer) finishTransfer(reinterpret_cast<Transfer*>(transfer));
         free(data);
     }
 
     void RequestXHR::query() {
         char buffer[1024];
-        const char* req(buildQuery(buffer, sizeof(buffer)));
-        // perform the request synchronously
-        CURL *conn(curl_easy_init());
-        if (!conn) {
-            LOG("libcurl: error setting connection");
-            return;
-        }
-        CURLcode code;
-        if (CURLE_OK != (code = curl_easy_setopt(conn, CURLOPT_ERRORBUFFER, curlErrorBuffer))) {
-            LOG("libcurl: error setting error buffer %d", code);
-            return;
-        }
+        const char* path(buildQuery(id, req, buffer, sizeof(buffer)));
         // compose URL
-        string url("http://"s + curlServerAddr + '/' + req);
+        string url("http://"s + curlServerAddr + '/' + path);
         LOG("{%s}", url.c_str());
 
-        if (CURLE_OK != (code = curl_easy_setopt(conn, CURLOPT_URL, url.c_str()))) {
-            LOG("libcurl: error setting URL %d: %s", code, curlErrorBuffer);
-            return;
+        // start the transfer: it progresses and completes in poll()
+        CURL* conn;
+        if (curlIdle.empty())
+            conn = curl_easy_init();
+        else {
+            conn = curlIdle.back();
+            curlIdle.pop_back();
         }
-        if (CURLE_OK != (code = curl_easy_setopt(conn, CURLOPT_FOLLOWLOCATION, 1L))) {
-            LOG("libcurl: error setting redirections %d: %s", code, curlErrorBuffer);
+        if (!conn) {
+            LOG("libcurl: error setting connection");
+            onError();
             return;
         }
-        if (CURLE_OK != (code = curl_easy_setopt(conn, CURLOPT_WRITEFUNCTION, onAddDataStatic))) {
-            LOG("libcurl: error setting writer %d: %s", code, curlErrorBuffer);
+        auto* t(new Transfer{ conn, url, nullptr, HttpCache::Entry() });
+        if (auto* cached = httpCache.find(url)) {
+            // revalidate
+            if (!cached->etag.empty())
+                t->headers = curl_slist_append(t->headers, ("If-None-Match: " + cached->etag).c_str());
+            if (!cached->lastModified.empty())
+                t->headers = curl_slist_append(t->headers, ("If-Modified-Since: " + cached->lastModified).c_str());
+        }
+        // compressed responses (any encoding supported by libcurl) arrive decoded to onAddData
+        CURLcode code;
+        if (CURLE_OK != (code = curl_easy_setopt(conn, CURLOPT_URL, url.c_str())) ||
+            CURLE_OK != (code = curl_easy_setopt(conn, CURLOPT_FOLLOWLOCATION, 1L)) ||
+            CURLE_OK != (code = curl_easy_setopt(conn, CURLOPT_TCP_KEEPALIVE, 1L)) ||
+            CURLE_OK != (code = curl_easy_setopt(conn, CURLOPT_ACCEPT_ENCODING, "")) ||
+            CURLE_OK != (code = curl_easy_setopt(conn, CURLOPT_HTTPHEADER, t->headers)) ||
+            CURLE_OK != (code = curl_easy_setopt(conn, CURLOPT_HEADERFUNCTION, onHeader)) ||
+            CURLE_OK != (code = curl_easy_setopt(conn, CURLOPT_HEADERDATA, t)) ||
+            CURLE_OK != (code = curl_easy_setopt(conn, CURLOPT_WRITEFUNCTION, onAddDataStatic)) ||
+            CURLE_OK != (code = curl_easy_setopt(conn, CURLOPT_WRITEDATA, this)) ||
+            CURLE_OK != (code = curl_easy_setopt(conn, CURLOPT_PRIVATE, this))) {
+            LOG("libcurl: error setting transfer %d", code);
+            finishTransfer(t);
+            onError();
             return;
         }
-        if (CURLE_OK != (code = curl_easy_setopt(conn, CURLOPT_WRITEDATA, this))) {
-            LOG("libcurl: error setting writer data %d: %s", code, curlErrorBuffer);
+        if (!multi() || CURLM_OK != curl_multi_add_handle(curlMulti, conn)) {
+            LOG("libcurl: error adding transfer");
+            finishTransfer(t);
+            onError();
             return;
         }
+        curlRunning++;
+        transfer = t;
+    }
 
-        long status;
-        code = curl_easy_perform(conn);
-        curl_easy_getinfo(conn, CURLINFO_RESPONSE_CODE, &status);
-        curl_easy_cleanup(conn);
+    int RequestXHR::poll() {
+        if (!curlMulti) return 0;
+        int running(0), nMsgs;
+        curl_multi_perform(curlMulti, &running);
+        curlRunning = running;
+        while (CURLMsg* msg = curl_multi_info_read(curlMulti, &nMsgs)) {
+            if (msg->msg != CURLMSG_DONE) continue;
+            CURL* conn(msg->easy_handle);
+            CURLcode code(msg->data.result);
+            char* priv(nullptr);
+            long status(0);
+            curl_easy_getinfo(conn, CURLINFO_PRIVATE, &priv);
+            curl_easy_getinfo(conn, CURLINFO_RESPONSE_CODE, &status);
+            auto* xhr(reinterpret_cast<RequestXHR*>(priv));
+            auto* t(reinterpret_cast<Transfer*>(xhr->transfer));
+            xhr->transfer = nullptr;
+            auto* cached(CURLE_OK == code ? httpCache.onResponse(t->url, status, move(t->response)) : nullptr);
+            finishTransfer(t);
 
-        if (CURLE_OK != code || status != 200)
-            onError();
-        else
-            onLoad(data, nData);
+            // callbacks destroy the request (and can start new ones)
+            if (CURLE_OK != code) {
+                LOG("libcurl: %s", curl_easy_strerror(code));
+                xhr->onError();
+            } else if (cached) {
+                // not modified: cached body (identical template data is not applied again)
+                char* body((char*)malloc(cached->body.size() + 1));
+                memcpy(body, cached->body.data(), cached->body.size());
+                free(xhr->data);
+                xhr->capacity = cached->body.size() + 1;
+                xhr->onLoad(body, cached->body.size());
+            } else if (status != 200)
+                xhr->onError();
+            else
+                xhr->onLoad(xhr->data, xhr->nData);
+        }
+        return running;
     }
 
     size_t RequestXHR::onAddData(char* newData, size_t size, size_t nmemb) {
         size_t newSize(size * nmemb);
-        data = (char*)realloc(data, nData + newSize + 1);
+        // copy for the cache
+        auto* t(reinterpret_cast<Transfer*>(transfer));
+        if (t && t->response.cacheable())
+            t->response.body.insert(t->response.body.end(), newData, newData + newSize);
+        // template data is parsed as it arrives
+        if (Context::app.onProgress(this, newData, newSize)) return newSize;
+        if (nData + int(newSize) + 1 > capacity) {
+            capacity = max(nData + int(newSize) + 1, capacity * 2);
+            data = (char*)realloc(data, capacity);
+        }
         memcpy(data + nData, newData, newSize);
         nData += newSize;
         return newSize;
@@ -53,15 +53,21 @@ namespace webui {
 
     // class RequestXHR
     RequestXHR::RequestXHR(StringId id, StringId req, const char* data, int nData):
-        id(id), req(req), data(nullptr), nData(0) {
+        id(id), req(req), data(nullptr), nData(0), capacity(0), transfer(nullptr) {
+        addPending();
     }
 
     RequestXHR::~RequestXHR() {
+        removePending();
     }
 
     void RequestXHR::query() {
         char buffer[1024];
-        emscripten_async_wget_data(buildQuery(buffer, sizeof(buffer)), this, onLoadStatic, onErrorStatic);
+        emscripten_async_wget_data(buildQuery(id, req, buffer, sizeof(buffer)), this, onLoadStatic, onErrorStatic);
+    }
+
+    int RequestXHR::poll() {
+        return 0;
     }
 
 }
@@ -0,0 +1,73 @@
+/*  -*- mode: c++; coding: utf-8; c-file-style: "stroustrup"; -*-
+
+    Contributors: Asier Aguirre
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include "image.h"
+#include "context.h"
+#include "application.h"
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+using namespace webui;
+
+// offline compiler: constructs an application and writes its image, to be served instead of the ML
+// description (images are only valid for builds of nanoWeb with the same widget layout: a 64-bit desktop
+// compiler does not produce images for wasm32)
+// use: nanoWebCompile <application.ml> <application.image>
+
+namespace {
+
+    char* readFile(const char* path, int& n) {
+        FILE* f(fopen(path, "rb"));
+        if (!f) return nullptr;
+        fseek(f, 0, SEEK_END);
+        n = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        char* data((char*)malloc(n));
+        if (fread(data, 1, n, f) != size_t(n)) n = 0;
+        fclose(f);
+        return data;
+    }
+
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        LOG("use: %s <application.ml> <application.image>", argv[0]);
+        return 1;
+    }
+
+    int n(0);
+    char* data(readFile(argv[1], n));
+    if (!data || !n) {
+        LOG("cannot read %s", argv[1]);
+        return 1;
+    }
+    ctx.initialize(DIAG(false, false)); // no window
+    if (!Context::app.onLoad(new RequestXHR(Identifier::Application, StringId(), data, n))) {
+        LOG("cannot load application %s", argv[1]);
+        return 1;
+    }
+    free(data);
+
+    vector<char> image;
+    if (!Image::save(image)) {
+        LOG("cannot create image of %s", argv[1]);
+        return 1;
+    }
+    FILE* f(fopen(argv[2], "wb"));
+    if (!f || fwrite(image.data(), 1, image.size(), f) != image.size()) {
+        LOG("cannot write %s", argv[2]);
+        if (f) fclose(f);
+        return 1;
+    }
+    fclose(f);
+    LOG("%s: %d bytes image", argv[2], int(image.size()));
+    return 0;
+}
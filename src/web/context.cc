@@ -10,6 +10,7 @@
 #include "input.h"
 #include "compatibility.h"
 #include <cmath>
+#include <algorithm>
 #include <cassert>
 
 using namespace std;
@@ -27,7 +28,7 @@ namespace webui {
     Widget* Context::hoverWidget;
 
 
-    Context::Context(): renderForced(true), timeMs(getTimeNowMs()) {
+    Context::Context(): renderForced(true), timeMs(getTimeNowMs()), inputMs(0), loopStats{ } {
     }
 
     DIAG(Context::~Context() {
@@ -42,7 +43,6 @@ namespace webui {
             }
             Input::init();
         }
-        addReservedWords();
         updateTime();
         app.initialize();
 
@@ -53,6 +53,10 @@ namespace webui {
     void Context::mainIteration() {
         // calculate time / and frame offset
         updateTime();
+        loopStats.iterations++;
+
+        // deliver completed requests
+        RequestXHR::poll();
 
         // refressh application
         app.refresh();
@@ -60,9 +64,20 @@ namespace webui {
         // render if required
         if (renderForced) {
             renderForced = false;
-            app.render();
-            render.swapBuffers();
+            if (app.render()) {
+                render.swapBuffers();
+                loopStats.frames++;
+                if (inputMs) {
+                    loopStats.inputLatencyMs = getTimeNowMs() - inputMs;
+                    loopStats.maxInputLatencyMs = max(loopStats.maxInputLatencyMs, loopStats.inputLatencyMs);
+                }
+            }
         }
+        inputMs = 0;
+    }
+
+    int Context::getIdleMs() const {
+        return renderForced ? 0 : app.getIdleMs();
     }
 
     void Context::resize(int width, int height) {
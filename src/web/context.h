@@ -24,6 +24,16 @@ namespace webui {
 
         void mainIteration();
 
+        // main loop: time it can sleep waiting for input, and statistics of its iterations (wake-ups), frames
+        // rendered and input latency (from the first input event of an iteration to the swap of its frame)
+        int getIdleMs() const;
+        struct LoopStats {
+            int iterations, frames;
+            int inputLatencyMs, maxInputLatencyMs;
+        };
+        inline const LoopStats& getLoopStats() const { return loopStats; }
+        inline void inputReceived() { if (!inputMs) inputMs = getTimeNowMs(); }
+
         void resize(int width, int height);
 
         inline void forceRender() { renderForced = true; }
@@ -58,6 +68,8 @@ namespace webui {
         int timeDiffMs;
         int timeRatio;
         int time1MRatio;
+        int inputMs;   // of the first input not processed yet
+        LoopStats loopStats;
 
         void updateTime();
     };
@@ -0,0 +1,200 @@
+/*  -*- mode: c++; coding: utf-8; c-file-style: "stroustrup"; -*-
+
+    Contributors: Asier Aguirre
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include "display_list.h"
+#include "widget.h"
+#include "context.h"
+#include <cstring>
+#include <cassert>
+
+using namespace std;
+using namespace webui;
+
+namespace {
+
+    inline float asFloat(uint32_t u) {
+        union { uint32_t u; float f; } pun;
+        pun.u = u;
+        return pun.f;
+    }
+
+}
+
+namespace webui {
+
+    uint32_t DisplayList::generation(1);
+    int DisplayList::replayed(0);
+    int DisplayList::executed(0);
+    uint32_t DisplayList::frame(0);
+    uint32_t DisplayList::pass(0);
+    vector<DisplayList*> DisplayList::painted;
+
+    DisplayList::~DisplayList() {
+        // painted area must be repainted (and the painted list forgets it)
+        if (paintedFrame == frame && paintedIndex >= 0) {
+            Context::render.damage(paintedBox);
+            painted[paintedIndex] = nullptr;
+        }
+    }
+
+    bool DisplayList::render(int iAction_, Widget* widget) {
+        if (valid(iAction_, widget)) {
+            replayed++;
+            replay();
+            return true;
+        }
+        executed++;
+        if (iAction_ != iAction || cacheable) {
+            // find out what the action reads
+            clear();
+            iAction = iAction_;
+            addDependency(&widget->box, sizeof(widget->box)); // text functions are relative to the box
+            cacheable = Context::actions.addDependencies(iAction, widget, *this);
+        }
+        if (!cacheable) return Context::actions.execute(iAction, widget);
+
+        // execute and record
+        commands.clear();
+        listGeneration = generation;
+        Context::render.setRecording(this);
+        bool ok(Context::actions.execute(iAction, widget));
+        Context::render.setRecording(nullptr);
+        if (!ok) invalidate();
+        return ok;
+    }
+
+    bool DisplayList::valid(int iAction_, const Widget* widget) const {
+        if (iAction_ != iAction || !cacheable || listGeneration != generation) return false;
+        for (const auto& handle: widgets)
+            if (!Widget::fromHandle(handle)) return false;
+        for (const auto& dep: deps) {
+            const char* value(values.data() + dep.offset);
+            if (dep.size < 0) {
+                const char* text(*reinterpret_cast<const char* const*>(dep.ptr));
+                if (text ? !*value || strcmp(text, value + 1) : *value) return false;
+            } else if (memcmp(dep.ptr, value, dep.size))
+                return false;
+        }
+        return true;
+    }
+
+    void DisplayList::damage(int iAction_, const Widget* widget, int alpha) {
+        checkedPass = pass;
+        bool wasPainted(paintedFrame == frame);
+        if (wasPainted && alpha == paintedAlpha && valid(iAction_, widget)) return;
+        if (wasPainted) Context::render.damage(paintedBox);
+        if (alpha) Context::render.damage(widget->box);
+    }
+
+    void DisplayList::setPainted(const Widget* widget, int alpha) {
+        if (alpha) {
+            if (paintedFrame != frame) {
+                paintedIndex = int(painted.size());
+                painted.push_back(this);
+            }
+            paintedFrame = frame;
+            paintedBox = widget->box;
+            paintedAlpha = alpha;
+        }
+    }
+
+    void DisplayList::beginDamagePass() {
+        pass++;
+    }
+
+    void DisplayList::endDamagePass() {
+        if (!Context::render.isDamagedAll())
+            for (auto* list: painted)
+                if (list && list->checkedPass != pass) Context::render.damage(list->paintedBox);
+    }
+
+    void DisplayList::beginFrame() {
+        frame++;
+        painted.clear();
+        resetStats();
+    }
+
+    void DisplayList::addDependency(const void* ptr, int size) {
+        deps.push_back(Dependency{ reinterpret_cast<const char*>(ptr), size, int(values.size()) });
+        values.insert(values.end(), reinterpret_cast<const char*>(ptr), reinterpret_cast<const char*>(ptr) + size);
+    }
+
+    void DisplayList::addTextDependency(const char* const* text) {
+        // stored as a null flag followed by a copy of the text
+        deps.push_back(Dependency{ reinterpret_cast<const char*>(text), -1, int(values.size()) });
+        values.push_back(*text != nullptr);
+        if (*text) values.insert(values.end(), *text, *text + strlen(*text) + 1);
+    }
+
+    void DisplayList::addWidgetDependency(const Widget* widget) {
+        widgets.push_back(widget->getHandle());
+    }
+
+    void DisplayList::addText(float x, float y, const char* str) {
+        int n(str ? strlen(str) : 0);
+        add(Op::Text, x, y, n);
+        int iChars(commands.size());
+        commands.resize(iChars + (n + 4) / 4);
+        if (n) memcpy(&commands[iChars], str, n);
+        reinterpret_cast<char*>(&commands[iChars])[n] = 0;
+    }
+
+    void DisplayList::clear() {
+        iAction = 0;
+        cacheable = false;
+        commands.clear();
+        widgets.clear();
+        deps.clear();
+        values.clear();
+    }
+
+    void DisplayList::replay() const {
+        auto& render(Context::render);
+        const uint32_t* c(commands.data());
+        const uint32_t* end(c + commands.size());
+        while (c < end) {
+            switch (Op(*c++)) {
+            case Op::BeginPath:      render.beginPath(); break;
+            case Op::Moveto:         render.moveto(asFloat(c[0]), asFloat(c[1])); c += 2; break;
+            case Op::Lineto:         render.lineto(asFloat(c[0]), asFloat(c[1])); c += 2; break;
+            case Op::Bezierto:
+                render.bezierto(asFloat(c[0]), asFloat(c[1]), asFloat(c[2]), asFloat(c[3]), asFloat(c[4]), asFloat(c[5]));
+                c += 6;
+                break;
+            case Op::ClosePath:      render.closePath(); break;
+            case Op::RoundedRect:
+                render.roundedRect(asFloat(c[0]), asFloat(c[1]), asFloat(c[2]), asFloat(c[3]), asFloat(c[4]));
+                c += 5;
+                break;
+            case Op::FillColor:      render.fillColor(RGBA(c[0])); c++; break;
+            case Op::FillVertGrad:   render.fillVertGrad(asFloat(c[0]), asFloat(c[1]), RGBA(c[2]), RGBA(c[3])); c += 4; break;
+            case Op::Fill:           render.fill(); break;
+            case Op::StrokeWidth:    render.strokeWidth(asFloat(c[0])); c++; break;
+            case Op::StrokeColor:    render.strokeColor(RGBA(c[0])); c++; break;
+            case Op::Stroke:         render.stroke(); break;
+            case Op::Translate:      render.translate(asFloat(c[0]), asFloat(c[1])); c += 2; break;
+            case Op::Scale:          render.scale(asFloat(c[0]), asFloat(c[1])); c += 2; break;
+            case Op::ResetTransform: render.resetTransform(); break;
+            case Op::Scissor:        render.scissor(asFloat(c[0]), asFloat(c[1]), asFloat(c[2]), asFloat(c[3])); c += 4; break;
+            case Op::ResetScissor:   render.resetScissor(); break;
+            case Op::Font:           render.font(int(c[0])); c++; break;
+            case Op::FontSize:       render.fontSize(asFloat(c[0])); c++; break;
+            case Op::TextAlign:      render.textAlign(int(c[0])); c++; break;
+            case Op::Text:
+                render.text(asFloat(c[0]), asFloat(c[1]), reinterpret_cast<const char*>(c + 3));
+                c += 3 + (c[2] + 4) / 4;
+                break;
+            default:
+                DIAG(LOG("internal error: bad display list op"));
+                assert(false);
+                return;
+            }
+        }
+    }
+
+}
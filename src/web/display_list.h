@@ -0,0 +1,120 @@
+/*  -*- mode: c++; coding: utf-8; c-file-style: "stroustrup"; -*-
+
+    Contributors: Asier Aguirre
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include "types.h"
+#include "vector.h"
+#include "widget.h"
+#include <vector>
+#include <cstdint>
+
+namespace webui {
+
+    // recorded render commands of a widget action, replayed while the memory it read does not change
+    class DisplayList {
+    public:
+        enum class Op: uint32_t {
+            BeginPath,
+            Moveto,
+            Lineto,
+            Bezierto,
+            ClosePath,
+            RoundedRect,
+            FillColor,
+            FillVertGrad,
+            Fill,
+            StrokeWidth,
+            StrokeColor,
+            Stroke,
+            Translate,
+            Scale,
+            ResetTransform,
+            Scissor,
+            ResetScissor,
+            Font,
+            FontSize,
+            TextAlign,
+            Text,                    // [ x ] [ y ] [ length ] [ chars... ]
+        };
+
+        DisplayList(): iAction(0), cacheable(false), paintedIndex(-1), paintedFrame(0), checkedPass(0) { }
+        ~DisplayList();
+
+        // replays the list if still valid for this action, otherwise executes the action (recording it
+        // if it has no side effects); returns false on execution error
+        bool render(int iAction, Widget* widget);
+        bool valid(int iAction, const Widget* widget) const;
+        inline void invalidate() { iAction = 0; }
+
+        // damage tracking: the damage pass compares what the widget would paint with what it painted in
+        // the last rendered frame, damaging old and new boxes on changes (see Application::render)
+        void damage(int iAction, const Widget* widget, int alpha);
+        void setPainted(const Widget* widget, int alpha);
+        static void beginDamagePass();
+        static void endDamagePass(); // damages lists painted in the last frame but not in this one
+        static void beginFrame();
+
+        // memory read by the action (see Actions::addDependencies)
+        void addDependency(const void* ptr, int size);
+        void addTextDependency(const char* const* text);
+        void addWidgetDependency(const Widget* widget); // other widget read: alive before its memory is compared
+
+        // recording (called from Render)
+        template <typename... Args>
+        inline void add(Op op, Args... args) { push(uint32_t(op)); push(args...); }
+        void addText(float x, float y, const char* str);
+        inline const std::vector<uint32_t>& getCommands() const { return commands; }
+
+        // invalidates all lists (fonts loaded, text metrics change)
+        static inline void invalidateAll() { generation++; }
+
+        // per frame statistics
+        static inline void resetStats() { replayed = executed = 0; }
+        static inline int getReplayed() { return replayed; }
+        static inline int getExecuted() { return executed; }
+
+    private:
+        struct Dependency {
+            const char* ptr;
+            int size;                // -1 for text (ptr is the char* holder)
+            int offset;              // position of the recorded value in values
+        };
+
+        int iAction;                 // recorded action, 0 if none
+        bool cacheable;              // action has no side effects
+        uint32_t listGeneration;
+        std::vector<uint32_t> commands;
+        std::vector<Widget::Handle> widgets;
+        std::vector<Dependency> deps;
+        std::vector<char> values;
+        Box4f paintedBox;            // painted in frame paintedFrame
+        int paintedAlpha;
+        int paintedIndex;            // in painted (if painted in this frame)
+        uint32_t paintedFrame, checkedPass;
+
+        static uint32_t generation;
+        static int replayed, executed;
+        static uint32_t frame, pass;
+        static std::vector<DisplayList*> painted;
+
+        void clear();
+        void replay() const;
+
+        inline void push() { }
+        template <typename... Args>
+        inline void push(float f, Args... args) { union { float f; uint32_t u; } pun; pun.f = f; push(pun.u, args...); }
+        template <typename... Args>
+        inline void push(RGBA c, Args... args) { push(c.rgba(), args...); }
+        template <typename... Args>
+        inline void push(int i, Args... args) { push(uint32_t(i), args...); }
+        template <typename... Args>
+        inline void push(uint32_t u, Args... args) { commands.push_back(u); push(args...); }
+    };
+
+}
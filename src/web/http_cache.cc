@@ -0,0 +1,200 @@
+/*  -*- mode: c++; coding: utf-8; c-file-style: "stroustrup"; -*-
+
+    Contributors: Asier Aguirre
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include "http_cache.h"
+#include "compatibility.h"
+#include "reserved_words.h"
+#include <tuple>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <unistd.h>
+#include <strings.h>
+#include <algorithm>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace webui {
+
+    HttpCache::HttpCache(int maxBytes): bytes(0), maxBytes(maxBytes) {
+    }
+
+    void HttpCache::setDirectory(const string& dir_) {
+        dir = dir_;
+        if (dir.empty()) return;
+        DIR* d(opendir(dir.c_str()));
+        if (!d) return;
+        vector<tuple<time_t, uint32_t, int>> files; // modification, hash, size
+        while (auto* e = readdir(d)) {
+            string path(dir + '/' + e->d_name);
+            unsigned h;
+            int n(0);
+            struct stat st;
+            if (strlen(e->d_name) > 4 && !strcmp(e->d_name + strlen(e->d_name) - 4, ".tmp"))
+                unlink(path.c_str()); // interrupted store
+            else if (sscanf(e->d_name, "%8x%n", &h, &n) == 1 && n == 8 && !e->d_name[8] &&
+                     !stat(path.c_str(), &st) && S_ISREG(st.st_mode) && !nodes.count(h))
+                files.push_back(make_tuple(st.st_mtime, h, int(st.st_size)));
+        }
+        closedir(d);
+        sort(files.begin(), files.end());
+        for (const auto& f: files) {
+            lru.push_front(get<1>(f));
+            auto& node(nodes.insert(make_pair(get<1>(f), Node{ })).first->second);
+            node.bytes = get<2>(f);
+            node.lru = lru.begin();
+            bytes += node.bytes;
+        }
+        evict();
+    }
+
+    void HttpCache::parseHeader(Entry& response, const string& line) {
+        auto value = [&line](int nName) {
+            auto start(line.find_first_not_of(' ', nName));
+            return start == string::npos ? string() : line.substr(start);
+        };
+        if (!strncasecmp(line.c_str(), "HTTP/", 5))
+            response = Entry(); // new response (redirections)
+        else if (!strncasecmp(line.c_str(), "ETag:", 5))
+            response.etag = value(5);
+        else if (!strncasecmp(line.c_str(), "Last-Modified:", 14))
+            response.lastModified = value(14);
+        else if (!strncasecmp(line.c_str(), "Cache-Control:", 14)) {
+            // comma separated directives; no-cache ones are stored as every use is revalidated anyway
+            for (size_t pos = 14; pos < line.size(); pos++) {
+                auto end(min(line.find(',', pos), line.size()));
+                pos = line.find_first_not_of(' ', pos);
+                if (pos < end && min(line.find_first_of(" =", pos), end) - pos == 8 && !strncasecmp(&line[pos], "no-store", 8))
+                    response.noStore = true;
+                pos = end;
+            }
+        }
+    }
+
+    const HttpCache::Entry* HttpCache::onResponse(const string& url, long status, Entry&& response) {
+        if (status == 304) return find(url);
+        if (status == 200) {
+            if (response.noStore)
+                remove(url); // not even a previous version
+            else if (response.cacheable())
+                store(url, move(response));
+        }
+        return nullptr;
+    }
+
+    const HttpCache::Entry* HttpCache::find(const string& url) {
+        auto h(hashString(url.data(), url.size()));
+        auto it(nodes.find(h));
+        if (it == nodes.end()) return nullptr;
+        auto& node(it->second);
+        if (node.url.empty() && !load(h, node)) {
+            erase(h);
+            return nullptr;
+        }
+        if (node.url != url) return nullptr; // name collision
+        touch(node);
+        return &node.entry;
+    }
+
+    void HttpCache::store(const string& url, Entry&& entry) {
+        auto h(hashString(url.data(), url.size()));
+        int nBytes(url.size() + entry.etag.size() + entry.lastModified.size() + entry.body.size() + 3);
+        if (nBytes > maxBytes) {
+            remove(url);
+            return;
+        }
+        if (!dir.empty()) {
+            // a complete file or none: written aside and renamed
+            string name(file(h)), tmp(name + ".tmp");
+            FILE* f(fopen(tmp.c_str(), "wb"));
+            bool ok(f);
+            if (f) {
+                ok = fprintf(f, "%s\n%s\n%s\n", url.c_str(), entry.etag.c_str(), entry.lastModified.c_str()) > 0 &&
+                    fwrite(entry.body.data(), 1, entry.body.size(), f) == entry.body.size();
+                ok = !fclose(f) && ok && !rename(tmp.c_str(), name.c_str());
+            }
+            if (!ok) {
+                DIAG(LOG("cannot store cache file for %s", url.c_str()));
+                unlink(tmp.c_str());
+                unlink(name.c_str()); // previous version
+            }
+        }
+        auto it(nodes.find(h));
+        if (it == nodes.end()) {
+            lru.push_front(h);
+            it = nodes.insert(make_pair(h, Node{ })).first;
+            it->second.lru = lru.begin();
+        }
+        auto& node(it->second);
+        bytes += nBytes - node.bytes;
+        node.url = url;
+        node.entry = move(entry);
+        node.bytes = nBytes;
+        touch(node);
+        evict();
+    }
+
+    void HttpCache::remove(const string& url) {
+        auto h(hashString(url.data(), url.size()));
+        auto it(nodes.find(h));
+        if (it != nodes.end() && (it->second.url.empty() || it->second.url == url))
+            erase(h);
+    }
+
+    string HttpCache::file(uint32_t h) const {
+        char name[16];
+        snprintf(name, sizeof(name), "/%08x", h);
+        return dir + name;
+    }
+
+    bool HttpCache::load(uint32_t h, Node& node) {
+        FILE* f(fopen(file(h).c_str(), "rb"));
+        if (!f) return false;
+        vector<char> data;
+        char buffer[4096];
+        size_t n;
+        while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+            data.insert(data.end(), buffer, buffer + n);
+        fclose(f);
+        // three lines and the body
+        string lines[3];
+        auto pos(data.begin());
+        for (auto& line: lines) {
+            auto end(std::find(pos, data.end(), '\n'));
+            if (end == data.end()) return false;
+            line.assign(pos, end);
+            pos = end + 1;
+        }
+        node.url = lines[0];
+        node.entry.etag = lines[1];
+        node.entry.lastModified = lines[2];
+        node.entry.body.assign(pos, data.end());
+        bytes += int(data.size()) - node.bytes;
+        node.bytes = data.size();
+        return true;
+    }
+
+    void HttpCache::touch(Node& node) {
+        lru.splice(lru.begin(), lru, node.lru);
+    }
+
+    void HttpCache::erase(uint32_t h) {
+        auto it(nodes.find(h));
+        bytes -= it->second.bytes;
+        lru.erase(it->second.lru);
+        nodes.erase(it);
+        if (!dir.empty()) unlink(file(h).c_str());
+    }
+
+    void HttpCache::evict() {
+        while (bytes > maxBytes && !lru.empty())
+            erase(lru.back());
+    }
+
+}
@@ -0,0 +1,73 @@
+/*  -*- mode: c++; coding: utf-8; c-file-style: "stroustrup"; -*-
+
+    Contributors: Asier Aguirre
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include <list>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+namespace webui {
+
+    // HTTP cache: responses with validators (ETag, Last-Modified) by url, in memory and in a directory (one file
+    // per url: url, ETag and Last-Modified lines followed by the body); they are revalidated by each request and
+    // a 304 response delivers the cached body. Entries beyond a byte budget are evicted, least recently used first
+    class HttpCache {
+    public:
+        enum { DefaultMaxBytes = 16 << 20 };
+
+        struct Entry {
+            std::string etag, lastModified;
+            std::vector<char> body;
+            bool noStore;        // Cache-Control: no-store
+
+            Entry(): noStore(false) { }
+            inline bool cacheable() const { return !noStore && (!etag.empty() || !lastModified.empty()); }
+        };
+
+        HttpCache(int maxBytes = DefaultMaxBytes);
+
+        // existing files are indexed (oldest first evicted) and left-over temporary ones removed; empty: memory only
+        void setDirectory(const std::string& dir);
+
+        // response header line (new response on a status line)
+        static void parseHeader(Entry& response, const std::string& line);
+
+        // completed response: a 304 gets the cached entry (nullptr if none), a 200 is stored if cacheable
+        const Entry* onResponse(const std::string& url, long status, Entry&& response);
+
+        const Entry* find(const std::string& url);
+        void store(const std::string& url, Entry&& entry);
+        void remove(const std::string& url);
+
+        inline int getBytes() const { return bytes; }
+        inline int getMaxBytes() const { return maxBytes; }
+        inline int size() const { return int(nodes.size()); }
+
+    private:
+        struct Node {
+            std::string url;     // empty if indexed from the directory and not loaded yet
+            Entry entry;
+            int bytes;           // as stored in its file
+            std::list<uint32_t>::iterator lru;
+        };
+        std::unordered_map<uint32_t, Node> nodes;   // by url hash (also the file name)
+        std::list<uint32_t> lru;                     // most recent first
+        std::string dir;
+        int bytes, maxBytes;
+
+        std::string file(uint32_t h) const;
+        bool load(uint32_t h, Node& node);
+        void touch(Node& node);
+        void erase(uint32_t h);
+        void evict();
+    };
+
+}
@@ -0,0 +1,593 @@
+/*  -*- mode: c++; coding: utf-8; c-file-style: "stroustrup"; -*-
+
+    Contributors: Asier Aguirre
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include "image.h"
+#include "action.h"
+#include "widget.h"
+#include "context.h"
+#include "ml_parser.h"
+#include "application.h"
+#include "widget_timer.h"
+#include "widget_layout.h"
+#include "widget_template.h"
+#include "widget_application.h"
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+
+using namespace std;
+using namespace webui;
+
+namespace {
+
+    class Writer {
+    public:
+        Writer(vector<char>& data): data(data) { }
+        template <typename T> inline void put(const T& value) { putBytes(&value, sizeof(T)); }
+        inline void putBytes(const void* bytes, int n) {
+            auto* c(reinterpret_cast<const char*>(bytes));
+            data.insert(data.end(), c, c + n);
+        }
+        inline void putText(const char* text, int n) { put(int32_t(text ? n : -1)); if (text) putBytes(text, n); }
+        inline void putWord(uint32_t w) { const char bytes[] = { char(w), char(w >> 8), char(w >> 16), char(w >> 24) }; putBytes(bytes, 4); }
+
+    private:
+        vector<char>& data;
+    };
+
+    // bounds checked
+    class Reader {
+    public:
+        Reader(const char* data, int n): ok(true), pos(data), end(data + n) { }
+        template <typename T> inline T get() {
+            T value;
+            auto* bytes(take(sizeof(T)));
+            if (bytes) memcpy(&value, bytes, sizeof(T)); else memset(&value, 0, sizeof(T));
+            return value;
+        }
+        inline const char* take(int n) {
+            if (n < 0 || end - pos < n) { ok = false; return nullptr; }
+            pos += n;
+            return pos - n;
+        }
+        inline uint32_t getWord() {
+            auto* b(reinterpret_cast<const uint8_t*>(take(4)));
+            return b ? uint32_t(b[0]) | uint32_t(b[1]) << 8 | uint32_t(b[2]) << 16 | uint32_t(b[3]) << 24 : 0;
+        }
+        // malloc'ed copy (null terminated) or nullptr
+        inline char* getText(int* n = nullptr) {
+            int size(get<int32_t>());
+            if (n) *n = size;
+            if (size < 0) return nullptr;
+            auto* bytes(take(size));
+            return bytes ? strndup(bytes, size) : nullptr;
+        }
+
+        bool ok;
+
+    private:
+        const char* pos;
+        const char* end;
+    };
+
+    TypeWidget* builtinType(Identifier id) {
+        switch (id) {
+        case Identifier::Application: return &WidgetApplication::getType();
+        case Identifier::Widget:      return &Widget::getType();
+        case Identifier::LayoutHor:   return &WidgetLayout::getTypeHor();
+        case Identifier::LayoutVer:   return &WidgetLayout::getTypeVer();
+        case Identifier::Template:    return &WidgetTemplate::getType();
+        case Identifier::Timer:       return &WidgetTimer::getType();
+        default:                      return nullptr;
+        }
+    }
+
+    // StringId locations of a widget type (redundant properties share them)
+    vector<uint16_t> stringIdOffsets(const TypeWidget* type) {
+        auto offsets(type->getStringIds());
+        sort(offsets.begin(), offsets.end());
+        offsets.erase(unique(offsets.begin(), offsets.end()), offsets.end());
+        return offsets;
+    }
+
+    // property locations of a type loaded from an image inside its size
+    bool fits(const TypeWidget* type) {
+        for (const auto& copy: type->getCopies())
+            if (copy.offset + copy.size > type->size) return false;
+        for (auto offset: type->getStringIds())
+            if (offset + int(sizeof(StringId)) > type->size) return false;
+        return true;
+    }
+
+    // programs are stored as little endian 32-bit words, whatever the layout of Command: the instruction
+    // (instruction | type << 8 | param << 16) followed by its operands (float and color constants by their bits)
+    inline uint32_t operandWord(const Command& com, const Command& operand) {
+        if (com.inst() == Instruction::PushConstant && com.type() == Type::Float) {
+            uint32_t word;
+            memcpy(&word, &operand.f, sizeof(word));
+            return word;
+        }
+        if (com.inst() == Instruction::PushConstant && com.type() == Type::Color) return operand.color.rgba();
+        return uint32_t(operand.l);
+    }
+
+    inline Command operandCommand(const Command& com, uint32_t word) {
+        if (com.inst() == Instruction::PushConstant && com.type() == Type::Float) {
+            float f;
+            memcpy(&f, &word, sizeof(f));
+            return Command(f);
+        }
+        if (com.inst() == Instruction::PushConstant && com.type() == Type::Color) return Command(RGBA(word));
+        return Command(long(int32_t(word)));
+    }
+
+    inline char* at(Widget* widget, int offset) { return reinterpret_cast<char*>(widget) + offset; }
+    inline const char* at(const Widget* widget, int offset) { return reinterpret_cast<const char*>(widget) + offset; }
+
+}
+
+namespace webui {
+
+    uint32_t Image::fingerprint() {
+        // reserved words and memory layouts must match
+        int size;
+        const char* words(getReservedWords(size));
+        const int32_t layout[] = {
+            int32_t(hashString(words, size)),
+            int32_t(sizeof(MLParser::Entry)), int32_t(sizeof(Widget)),
+            int32_t(sizeof(WidgetApplication)), int32_t(sizeof(WidgetLayout)), int32_t(sizeof(WidgetTemplate)),
+            int32_t(sizeof(WidgetTimer)), int32_t(Function::RoundedRectStroke), int32_t(Instruction::FunctionCall),
+            int32_t(Type::LastType),
+        };
+        return hashString(reinterpret_cast<const char*>(layout), sizeof(layout));
+    }
+
+    bool Image::isImage(const char* data, int nData) {
+        uint32_t magic;
+        if (nData < int(sizeof(Header))) return false;
+        memcpy(&magic, data, sizeof(magic));
+        return magic == Magic;
+    }
+
+    bool Image::save(vector<char>& image) {
+        auto& app(Context::app);
+        auto& actions(Context::actions);
+        if (!app.root) return false;
+
+        // widgets: root tree first, then definitions
+        vector<Widget*> live;
+        unordered_map<const Widget*, int> widgetIdx;
+        vector<Widget*> pending{ app.root };
+        vector<pair<int, Widget*>> definitions;
+        for (const auto& idWidget: app.widgets)
+            definitions.push_back(make_pair(int(idWidget.first.getId()), idWidget.second));
+        sort(definitions.begin(), definitions.end());
+        for (size_t d = 0; ; d++) {
+            // preorder of each tree
+            while (!pending.empty()) {
+                auto* widget(pending.back());
+                pending.pop_back();
+                if (widgetIdx.count(widget)) continue;
+                widgetIdx[widget] = int(live.size());
+                live.push_back(widget);
+                auto& children(widget->getChildren());
+                for (auto it = children.rbegin(); it != children.rend(); ++it)
+                    pending.push_back(*it);
+            }
+            if (d >= definitions.size()) break;
+            pending.push_back(definitions[d].second);
+        }
+
+        // strings
+        vector<char> strings;
+        Writer stringsOut(strings);
+        unordered_map<int, int> stringIdx;
+        auto str = [&](StringId id) {
+            if (!id.valid()) return -1;
+            auto it(stringIdx.find(int(id.getId())));
+            if (it != stringIdx.end()) return it->second;
+            int idx(int(stringIdx.size()));
+            stringIdx[int(id.getId())] = idx;
+            const char* s(Context::strMng.get(id));
+            stringsOut.putText(s, strlen(s));
+            return idx;
+        };
+
+        // fonts (same indices)
+        vector<char> fonts;
+        Writer fontsOut(fonts);
+        for (const auto& font: app.fonts)
+            fontsOut.put(int32_t(str(font.first)));
+
+        // user types, bases first
+        vector<char> types;
+        Writer typesOut(types);
+        unordered_map<const TypeWidget*, int> typeIdx;
+        function<int(const TypeWidget*)> typeRef = [&](const TypeWidget* type) {
+            if (builtinType(type->type) == type) return -1 - int(type->type);
+            auto it(typeIdx.find(type));
+            if (it != typeIdx.end()) return it->second;
+            int base(type->getBase() ? typeRef(type->getBase()) : -1 - int(Identifier::Widget));
+            typesOut.put(int32_t(str(StringId(type->type))));
+            typesOut.put(int32_t(base));
+            typesOut.put(int32_t(type->size));
+            typesOut.put(int32_t(type->getProperties().size()));
+            for (const auto& entry: type->getProperties()) {
+                typesOut.put(int32_t(str(StringId(entry.id))));
+                typesOut.put(entry.prop.all);
+            }
+            int idx(int(typeIdx.size()));
+            typeIdx[type] = idx;
+            return idx;
+        };
+
+        // action tables in use
+        vector<int> tables;
+        unordered_map<int, int> tableIdx;
+        for (auto* widget: live)
+            if (widget->actions && !tableIdx.count(widget->actions)) {
+                tableIdx[widget->actions] = int(tables.size()) + 1;
+                tables.push_back(widget->actions);
+            }
+
+        // widgets
+        vector<char> widgets;
+        Writer widgetsOut(widgets);
+        vector<char> blob;
+        for (auto* widget: live) {
+            const auto* type(widget->typeWidget);
+            auto it(app.widgets.find(widget->getId()));
+            widgetsOut.put(int32_t(widget->baseType()));
+            widgetsOut.put(int32_t(typeRef(type)));
+            widgetsOut.put(int32_t(type->size));
+            widgetsOut.put(int32_t(widget->parent && widgetIdx.count(widget->parent) ? widgetIdx[widget->parent] : -1));
+            widgetsOut.put(int32_t(it != app.widgets.end() && it->second == widget));
+            widgetsOut.put(int32_t(widget->actions ? tableIdx[widget->actions] : 0));
+            widgetsOut.put(int32_t(widget->getChildren().size()));
+            for (auto* child: widget->getChildren())
+                widgetsOut.put(int32_t(widgetIdx[child]));
+            // property bytes (only the ones copied back) with string ids as indices
+            blob.assign(type->size, 0);
+            for (const auto& copy: type->getCopies())
+                if (copy.type == Type::Unknown || copy.type == Type::Bit)
+                    memcpy(&blob[copy.offset], at(widget, copy.offset), copy.size);
+            for (auto offset: stringIdOffsets(type)) {
+                int32_t idx(str(*reinterpret_cast<const StringId*>(at(widget, offset))));
+                memcpy(&blob[offset], &idx, sizeof(idx));
+            }
+            widgetsOut.putBytes(blob.data(), blob.size());
+            // texts and parsers
+            for (const auto& copy: type->getCopies())
+                if (copy.type == Type::Text) {
+                    const char* text(*reinterpret_cast<char* const*>(at(widget, copy.offset)));
+                    widgetsOut.putText(text, text ? strlen(text) : 0);
+                } else if (copy.type == Type::Parser) {
+                    // viewed entries and their text
+                    const auto& parser(*reinterpret_cast<const MLParser*>(at(widget, copy.offset)));
+                    int first(parser.firstEntry()), last(parser.size());
+                    const char* start(first < last ? parser[first].pos : "");
+                    const char* end(first == last ? start : last < int(parser.all().size()) ? parser[last].pos : parser.mlEnd);
+                    widgetsOut.putText(start, end - start);
+                    widgetsOut.put(int32_t(last - first));
+                    for (int e = first; e < last; e++) {
+                        const auto& entry(parser[e]);
+                        widgetsOut.put(int32_t(entry.type()));
+                        widgetsOut.put(int32_t(entry.next ? entry.next - first : 0));
+                        widgetsOut.put(int32_t(entry.pos - start));
+                        widgetsOut.put(int32_t(parser.size(e)));
+                        widgetsOut.put(int32_t(0 DIAG(+ entry.line)));
+                    }
+                }
+        }
+
+        // programs: position independent, operands relocated
+        vector<Command> commands;
+        vector<char> texts;
+        Writer textsOut(texts);
+        unordered_map<int, int> programIdx;
+        vector<char> tablesData;
+        Writer tablesOut(tablesData);
+        for (auto iTable: tables)
+            for (auto iAction: app.actionTables[iTable].actions) {
+                if (iAction && !programIdx.count(iAction)) {
+                    int start(commands.size()), n(actions.programSize(iAction));
+                    programIdx[iAction] = start;
+                    commands.insert(commands.end(), &actions.actions[iAction], &actions.actions[iAction] + n);
+                    for (int i = start; i < start + n; i += Actions::instructionSize(commands[i])) {
+                        auto* com(&commands[i]);
+                        switch (com->inst()) {
+                        case Instruction::PushConstant:
+                            if (com->type() == Type::Id || com->type() == Type::StrId) {
+                                for (int k = 1; k <= 1 + com->param; k++)
+                                    com[k] = Command(long(str(com[k].strId)));
+                            } else if (com->type() == Type::Text) {
+                                textsOut.putText(com[1].text, com[1].text ? strlen(com[1].text) : 0);
+                                com[1] = Command(0L);
+                            } else if (com->type() == Type::StrView) {
+                                textsOut.putText(com[1].text, com[2].l);
+                                com[1] = Command(0L);
+                            }
+                            break;
+                        case Instruction::PushForeignProperty:
+                        case Instruction::PushForeignPropertyPtr:
+                            com[1] = Command(long(str(com[1].strId)));
+                            com[2] = Command(0L);
+                            com[3] = Command(0L);
+                            break;
+                        case Instruction::PushDoubleProperty:
+                        case Instruction::PushDoublePropertyPtr:
+                            com[2] = Command(0L);
+                            com[3] = Command(0L);
+                            break;
+                        case Instruction::PushDoubleParentProperty:
+                        case Instruction::PushDoubleParentPropertyPtr:
+                            com[3] = Command(0L);
+                            com[4] = Command(0L);
+                            break;
+                        default:
+                            break;
+                        }
+                    }
+                }
+                tablesOut.put(int32_t(iAction ? programIdx[iAction] + 1 : 0));
+            }
+
+        Header header;
+        header.magic = Magic;
+        header.fingerprint = fingerprint();
+        header.nStrings = int32_t(stringIdx.size());
+        header.nFonts = int32_t(app.fonts.size());
+        header.nTypes = int32_t(typeIdx.size());
+        header.nWidgets = int32_t(live.size());
+        header.nTables = int32_t(tables.size());
+        header.nCommands = int32_t(commands.size());
+        header.internalId = app.internalId;
+        image.clear();
+        Writer out(image);
+        out.put(header);
+        for (const auto* section: { &strings, &fonts, &types, &widgets, &tablesData })
+            out.putBytes(section->data(), section->size());
+        for (int i = 0, n; i < int(commands.size()); i += n) {
+            const auto& com(commands[i]);
+            n = Actions::instructionSize(com);
+            out.putWord(uint32_t(com.instruction) | uint32_t(com.sub) << 8 | uint32_t(com.param) << 16);
+            for (int k = 1; k < n; k++)
+                out.putWord(operandWord(com, commands[i + k]));
+        }
+        out.putBytes(texts.data(), texts.size());
+        return true;
+    }
+
+    bool Image::load(const char* data, int nData) {
+        auto& app(Context::app);
+        auto& actions(Context::actions);
+        Reader in(data, nData);
+        auto header(in.get<Header>());
+        if (header.magic != Magic || header.fingerprint != fingerprint()) {
+            DIAG(LOG("image: not produced by this build"));
+            return false;
+        }
+        // counts are checked against the image size before allocating (each element takes at least these bytes)
+        const int32_t counts[][2] = {
+            { header.nStrings, 4 }, { header.nFonts, 4 }, { header.nTypes, 16 }, { header.nWidgets, 28 },
+            { header.nTables, int(sizeof(Application::ActionTable::actions)) }, { header.nCommands, 4 },
+        };
+        int64_t needed(0);
+        for (const auto& count: counts) {
+            if (count[0] < 0) return false;
+            needed += int64_t(count[0]) * count[1];
+        }
+        if (needed > nData - int64_t(sizeof(Header))) {
+            DIAG(LOG("image: truncated or corrupted"));
+            return false;
+        }
+
+        // on error, nothing of the image is left behind
+        vector<Widget*> widgets;
+        vector<TypeWidget*> types;
+        int tableBase(app.actionTables.size()), programBase(actions.actions.size()), textBase(actions.texts.size());
+        auto rollback = [&]() {
+            for (auto* widget: widgets) {
+                if (!widget) continue;
+                auto it(app.widgets.find(widget->getId()));
+                if (it != app.widgets.end() && it->second == widget) app.widgets.erase(it);
+                app.freeWidget(widget);
+            }
+            for (auto* type: types)
+                delete type;
+            app.actionTables.resize(tableBase);
+            actions.actions.resize(programBase);
+            for (size_t i = textBase; i < actions.texts.size(); i++)
+                free(actions.texts[i]);
+            actions.texts.resize(textBase);
+            app.clear();
+            return false;
+        };
+
+        // strings
+        vector<StringId> strings(header.nStrings);
+        for (auto& id: strings) {
+            int n;
+            char* text(in.getText(&n));
+            if (!text) return rollback();
+            id = Context::strMng.add(text, n);
+            free(text);
+        }
+        auto str = [&](int32_t idx) { return idx >= 0 && idx < int(strings.size()) ? strings[idx] : StringId(); };
+
+        // fonts
+        vector<int> fonts(header.nFonts);
+        for (auto& font: fonts)
+            font = app.getFont(str(in.get<int32_t>()));
+
+        // user types
+        auto typeRef = [&](int32_t ref) -> TypeWidget* {
+            if (ref < 0) return builtinType(Identifier(-1 - ref));
+            return ref < int(types.size()) ? types[ref] : nullptr;
+        };
+        for (int t = 0; t < header.nTypes && in.ok; t++) {
+            auto typeId(str(in.get<int32_t>()));
+            auto* base(typeRef(in.get<int32_t>()));
+            int size(in.get<int32_t>());
+            if (!base) return rollback();
+            auto* type(new TypeWidget(typeId.getId(), size, { }));
+            type->inherit(*base);
+            for (int p = in.get<int32_t>(); p > 0 && in.ok; p--) {
+                auto id(str(in.get<int32_t>()));
+                type->add(id.getId(), Property(in.get<uint32_t>()));
+            }
+            types.push_back(type);
+            if (!fits(type)) return rollback();
+        }
+
+        // widgets
+        struct Links {
+            int parent;
+            vector<int> children;
+        };
+        widgets.assign(header.nWidgets, nullptr);
+        vector<Links> links(header.nWidgets);
+        for (int w = 0; w < header.nWidgets && in.ok; w++) {
+            auto baseType(Identifier(in.get<int32_t>()));
+            auto* type(typeRef(in.get<int32_t>()));
+            int size(in.get<int32_t>());
+            links[w].parent = in.get<int32_t>();
+            bool registered(in.get<int32_t>());
+            int table(in.get<int32_t>());
+            links[w].children.resize(max(0, in.get<int32_t>()));
+            for (auto& child: links[w].children)
+                child = in.get<int32_t>();
+            const char* blob(in.take(size));
+            Widget* widget;
+            if (!type || type->size != size || !blob || !(widget = app.createWidget(baseType, nullptr, size))) return rollback();
+            widgets[w] = widget;
+            widget->typeWidget = type;
+            for (auto offset: type->getTexts())
+                *reinterpret_cast<char**>(at(widget, offset)) = nullptr;
+            for (const auto& copy: type->getCopies())
+                switch (copy.type) {
+                case Type::Unknown:
+                    memcpy(at(widget, copy.offset), blob + copy.offset, copy.size);
+                    break;
+                case Type::Bit:
+                    *at(widget, copy.offset) = (*at(widget, copy.offset) & ~copy.mask) | (blob[copy.offset] & copy.mask);
+                    break;
+                case Type::Text:
+                    *reinterpret_cast<char**>(at(widget, copy.offset)) = in.getText();
+                    break;
+                case Type::Parser: {
+                    MLParser parser;
+                    int n;
+                    parser.mlOrig = in.getText(&n);
+                    parser.mlEnd = parser.mlOrig + max(n, 0);
+                    parser.ownOrig = parser.mlOrig != nullptr;
+                    int nEntries(max(0, in.get<int32_t>()));
+                    parser.entries.reserve(nEntries);
+                    parser.lengths.reserve(nEntries);
+                    for (int e = 0; e < nEntries && in.ok; e++) {
+                        auto type(MLParser::EntryType(in.get<int32_t>()));
+                        int next(in.get<int32_t>());
+                        int pos(in.get<int32_t>());
+                        int length(in.get<int32_t>());
+                        int line(in.get<int32_t>());
+                        (void)line;
+                        if (pos < 0 || length < 0 || pos + length > n) return rollback();
+                        parser.entries.push_back(MLParser::Entry(type, parser.mlOrig + pos DIAG(, line)));
+                        parser.entries.back().next = next;
+                        parser.lengths.push_back(length);
+                    }
+                    // shared by the copies of the widget
+                    parser.copyTo(*reinterpret_cast<MLParser*>(at(widget, copy.offset)), 0, parser.size());
+                    break;
+                }
+                default:
+                    break;
+                }
+            for (auto offset: stringIdOffsets(type)) {
+                int32_t idx;
+                memcpy(&idx, blob + offset, sizeof(idx));
+                *reinterpret_cast<StringId*>(at(widget, offset)) = str(idx);
+            }
+            widget->actions = table ? int(app.actionTables.size()) + table - 1 : 0;
+            if (registered && !app.registerWidget(widget)) return rollback();
+        }
+        if (!in.ok) return rollback();
+
+        // hierarchy
+        for (int w = 0; w < header.nWidgets; w++) {
+            auto* widget(widgets[w]);
+            if (links[w].parent >= header.nWidgets) return rollback();
+            widget->parent = links[w].parent >= 0 ? widgets[links[w].parent] : nullptr;
+            for (auto child: links[w].children) {
+                if (child < 0 || child >= header.nWidgets) return rollback();
+                widget->addChild(widgets[child]);
+            }
+            widget->setLayoutDirty();
+            if (widget->baseType() == Identifier::Timer)
+                app.addTimer(reinterpret_cast<WidgetTimer*>(widget));
+        }
+
+        // action tables and programs
+        for (int t = 0; t < header.nTables; t++) {
+            Application::ActionTable table;
+            for (auto& iAction: table.actions) {
+                int ref(in.get<int32_t>());
+                if (ref > header.nCommands) return rollback();
+                iAction = ref > 0 ? programBase + ref - 1 : 0;
+            }
+            app.actionTables.push_back(table);
+        }
+        actions.actions.reserve(programBase + header.nCommands);
+        for (int i = 0, n; i < header.nCommands && in.ok; i += n) {
+            uint32_t word(in.getWord());
+            Command com(Instruction(word & 0xff), Type(word >> 8 & 0xff), int(word >> 16));
+            n = Actions::instructionSize(com);
+            if (com.inst() > Instruction::FunctionCall || com.type() > Type::LastType || n > header.nCommands - i ||
+                (com.inst() == Instruction::FunctionCall && com.param > int(Function::RoundedRectStroke)))
+                return rollback();
+            actions.actions.push_back(com);
+            for (int k = 1; k < n; k++)
+                actions.actions.push_back(operandCommand(com, in.getWord()));
+        }
+        if (!in.ok) return rollback();
+        for (int i = programBase, n; i < int(actions.actions.size()); i += n) {
+            auto* com(&actions.actions[i]);
+            n = Actions::instructionSize(*com);
+            if (n < 1 || n > int(actions.actions.size()) - i) return rollback();
+            switch (com->inst()) {
+            case Instruction::PushConstant:
+                if (com->type() == Type::Id || com->type() == Type::StrId) {
+                    for (int k = 1; k <= 1 + com->param; k++)
+                        com[k] = Command(str(com[k].l));
+                } else if (com->type() == Type::FontIdx) {
+                    if (com[1].l >= 0 && com[1].l < long(fonts.size())) com[1] = Command(long(fonts[com[1].l]));
+                } else if (com->type() == Type::Text || com->type() == Type::StrView) {
+                    char* text(in.getText());
+                    com[1] = Command((const char*)text);
+                    if (text) actions.texts.push_back(text);
+                }
+                break;
+            case Instruction::PushForeignProperty:
+            case Instruction::PushForeignPropertyPtr:
+                com[1] = Command(str(com[1].l));
+                if (!com[1].strId.valid()) return rollback();
+                break;
+            default:
+                break;
+            }
+        }
+        if (!in.ok || widgets.empty()) return rollback();
+
+        app.root = widgets[0];
+        app.internalId = max(app.internalId, int(header.internalId));
+        return true;
+    }
+
+}
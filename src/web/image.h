@@ -0,0 +1,40 @@
+/*  -*- mode: c++; coding: utf-8; c-file-style: "stroustrup"; -*-
+
+    Contributors: Asier Aguirre
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+namespace webui {
+
+    // precompiled application: the result of constructing an application (strings, widget types, widget tree,
+    // action tables and optimized programs) serialized by the offline compiler and loaded without parsing,
+    // constructing or checking actions; pointers and string ids are stored as indices in the image; programs
+    // are layout independent, but widget properties keep the memory layout of the build, so only images
+    // produced by a build with the same layout (fingerprint) are accepted
+    class Image {
+    public:
+        static bool save(std::vector<char>& image); // current application
+        static bool load(const char* data, int nData);
+        static bool isImage(const char* data, int nData);
+
+    private:
+        enum { Magic = 0x3342574e }; // "NWB3"
+
+        struct Header {
+            uint32_t magic;
+            uint32_t fingerprint;
+            int32_t nStrings, nFonts, nTypes, nWidgets, nTables, nCommands;
+            int32_t internalId;
+        };
+
+        static uint32_t fingerprint();
+    };
+
+}
@@ -26,6 +26,7 @@ namespace webui {
         auto* win(Context::render.getWin());
         glfwPollEvents();
         glfwSetMouseButtonCallback(win, [](GLFWwindow* win, int button, int action_, int mods) {
+                ctx.inputReceived();
                 mouseButtonAction = true;
                 keyButton = button;
                 action = action_;
@@ -42,6 +43,7 @@ namespace webui {
                 keyButton = 0;
             });
         glfwSetKeyCallback(win, [](GLFWwindow* window, int key, int scancode, int action_, int mods) {
+                ctx.inputReceived();
                 if (action == GLFW_PRESS) {
                     // exit
                     if (key == GLFW_KEY_ESCAPE && mods == GLFW_MOD_CONTROL)
@@ -61,6 +63,7 @@ namespace webui {
                 if (hoverWidget) { hoverWidget = nullptr; updateModifications = true; }
             });
         glfwSetScrollCallback(win, [](GLFWwindow* window, double xoff, double yoff) {
+                ctx.inputReceived();
                 scroll.x = xoff;
                 scroll.y = yoff;
                 scrollAction = updateCalled = true;
@@ -68,6 +71,9 @@ namespace webui {
                 scrollAction = false;
                 scroll.x = scroll.y = 0.0f;
             });
+        glfwSetCursorPosCallback(win, [](GLFWwindow* window, double x, double y) {
+                ctx.inputReceived(); // the position is read in refresh()
+            });
     }
 
     bool Input::refresh() {
@@ -112,7 +118,10 @@ namespace webui {
     bool Input::refreshStack(Widget* w) {
         bool modif(false);
         while (w) {
-            modif |= w->input();
+            if (w->input()) {
+                modif = true;
+                w->setLayoutDirty();
+            }
             w = w->getParent();
         }
         return modif;
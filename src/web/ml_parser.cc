@@ -8,9 +8,12 @@
 
 #include "ml_parser.h"
 #include "context.h"
+#include "scan.h"
 #include <cctype>
 #include <cassert>
 #include <cstdlib>
+#include <cstring>
+#include <algorithm>
 
 #ifdef DISABLE_DIAGNOSTICS
 #  define ERROR_FALSE(ml, msg) false
@@ -23,6 +26,19 @@
 using namespace std;
 using namespace webui;
 
+namespace {
+
+    // chars delimiting structure for incremental parsing: ( ) , / " ' and [ ] { } (plus \\ and |)
+    struct Structural {
+        template <typename T> inline auto operator()(T v) const {
+            using namespace scan;
+            return any(any(any(inRange(v, '(', ')'), inRange(asLower(v), '{', '}')), any(eq(v, ','), eq(v, '/'))),
+                       any(eq(v, '"'), eq(v, '\'')));
+        }
+    };
+
+}
+
 namespace webui {
 
     DIAG(const char* MLParser::toString(MLParser::EntryType type) {
@@ -50,6 +66,14 @@ namespace webui {
     void MLParser::finish() {
         if (ownOrig)
             free(const_cast<char*>(mlOrig));
+        ownOrig = false;
+        if (shared && !--shared->refs) {
+            free(shared->text);
+            delete shared;
+        }
+        shared = nullptr;
+        first = last = 0;
+        stream = Stream{ };
     }
 
     bool MLParser::parse(const char* ml, int n) {
@@ -57,34 +81,258 @@ namespace webui {
         mlOrig = ml;
         mlEnd = ml + n;
         DIAG(line = 1);
-        entries.clear();
+        clear();
+        return parseDocument(ml);
+    }
+
+    bool MLParser::parseDocument(const char* ml) {
         if (parseExpression(ml, -1) >= 0) {
             char c = skipSpace(ml);
             if (c) return ERROR_FALSE(ml, "expecting EOF");
-            fixLevelEndings(0, entries.size());
+            closeLevel(0);
             // reserve memory for last entry
-            newEntry(EntryType::Unknown, nullptr, -1);
+            entries.emplace_back(EntryType::Unknown);
             entries.pop_back();
+            lengths.reserve(entries.capacity());
             return true;
         }
         return false;
     }
 
-    void MLParser::fixLevelEndings(int iEntry, int jEntry) {
-        while (iEntry < jEntry) {
-            auto& entry(entries[iEntry]);
-            if (!entry.next) entry.next = jEntry;
-            if (entry.next != iEntry + 1)
-                fixLevelEndings(iEntry + 1, entry.next);
-            iEntry = entry.next;
+    void MLParser::begin() {
+        finish();
+        ownOrig = true;
+        mlOrig = mlEnd = nullptr;
+        DIAG(line = 1);
+        clear();
+    }
+
+    bool MLParser::feed(const char* data, int n) {
+        // append to own copy (entries are rebased if it moves), nul terminated as parsing peeks at mlEnd
+        int size(mlEnd - mlOrig);
+        if (size + n + 1 > stream.capacity) {
+            // new block (not realloc): entries are rebased while the old one is still valid
+            int capacity(max(max(size + n + 1, stream.capacity * 2), 4096));
+            auto* grown(reinterpret_cast<char*>(malloc(capacity)));
+            if (!grown) {
+                DIAG(LOG("cannot allocate %d bytes for streamed ML", capacity));
+                return false;
+            }
+            if (size) memcpy(grown, mlOrig, size);
+            for (auto& entry: entries) entry.pos = grown + (entry.pos - mlOrig);
+            free(const_cast<char*>(mlOrig));
+            mlOrig = grown;
+            stream.capacity = capacity;
+        }
+        memcpy(const_cast<char*>(mlOrig) + size, data, n);
+        mlEnd = mlOrig + size + n;
+        *const_cast<char*>(mlEnd) = 0;
+        return scanStream();
+    }
+
+    bool MLParser::end() {
+        const char* ml(mlOrig);
+        if (stream.whole || (!stream.depth && !stream.closed)) {
+            // not a root list or object
+            clear();
+            DIAG(line = 1);
+            return parseDocument(ml);
+        }
+        if (!stream.closed) return ERROR_FALSE(mlEnd, "unexpected EOF");
+        ml += stream.parsed;
+        if (skipSpace(ml)) return ERROR_FALSE(ml, "expecting EOF");
+        closeLevel(0);
+        entries.emplace_back(EntryType::Unknown);
+        entries.pop_back();
+        lengths.reserve(entries.capacity());
+        return true;
+    }
+
+    bool MLParser::scanStream() {
+        // find item boundaries of the streamed levels: ',' in a list or a closing ']' / '}' in an object
+        auto& s(stream);
+        const char* ml(mlOrig + s.scanned);
+        while (ml < mlEnd && !s.closed) {
+            if (s.quote) {
+                ml = scan::findStringEnd(ml, mlEnd, s.quote);
+                if (ml == mlEnd) break;
+                if (*ml == 0x1b) { // escape sequence \x1b + RGBA
+                    if (mlEnd - ml < 5) break;
+                    ml += 4;
+                } else if (*ml == s.quote)
+                    s.quote = 0;
+                ++ml;
+                continue;
+            }
+            ml = scan::find(ml, mlEnd, Structural());
+            if (ml == mlEnd) break;
+            char c(*ml);
+            if (c == '/') {
+                if (ml + 1 == mlEnd) break; // wait for next char
+                if (ml[1] == '/') { // comment
+                    auto* eol(reinterpret_cast<const char*>(memchr(ml, '\n', mlEnd - ml)));
+                    if (!eol) break;
+                    ml = eol;
+                }
+            } else if (c == '"' || c == '\'') s.quote = c;
+            else if (c == '[' || c == '{' || c == '(') {
+                if (!s.depth++) {
+                    if (!s.whole && !beginRoot(ml)) return false;
+                } else if (c == '[' && s.depth == s.nLevels + 1 && s.nLevels < s.maxLevels && !beginLevel(ml))
+                    return false;
+            } else if (c == ']' || c == '}' || c == ')') {
+                if (!s.depth) return ERROR_FALSE(ml, "unbalanced closing");
+                if (s.depth-- == s.nLevels) {
+                    if (!endLevel(ml)) return false;
+                } else if (s.nLevels && s.depth == s.nLevels && !s.levels[s.nLevels - 1].list && c != ')' && !parseItems(ml + 1))
+                    return false;
+            } else if (c == ',' && s.nLevels && s.depth == s.nLevels && s.levels[s.nLevels - 1].list && !parseItems(ml))
+                return false;
+            ++ml;
+        }
+        s.scanned = ml - mlOrig;
+        return true;
+    }
+
+    bool MLParser::beginRoot(const char* open) {
+        auto& s(stream);
+        const char* ml(mlOrig);
+        char c(skipSpace(ml));
+        bool list(false);
+        if (*open == '[' && ml == open)
+            list = true;
+        else if (*open == '{' && isalpha(c)) {
+            int iRoot(parseId(ml, -1));
+            if (skipSpace(ml) != '{' || ml != open) return ERROR_FALSE(ml, "expecting root object");
+            entries[iRoot].setType(EntryType::Object);
+        } else {
+            s.whole = true;
+            return true;
+        }
+        if (list) newEntry(EntryType::List, ml, 1, -1);
+        s.parsed = open + 1 - mlOrig;
+        s.levels[0] = Level{ 0, 0, -1, list, false };
+        s.nLevels = 1;
+        s.maxLevels = list ? 2 : 3;
+        return true;
+    }
+
+    bool MLParser::beginLevel(const char* open) {
+        // a list that is an item of the innermost streamed level (or the value of a key: in an object) is
+        // streamed too, anything else (like a block) is parsed with its item
+        auto& s(stream);
+        auto& parent(s.levels[s.nLevels - 1]);
+        const char* ml(mlOrig + s.parsed);
+        int item, value;
+        if (parent.list) {
+            if (!parseItems(open)) return false;
+            ml = mlOrig + s.parsed;
+            DIAG(int startLine(line));
+            skipSpace(ml);
+            if (parent.comma || ml != open) {
+                DIAG(line = startLine);
+                return true;
+            }
+            item = value = newEntry(EntryType::List, open, 1, parent.prevItem);
+        } else {
+            // complete items before key: [ are parsed first
+            while (true) {
+                const char* start(ml);
+                DIAG(int startLine(line));
+                char c(skipSpace(ml));
+                if (!isalpha(c) || ml >= open) {
+                    DIAG(line = startLine);
+                    return true;
+                }
+                DIAG(int keyLine(line));
+                const char* list(ml);
+                skipId(list);
+                if (skipSpace(list) == ':') {
+                    ++list;
+                    if (skipSpace(list) == '[' && list == open) {
+                        DIAG(int openLine(line); line = keyLine);
+                        item = parseId(ml, parent.prevItem);
+                        DIAG(line = openLine);
+                        break;
+                    }
+                }
+                ml = start;
+                DIAG(line = startLine);
+                int iItem(entries.size());
+                if ((parent.prevItem = parseObjectItem(ml, parent.prevItem)) < 0) return false;
+                closeLevel(iItem);
+                s.parsed = ml - mlOrig;
+            }
+            value = newEntry(EntryType::List, open, 1, item);
+        }
+        s.levels[s.nLevels++] = Level{ item, value, -1, true, false };
+        s.parsed = open + 1 - mlOrig;
+        return true;
+    }
+
+    bool MLParser::endLevel(const char* close) {
+        auto& s(stream);
+        auto& level(s.levels[s.nLevels - 1]);
+        if (!parseItems(close)) return false;
+        const char* end(mlOrig + s.parsed);
+        char c(*close);
+        if (c != (level.list ? ']' : '}') || skipSpace(end) != c || end != close)
+            return ERROR_FALSE(end, "expecting end of list or object");
+        if (level.list && level.prevItem >= 0 && !level.comma) return ERROR_FALSE(end, "expecting expression");
+        s.parsed = close + 1 - mlOrig;
+        if (!--s.nLevels) {
+            s.closed = true;
+            return true;
         }
+        // the list is an item of its parent level
+        closeLevel(level.item);
+        auto& parent(s.levels[s.nLevels - 1]);
+        parent.prevItem = level.value;
+        parent.comma = parent.list;
+        return true;
+    }
+
+    bool MLParser::parseItems(const char* limit) {
+        auto& s(stream);
+        auto& level(s.levels[s.nLevels - 1]);
+        const char* ml(mlOrig + s.parsed);
+        while (true) {
+            int iItem(entries.size());
+            const char* start(ml);
+            DIAG(int startLine(line));
+            char c(skipSpace(ml));
+            if (ml >= limit) {
+                // trailing space can be an incomplete comment: skip it later
+                ml = start;
+                DIAG(line = startLine);
+                break;
+            }
+            if (level.list) {
+                if (level.comma) {
+                    if (c != ',') return ERROR_FALSE(ml, "expecting ',' or end of list");
+                    ++ml;
+                    level.comma = false;
+                    continue;
+                }
+                if ((level.prevItem = parseExpression(ml, level.prevItem)) < 0) return false;
+                level.comma = true;
+            } else if ((level.prevItem = parseObjectItem(ml, level.prevItem)) < 0)
+                return false;
+            // item entries are final
+            closeLevel(iItem);
+        }
+        s.parsed = ml - mlOrig;
+        return true;
     }
 
     int MLParser::parseExpression(const char*&ml, int prev) {
-        int iExpression(entries.size());
-        if ((prev = parseExpressionRecur(ml, prev)) < 0) return -1;
-        entries[iExpression].next = 0; // expression has one entry point, everything else is nested
-        return iExpression;
+        // expression has one entry point, everything else is nested (operators and attributes following
+        // the head are not linked to it)
+        int outer(head), iExpression(entries.size());
+        head = iExpression;
+        prev = parseExpressionRecur(ml, prev);
+        head = outer;
+        return prev < 0 ? -1 : iExpression;
     }
 
     int MLParser::parseExpressionRecur(const char*&ml, int prev, const char* op) {
@@ -121,7 +369,7 @@ namespace webui {
             }
         } else if (c == '[') { // list
             if (op) return ERROR_INT(ml, "list cannot be used in operation");
-            prev = newEntry(EntryType::List, ml++, prev);
+            prev = newEntry(EntryType::List, ml++, 1, prev);
             return parseList(ml, ']') ? prev : -1;
         } else if (c =='#') { // color (continue for formula)
             if ((prev = parseColor(ml, prev)) < 0) return -1;
@@ -138,14 +386,14 @@ namespace webui {
         } else if ((!op && c == '-') || c == '.' || isdigit(c)) { // number
             if ((prev = parseNumber(ml, prev)) < 0) return -1;
         } else if (c == '@') { // wildcar
-            prev = newEntry(EntryType::Wildcar, ml++, prev);
+            prev = newEntry(EntryType::Wildcar, ml++, 1, prev);
         }
         // operators, a way of continuing with expression
         skipSpace(ml);
         int opSize;
         if ((opSize = isOperator(ml))) {
             if (prev == -1 || entries.empty() || entries.back().type() == EntryType::Operator) return ERROR_INT(ml, "invalid operator position");
-            prev = newEntry(EntryType::Operator, ml, prev);
+            prev = newEntry(EntryType::Operator, ml, opSize, prev);
             ml += opSize;
             if (parseExpressionRecur(ml, -1, ml - opSize) < 0) return -1;
         }
@@ -168,26 +416,33 @@ namespace webui {
             if (c == endChar) { // end
                 ++ml;
                 return 0;
-            } else if (c == '[') { // block
-                prevInner = newEntry(EntryType::Block, ml++, prevInner);
-                if (parseObject(ml, -1, ']') < 0) return -1;
-            } else if (isalpha(c)) { // key: expression or object { }
-                if ((prevInner = parseId(ml, prevInner)) < 0) return -1;
-                c = skipSpace(ml);
-                if (c == '{') { // object { }
-                    entries[prevInner].setType(EntryType::Object);
-                    ++ml;
-                    if (parseObject(ml, -1, '}') < 0) return -1;
-                } else if (c == ':') { // key: expression
-                    ++ml;
-                    if ((prevInner = parseExpression(ml, prevInner)) < 0) return -1;
-                } else {
-                    return ERROR_INT(ml, "expecting object '{' or key value expression ':'");
-                }
+            }
+            if ((prevInner = parseObjectItem(ml, prevInner)) < 0) return -1;
+        }
+    }
+
+    int MLParser::parseObjectItem(const char*&ml, int prevInner) {
+        auto c(skipSpace(ml));
+        if (c == '[') { // block
+            prevInner = newEntry(EntryType::Block, ml++, 1, prevInner);
+            if (parseObject(ml, -1, ']') < 0) return -1;
+        } else if (isalpha(c)) { // key: expression or object { }
+            if ((prevInner = parseId(ml, prevInner)) < 0) return -1;
+            c = skipSpace(ml);
+            if (c == '{') { // object { }
+                entries[prevInner].setType(EntryType::Object);
+                ++ml;
+                if (parseObject(ml, -1, '}') < 0) return -1;
+            } else if (c == ':') { // key: expression
+                ++ml;
+                if ((prevInner = parseExpression(ml, prevInner)) < 0) return -1;
             } else {
-                return ERROR_INT(ml, "expecting object end '}|]' or block '[' or id");
+                return ERROR_INT(ml, "expecting object '{' or key value expression ':'");
             }
+        } else {
+            return ERROR_INT(ml, "expecting object end '}|]' or block '[' or id");
         }
+        return prevInner;
     }
 
     bool MLParser::parseList(const char*&ml, char endChar) {
@@ -205,8 +460,9 @@ namespace webui {
     }
 
     int MLParser::parseNumber(const char*&ml, int prev) {
-        prev = newEntry(EntryType::Number, ml, prev);
+        prev = newEntry(EntryType::Number, ml, 0, prev);
         if (!skipNumber(ml)) return -1;
+        lengths[prev] = ml - entries[prev].pos;
         return prev;
     }
 
@@ -214,11 +470,11 @@ namespace webui {
         if (get(ml) == '-') ++ml;
         bool dot(false);
         while (true) {
+            ml = scan::skipDigits(ml, mlEnd);
             auto c(get(ml));
             if (c == '.') {
                 if (dot) return ERROR_FALSE(ml, "several dots in number");
                 dot = true;
-            } else if (isdigit(c)) {
             } else if (isalpha(c)) return ERROR_FALSE(ml, "invalid character for number");
             else return true;
             ++ml;
@@ -226,8 +482,9 @@ namespace webui {
     }
 
     int MLParser::parseColor(const char*&ml, int prev) {
-        prev = newEntry(EntryType::Color, ml, prev);
+        prev = newEntry(EntryType::Color, ml, 0, prev);
         if (!skipColor(ml)) return -1;
+        lengths[prev] = ml - entries[prev].pos;
         return prev;
     }
 
@@ -248,8 +505,9 @@ namespace webui {
     }
 
     int MLParser::parseString(const char*&ml, int prev) {
-        prev = newEntry(EntryType::String, ml, prev);
+        prev = newEntry(EntryType::String, ml, 0, prev);
         if (!skipString(ml)) return -1;
+        lengths[prev] = ml - entries[prev].pos;
         return prev;
     }
 
@@ -258,6 +516,7 @@ namespace webui {
         char end(*ml);
         ++ml;
         while (true) {
+            ml = scan::findStringEnd(ml, mlEnd, end);
             char c = get(ml);
             if (c == end) { ++ml; return true; }
             if (c == 0x1b) ml += 4; // escape sequence \x1b + RGBA
@@ -269,61 +528,48 @@ namespace webui {
     int MLParser::parseId(const char*&ml, int prev) {
         auto c(get(ml));
         if (!isalpha(c) && c != '_') return ERROR_INT(ml, "expecting id");
-        prev = newEntry(EntryType::Id, ml++, prev);
+        const char* start(ml++);
         skipId(ml);
-        return prev;
+        return newEntry(EntryType::Id, start, ml - start, prev);
     }
 
     void MLParser::skipId(const char*&ml) const {
-        char c;
-        while (c = get(ml), isalnum(c) || c == '_') ++ml;
+        ml = scan::skipId(ml, mlEnd);
     }
 
     char MLParser::skipSpace(const char*&ml) const {
         while (true) {
+            DIAG(const char* start(ml));
+            ml = scan::skipSpace(ml, mlEnd);
+            DIAG(line += count(start, ml, '\n'));
             char c(get(ml));
-            if (c == '\n') { DIAG(line++); ++ml; }
-            else if (isspace(c)) ++ml;
-            else if (c == '/' && get(ml + 1) == '/') skipLine(ml); // comment
+            if (c == '/' && get(ml + 1) == '/') skipLine(ml); // comment
             else return c;
         }
     }
 
     void MLParser::skipLine(const char*& ml) const {
-        while (true) {
-            char c(get(ml));
-            if (c == '\n') { DIAG(line++); ++ml; break; }
-            if (!c) break;
-            ++ml;
-        }
+        auto* eol(reinterpret_cast<const char*>(memchr(ml, '\n', mlEnd - ml)));
+        if (eol) { DIAG(line++); ml = eol + 1; }
+        else ml = mlEnd;
     }
 
-    int MLParser::newEntry(EntryType type, const char* pos, int prev) {
-        if (prev >= 0) entries[prev].next = entries.size();
+    int MLParser::newEntry(EntryType type, const char* pos, int length, int prev) {
+        if (prev >= 0 && prev != head) {
+            entries[prev].next = entries.size();
+            closeLevel(prev);
+        }
+        pending.push_back(entries.size());
         entries.push_back(Entry(type, pos DIAG(, line)));
+        lengths.push_back(length);
         return entries.size() - 1;
     }
 
-    int MLParser::size(int iEntry) const {
-        assert(iEntry < int(entries.size()));
-        auto& entry(entries[iEntry]);
-        const char* end(entry.pos);
-        switch (entry.type()) {
-        case EntryType::Unknown:   return 0;
-        case EntryType::Id:
-        case EntryType::Object:
-        case EntryType::Attribute:
-        case EntryType::Function:  skipId(end); break;
-        case EntryType::Number:    skipNumber(end); break;
-        case EntryType::Color:     skipColor(end); break;
-        case EntryType::String:    skipString(end); break;
-        case EntryType::List:                    // '['
-        case EntryType::Block:                   // '{'
-        case EntryType::Wildcar:   ++end; break; // '@'
-        case EntryType::Operator:  end += isOperator(end); break;
-        default:                   abort();
-        }
-        return end - entry.pos;
+    void MLParser::closeLevel(int iEntry) {
+        // entries from iEntry still without next are the last ones of their levels, that end here
+        int end(entries.size());
+        for (; !pending.empty() && pending.back() >= iEntry; pending.pop_back())
+            if (!entries[pending.back()].next) entries[pending.back()].next = end;
     }
 
     int MLParser::isOperator(const char* c) {
@@ -335,34 +581,38 @@ namespace webui {
     }
 
     Identifier MLParser::asId(int iEntry) const {
-        return Identifier(Context::strMng.search(entries[iEntry].pos, size(iEntry)).getId());
+        return Identifier(Context::strMng.search(all()[iEntry].pos, size(iEntry)).getId());
     }
 
     Identifier MLParser::asIdAdd(int iEntry) const {
-        return Identifier(Context::strMng.add(entries[iEntry].pos, size(iEntry)).getId());
-    }
-
-    int MLParser::getTemporalEntry(const char* text) {
-        entries.reserve(entries.size() + 1);
-        auto& entry(entries[entries.size()]);
-        entry.pos = text;
-        entry.next = 0;
-        mlEnd = text + strlen(text) + 1;
-        return entries.size();
+        return Identifier(Context::strMng.add(all()[iEntry].pos, size(iEntry)).getId());
     }
 
     void MLParser::copyTo(MLParser& dst, int iEntry, int jEntry) const {
         if (iEntry < jEntry) {
-            int size( (jEntry < int(entries.size()) ? entries[jEntry].pos : mlEnd) - entries[iEntry].pos );
-            dst.mlOrig = strndup(entries[iEntry].pos, size);
-            dst.mlEnd = dst.mlOrig + size;
-            dst.ownOrig = true;
-            dst.entries.assign(entries.begin() + iEntry, entries.begin() + jEntry);
-            // fix next indices and text positions in dst parser
-            for (auto& entry: dst.entries) {
-                entry.pos += dst.mlOrig - entries[iEntry].pos;
-                entry.next = entry.next ? entry.next - iEntry : 0;
+            auto* src(shared);
+            if (src)
+                src->refs++;
+            else {
+                // text and entries of the range into a shared block (next indices and positions rebased)
+                const char* pos(entries[iEntry].pos);
+                int size((jEntry < int(entries.size()) ? entries[jEntry].pos : mlEnd) - pos);
+                src = new Shared{ 1, strndup(pos, size), size, { entries.begin() + iEntry, entries.begin() + jEntry },
+                                  { lengths.begin() + iEntry, lengths.begin() + jEntry } };
+                for (auto& entry: src->entries) {
+                    entry.pos += src->text - pos;
+                    entry.next = entry.next ? entry.next - iEntry : 0;
+                }
+                jEntry -= iEntry;
+                iEntry = 0;
             }
+            dst.finish();
+            dst.clear();
+            dst.shared = src;
+            dst.first = iEntry;
+            dst.last = jEntry;
+            dst.mlOrig = src->text;
+            dst.mlEnd = src->text + src->nText;
         }
     }
 
@@ -370,8 +620,15 @@ namespace webui {
         ::swap(ownOrig, o.ownOrig);
         ::swap(mlOrig, o.mlOrig);
         ::swap(mlEnd, o.mlEnd);
+        ::swap(stream, o.stream);
+        ::swap(head, o.head);
+        ::swap(shared, o.shared);
+        ::swap(first, o.first);
+        ::swap(last, o.last);
+        pending.swap(o.pending);
         DIAG(::swap(line, o.line));
         entries.swap(o.entries);
+        lengths.swap(o.lengths);
     }
 
     DIAG(
@@ -394,13 +651,13 @@ namespace webui {
     DIAG(
         void MLParser::dumpTree() const {
             LOG("parser entries tree");
-            dumpTreeRecur(0, entries.size(), 0);
+            dumpTreeRecur(first, size(), 0);
         });
 
     DIAG(
         void MLParser::dumpTreeRecur(int iEntry, int fEntry, int level) const {
             while (iEntry < fEntry) {
-                const auto& entry(entries[iEntry]);
+                const auto& entry(all()[iEntry]);
                 int next(entry.next ? entry.next : fEntry);
                 LOG(CYAN "%*s%d" RESET " %.*s " RED "%s " BLUE "%d" RESET,
                     level*2, "", iEntry, size(iEntry), entry.pos, toString(entry.type()), entry.next);
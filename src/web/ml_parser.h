@@ -14,12 +14,23 @@
 namespace webui {
 
     class MLParser {
+        friend class Image;
+
     public:
-        MLParser(): ownOrig(false), mlOrig(nullptr), mlEnd(nullptr) { }
+        MLParser(): ownOrig(false), mlOrig(nullptr), mlEnd(nullptr), head(-1), shared(nullptr), first(0), last(0), stream{ } { }
         ~MLParser();
 
         bool parse(const char* ml, int n);
 
+        // incremental parsing of a document received in chunks (keeps its own copy): complete items of a
+        // root list or object are parsed as soon as they arrive, so entries grow with the received data;
+        // other documents are parsed by end(). Lists that are items (or values of items) of the root are
+        // streamed the same way down to the rows of template data (see Stream), their entries having next
+        // == 0 while open
+        void begin();
+        bool feed(const char* data, int n);
+        bool end();
+
         enum class EntryType {
             Unknown,
             Id,
@@ -38,25 +49,31 @@ namespace webui {
         DIAG(static const char* toString(EntryType t));
 
         struct Entry {
-            Entry(EntryType type, const char* pos = nullptr DIAG(, int line = 0)): pos(pos), next(0), type_(int(type)) DIAG(, line(line)) { }
+            Entry(EntryType type, const char* pos = nullptr DIAG(, int line = 0)):
+                pos(pos), next(0), type_(int(type)) DIAG(, line(line)) { }
             inline EntryType type() const { return EntryType(type_); }
             inline void setType(EntryType type) { type_ = int(type); }
 
             const char* pos;
-            int next:28;
+            int next:28;         // next entry in the same level or end of the level
             uint32_t type_:4;
             DIAG(int line);
         };
-
-        inline bool empty() const { return entries.empty(); }
-        inline void clear() { entries.clear(); }
-        inline int size() const { return entries.size(); }
-        inline Entry& operator[](int i) { return entries[i]; }
-        inline const Entry& operator[](int i) const { return entries[i]; }
-        int size(int iEntry) const;
+        // two words (token lengths are kept aside, see lengths)
+        static_assert(sizeof(Entry) == 2 * sizeof(void*) DIAG(+ (sizeof(void*) == 4 ? sizeof(int) : 0)), "parser entry size");
+
+        // entries are in [firstEntry(), size()): copies are views of a range of a shared parse
+        inline bool empty() const { return size() == first; }
+        inline void clear() { entries.clear(); lengths.clear(); pending.clear(); }
+        inline int firstEntry() const { return first; }
+        inline int size() const { return shared ? last : entries.size(); }
+        inline Entry& operator[](int i) { return all()[i]; }
+        inline const Entry& operator[](int i) const { return all()[i]; }
+        inline int size(int iEntry) const { return allLengths()[iEntry]; }
         void swap(MLParser& o);
         inline void swapEnd(MLParser& other) { std::swap(mlEnd, other.mlEnd); }
-        int getTemporalEntry(const char* text);
+        // dst views entries [iEntry, jEntry): O(1) if this parser is already a view (only the first copy of a
+        // parse copies the text and entries of the range)
         void copyTo(MLParser& dst, int iEntry, int jEntry) const;
 
         // get elements of ML
@@ -73,11 +90,57 @@ namespace webui {
         const char* mlEnd;
         DIAG(mutable int line);
         std::vector<Entry> entries;
+        std::vector<int> lengths;    // of the token of each entry in the document
+        std::vector<int> pending;    // entries whose next is not known yet (increasing)
+        int head;                    // first entry of the expression being parsed
+
+        // immutable text and entries shared by copies, reference counted
+        struct Shared {
+            int refs;
+            char* text;
+            int nText;
+            std::vector<Entry> entries;
+            std::vector<int> lengths;
+        };
+        Shared* shared;              // if not null, entries [first, last) of it are viewed
+        int first, last;
+        inline std::vector<Entry>& all() { return shared ? shared->entries : entries; }
+        inline const std::vector<Entry>& all() const { return shared ? shared->entries : entries; }
+        inline const std::vector<int>& allLengths() const { return shared ? shared->lengths : lengths; }
+
+        // resumable state of incremental parsing (offsets in the document)
+        enum { MaxLevels = 3 };
+        struct Level {
+            int item;        // first entry of the item holding the level (key of key: [ in objects)
+            int value;       // list or object entry of the level
+            int prevItem;    // last item parsed
+            bool list;       // items separated by ',' or object items
+            bool comma;      // list item parsed, expecting ','
+        };
+        struct Stream {
+            int capacity;
+            int scanned;     // structure classified up to here
+            int parsed;      // entries created up to here
+            int depth;       // nesting of (), [] and {}
+            int nLevels;     // streamed levels (depths 1 to nLevels)
+            int maxLevels;   // root list: [ [ row... ] ], root object: { key: [ [ row... ] ] }
+            Level levels[MaxLevels];
+            char quote;      // inside a string
+            bool closed;     // root closed
+            bool whole;      // not a root list or object: parse it at the end
+        } stream;
 
         void finish();
+        bool parseDocument(const char* ml);
+        bool scanStream();
+        bool beginRoot(const char* open);
+        bool beginLevel(const char* open);
+        bool endLevel(const char* close);
+        bool parseItems(const char* limit);
 
         inline char get(const char* ml) const { return ml < mlEnd ? *ml : 0; }
-        int newEntry(EntryType type, const char* pos, int prev);
+        int newEntry(EntryType type, const char* pos, int length, int prev);
+        void closeLevel(int iEntry);
 
         char skipSpace(const char*&ml) const;
         void skipLine(const char*&ml) const;
@@ -92,13 +155,12 @@ namespace webui {
         int parseExpression(const char*&ml, int prev);
         int parseExpressionRecur(const char*&ml, int prev, const char* op = nullptr);
         int parseObject(const char*&ml, int prev, char endChar);
+        int parseObjectItem(const char*&ml, int prevInner);
         bool parseList(const char*&ml, char endChar);
 
         // returns the size of the operator or 0 if no operator found
         static int isOperator(const char* c);
 
-        void fixLevelEndings(int iEntry, int jEntry);
-
         DIAG(void dumpTreeRecur(int iEntry, int fEntry, int level) const);
     };
 
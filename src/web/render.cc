@@ -12,6 +12,8 @@
 #include "nanovg_gl.h"
 #include "nanovg_gl_utils.h"
 
+#include <cmath>
+#include <algorithm>
 #include <cstddef>
 #include <cassert>
 
@@ -64,14 +66,105 @@ namespace webui {
         windowSize[0] = width;
         windowSize[1] = height;
         glViewport(0, 0, width, height);
+        damageAll();
+    }
+
+    void Render::damage(const Box4f& box) {
+        if (box.empty()) return;
+        Box4f b(box.pos.x - DamageMargin, box.pos.y - DamageMargin, box.size.x + 2 * DamageMargin, box.size.y + 2 * DamageMargin);
+        if (damaged.empty())
+            damaged = b;
+        else
+            damaged.merge(b);
+    }
+
+    void Render::beginBounds() {
+        bounding = true;
+        boundsMin.assign(1e30f, 1e30f);
+        boundsMax.assign(-1e30f, -1e30f);
+        boundsStroke = 0.0f;
+    }
+
+    Box4f Render::endBounds() {
+        bounding = false;
+        if (boundsMin.x > boundsMax.x) return Box4f(0.0f, 0.0f, 0.0f, 0.0f);
+        float m(boundsStroke * 0.5f);
+        return Box4f(boundsMin.x - m, boundsMin.y - m, boundsMax.x - boundsMin.x + 2 * m, boundsMax.y - boundsMin.y + 2 * m);
+    }
+
+    void Render::addBounds(float x, float y, float w, float h) const {
+        float xform[6];
+        nvgCurrentTransform(vg, xform);
+        for (int i = 0; i < 4; i++) {
+            float px, py;
+            nvgTransformPoint(&px, &py, xform, i & 1 ? x + w : x, i & 2 ? y + h : y);
+            boundsMin.x = min(boundsMin.x, px);
+            boundsMin.y = min(boundsMin.y, py);
+            boundsMax.x = max(boundsMax.x, px);
+            boundsMax.y = max(boundsMax.y, py);
+        }
     }
 
     void Render::beginFrame() {
+        // persistent framebuffer of window size
+        if (fbSize != windowSize) {
+            if (fb) nvgluDeleteFramebuffer(fb);
+            fb = nvgluCreateFramebuffer(vg, windowSize[0], windowSize[1], 0);
+            DIAG(if (!fb) LOG("warning: no framebuffer, rendering whole frames"));
+            fbSize = windowSize;
+            damagedAll = true;
+        }
+
+        // clip to the damaged region rounded to pixels
+        Box4f window(0.0f, 0.0f, float(windowSize[0]), float(windowSize[1]));
+        clip = window;
+        if (fb && !damagedAll) {
+            float x0(floorf(damaged.pos.x)), y0(floorf(damaged.pos.y));
+            clip.intersect(Box4f(x0, y0, ceilf(damaged.pos.x + damaged.size.x) - x0, ceilf(damaged.pos.y + damaged.size.y) - y0));
+        }
+        clipped = !(clip == window);
+        resetDamage();
+
+        if (fb) nvgluBindFramebuffer(fb);
         nvgBeginFrame(vg, windowSize[0], windowSize[1], 1.0f/*aspect ratio*/);
+        if (clipped) clipScissor();
     }
 
     void Render::endFrame() {
         nvgEndFrame(vg);
+        clipped = false;
+        if (fb) present();
+    }
+
+    void Render::clear(RGBA color) {
+        clearColor = color;
+        glClearColor(color.rf(), color.gf(), color.bf(), color.af());
+        if (clipped) {
+            glEnable(GL_SCISSOR_TEST);
+            glScissor(int(clip.pos.x), windowSize[1] - int(clip.pos.y + clip.size.y), int(clip.size.x), int(clip.size.y));
+        }
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+        if (clipped) glDisable(GL_SCISSOR_TEST);
+    }
+
+    void Render::clipScissor() const {
+        // clip is in window coordinates
+        float xform[6];
+        nvgCurrentTransform(vg, xform);
+        nvgResetTransform(vg);
+        nvgScissor(vg, clip.pos.x, clip.pos.y, clip.size.x, clip.size.y);
+        nvgTransform(vg, xform[0], xform[1], xform[2], xform[3], xform[4], xform[5]);
+    }
+
+    void Render::present() {
+        // copy the persistent framebuffer to the window
+        nvgluBindFramebuffer(nullptr);
+        nvgBeginFrame(vg, windowSize[0], windowSize[1], 1.0f/*aspect ratio*/);
+        nvgBeginPath(vg);
+        nvgRect(vg, 0.0f, 0.0f, float(windowSize[0]), float(windowSize[1]));
+        nvgFillPaint(vg, nvgImagePattern(vg, 0.0f, 0.0f, float(windowSize[0]), float(windowSize[1]), 0.0f, fb->image, 1.0f));
+        nvgFill(vg);
+        nvgEndFrame(vg);
     }
 
     void Render::swapBuffers() {
@@ -89,11 +182,18 @@ namespace webui {
     }
 
     void Render::textAlign(int align) {
-        nvgTextAlign(vg, align);
+        if (drawing) nvgTextAlign(vg, align);
+        if (recording) recording->add(DisplayList::Op::TextAlign, align);
     }
 
     float Render::text(float x, float y, const char* str) {
-        if (!str) return x;
+        if (recording) recording->addText(x, y, str);
+        if (!str || !drawing) return x;
+        if (bounding) {
+            float b[4];
+            nvgTextBounds(vg, x, y, str, nullptr, b); // color escapes measured as glyphs: larger
+            addBounds(b[0], b[1], b[2] - b[0], b[3] - b[1]);
+        }
         const char* prev(str);
         while (*str) {
             if (*str == 0x1b) {
@@ -11,50 +11,105 @@
 #include "types.h"
 #include "vector.h"
 #include "nanovg.h"
+#include "display_list.h"
 
 struct NVGcontext;
 struct GLFWwindow;
+struct NVGLUframebuffer;
+
+// records the call in the display list being recorded
+#define REC(op, ...) if (recording) recording->add(DisplayList::Op::op, ##__VA_ARGS__)
+// nanovg call, skipped while only recording
+#define DRAW(call) if (drawing) call
+// accumulates the window coordinates of the geometry while measuring bounds
+#define BOUND(...) if (bounding) addBounds(__VA_ARGS__)
 
 namespace webui {
 
     class Render {
     public:
-        Render(): win(nullptr), vg(nullptr) { }
+        enum { DamageMargin = 2 };   // pixels around damaged boxes (antialiasing)
+
+        Render(): win(nullptr), vg(nullptr), fb(nullptr), fbSize(0, 0), recording(nullptr), drawing(true), damagePass(false), damagedAll(true),
+                  clipped(false), bounding(false), damaged(0.0f, 0.0f, 0.0f, 0.0f), clip(0.0f, 0.0f, 0.0f, 0.0f) { }
         bool init();
         DIAG(void finish());
         void setWindowSize(int width, int height);
         void swapBuffers();
         static bool checkError();
 
+        // damaged region: frames are rendered into a persistent framebuffer clipped to the union of
+        // damaged boxes, the rest of the framebuffer is kept from previous frames
+        void damage(const Box4f& box);
+        inline void damageAll() { damagedAll = true; }
+        inline void resetDamage() { damagedAll = false; damaged.size.assign(0.0f, 0.0f); }
+        inline bool isDamaged() const { return damagedAll || !damaged.empty(); }
+        inline bool isDamagedAll() const { return damagedAll; }
+        inline const Box4f& getDamage() const { return damaged; }
+
+        // damage pass: widgets compare what they would render with the last frame instead of rendering
+        inline void setDamagePass(bool pass) { damagePass = pass; }
+        inline bool isDamagePass() const { return damagePass; }
+
+        // bounds in window coordinates of what is drawn between begin and end (no display list needed)
+        void beginBounds();
+        Box4f endBounds();
+
         // nanovg
-        void beginFrame();
+        void beginFrame();           // consumes the damaged region
         void endFrame();
-        inline int multAlpha(int m, int a) { int alpha((m * a) >> 8); nvgGlobalAlpha(vg, float(alpha) * (1.0f / 256.0f)); return alpha; }
-        inline void beginPath() const { nvgBeginPath(vg); }
-        inline void moveto(float x, float y) const { nvgMoveTo(vg, x, y); }
-        inline void lineto(float x, float y) const { nvgLineTo(vg, x, y); }
-        inline void bezierto(float x1, float y1, float x2, float y2, float x, float y) const { nvgBezierTo(vg, x1, y1, x2, y2, x, y); }
-        inline void closePath() const { nvgClosePath(vg); }
-        inline void roundedRect(float x, float y, float w, float h, float r) const { nvgRoundedRect(vg, x, y, w, h, r); }
-        inline void fillColor(RGBA color) const { nvgFillColor(vg, color.toVGColor()); }
+        void clear(RGBA color);
+        inline bool isClipped() const { return clipped; }
+        inline const Box4f& getClip() const { return clip; }
+        inline RGBA getClearColor() const { return clearColor; }
+        inline int multAlpha(int m, int a) {
+            int alpha((m * a) >> 8);
+            if (!damagePass) nvgGlobalAlpha(vg, float(alpha) * (1.0f / 256.0f)); // no frame in the damage pass
+            return alpha;
+        }
+        inline void beginPath() const { DRAW(nvgBeginPath(vg)); REC(BeginPath); }
+        inline void moveto(float x, float y) const { DRAW(nvgMoveTo(vg, x, y)); REC(Moveto, x, y); BOUND(x, y); }
+        inline void lineto(float x, float y) const { DRAW(nvgLineTo(vg, x, y)); REC(Lineto, x, y); BOUND(x, y); }
+        inline void bezierto(float x1, float y1, float x2, float y2, float x, float y) const {
+            DRAW(nvgBezierTo(vg, x1, y1, x2, y2, x, y));
+            REC(Bezierto, x1, y1, x2, y2, x, y);
+            if (bounding) { addBounds(x1, y1); addBounds(x2, y2); addBounds(x, y); } // the curve is inside the hull
+        }
+        inline void closePath() const { DRAW(nvgClosePath(vg)); REC(ClosePath); }
+        inline void roundedRect(float x, float y, float w, float h, float r) const { DRAW(nvgRoundedRect(vg, x, y, w, h, r)); REC(RoundedRect, x, y, w, h, r); BOUND(x, y, w, h); }
+        inline void fillColor(RGBA color) const { DRAW(nvgFillColor(vg, color.toVGColor())); REC(FillColor, color); }
         inline void fillVertGrad(float y, float h, RGBA top, RGBA bottom) const {
-            nvgFillPaint(vg, nvgLinearGradient(vg, 0, y, 0, y + h, top.toVGColor(), bottom.toVGColor()));
+            DRAW(nvgFillPaint(vg, nvgLinearGradient(vg, 0, y, 0, y + h, top.toVGColor(), bottom.toVGColor())));
+            REC(FillVertGrad, y, h, top, bottom);
+        }
+        inline void fill() const { DRAW(nvgFill(vg)); REC(Fill); }
+        inline void strokeWidth(float width) const {
+            DRAW(nvgStrokeWidth(vg, width));
+            REC(StrokeWidth, width);
+            if (bounding && width > boundsStroke) boundsStroke = width;
+        }
+        inline void strokeColor(RGBA color) const { DRAW(nvgStrokeColor(vg, color.toVGColor())); REC(StrokeColor, color); }
+        inline void stroke() const { DRAW(nvgStroke(vg)); REC(Stroke); }
+        inline void translate(float x, float y) const { DRAW(nvgTranslate(vg, x, y)); REC(Translate, x, y); }
+        inline void scale(float x, float y) const { DRAW(nvgScale(vg, x, y)); REC(Scale, x, y); }
+        inline void resetTransform() const { DRAW(nvgResetTransform(vg)); REC(ResetTransform); }
+        inline void scissor(float x, float y, float w, float h) const {
+            if (drawing) {
+                if (clipped) { clipScissor(); nvgIntersectScissor(vg, x, y, w, h); } else nvgScissor(vg, x, y, w, h);
+            }
+            REC(Scissor, x, y, w, h);
         }
-        inline void fill() const { nvgFill(vg); }
-        inline void strokeWidth(float width) const { nvgStrokeWidth(vg, width); }
-        inline void strokeColor(RGBA color) const { nvgStrokeColor(vg, color.toVGColor()); }
-        inline void stroke() const { nvgStroke(vg); }
-        inline void translate(float x, float y) const { nvgTranslate(vg, x, y); }
-        inline void scale(float x, float y) const { nvgScale(vg, x, y); }
-        inline void resetTransform() const { nvgResetTransform(vg); }
-        inline void scissor(float x, float y, float w, float h) const { nvgScissor(vg, x, y, w, h); }
-        inline void resetScissor() const { nvgResetScissor(vg); }
-        inline void font(int iFont) const { nvgFontFaceId(vg, iFont); }
-        inline void fontSize(float size) const { nvgFontSize(vg, size); }
+        inline void resetScissor() const { DRAW(clipped ? clipScissor() : nvgResetScissor(vg)); REC(ResetScissor); }
+        inline void font(int iFont) const { DRAW(nvgFontFaceId(vg, iFont)); REC(Font, iFont); }
+        inline void fontSize(float size) const { DRAW(nvgFontSize(vg, size)); REC(FontSize, size); }
         void textAlign(int align);
         float text(float x, float y, const char* str);
         float textWidth(const char* str);
 
+        // display list recording of the following calls (null to stop); without drawing, nanovg is not
+        // called at all (no render context needed, text is not measured)
+        inline void setRecording(DisplayList* list, bool draw = true) { recording = list; drawing = draw || !list; }
+
         int loadFont(const char* name, char* data, int nData) { return nvgCreateFontMem(vg, name, (uint8_t*)data, nData, false); }
 
         // getters
@@ -66,7 +121,22 @@ namespace webui {
     private:
         GLFWwindow* win;
         NVGcontext* vg;
-        V2s windowSize;
+        NVGLUframebuffer* fb;        // persistent frame (null if not available: whole frames are rendered)
+        V2s windowSize, fbSize;
+        DisplayList* recording;
+        bool drawing;                // nanovg calls are made (not only recorded)
+        bool damagePass, damagedAll, clipped, bounding;
+        Box4f damaged, clip;
+        mutable V2f boundsMin, boundsMax;
+        mutable float boundsStroke;
+        RGBA clearColor;
+
+        void clipScissor() const;
+        void addBounds(float x, float y, float w = 0.0f, float h = 0.0f) const;
+        void present();
     };
 
 }
+
+#undef REC
+#undef DRAW
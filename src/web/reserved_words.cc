@@ -7,16 +7,14 @@
 */
 
 #include "reserved_words.h"
-#include "context.h"
-#include "compatibility.h"
-#include "string_manager.h"
-#include <cassert>
 
 #define _ "\0"
 
+using namespace webui;
+
 namespace {
 
-    const char* reservedWords =
+    constexpr char reservedWords[] =
         "Application" _
         "Widget" _
         "LayoutHor" _
@@ -60,6 +58,7 @@ namespace {
         "hoverY" _
         "size" _
         "last" _
+        "overscan" _
         "ALast" _
 
         "propInt16" _
@@ -103,22 +102,120 @@ namespace {
         "%" _
         "=" _
         "FLast" _
+
+        "Patch" _
+        "seq" _
+        "data" _
+        "path" _
+        "field" _
+        "value" _
+        "row" _
+        "before" _
+        "update" _
+        "insert" _
+        "remove" _
+        "move" _
+        "KLast" _
         _;
+
+    // perfect hash of reserved words (hash and displace): words are spread in buckets by hash and each bucket,
+    // largest first, gets the first displacement placing all its words in free slots; built at compile time
+    class ReservedHash {
+    public:
+        enum { Slots = 512, Buckets = 128, MaxWords = 256, MaxBucket = 16, MaxDisplacement = 1 << 16 };
+
+        constexpr ReservedHash(): slots(), displacement(), size(0), valid(true) {
+            // words of each bucket as linked lists
+            int offset[MaxWords] = { }, next[MaxWords] = { }, first[Buckets] = { }, bucketSize[Buckets] = { }, nWords(0);
+            uint32_t hash[MaxWords] = { };
+            for (int b = 0; b < Buckets; b++) first[b] = -1;
+            while (reservedWords[size]) {
+                int n(0);
+                while (reservedWords[size + n]) n++;
+                if (nWords == MaxWords) { valid = false; return; }
+                offset[nWords] = size;
+                hash[nWords] = hashString(reservedWords + size, n);
+                int b(hash[nWords] % Buckets);
+                next[nWords] = first[b];
+                first[b] = nWords++;
+                if (++bucketSize[b] > MaxBucket) { valid = false; return; }
+                size += n + 1;
+            }
+            for (int s = 0; s < Slots; s++) slots[s] = -1;
+            for (int count = MaxBucket; count > 0; count--)
+                for (int b = 0; b < Buckets; b++) {
+                    if (bucketSize[b] != count) continue;
+                    int d(0);
+                    for (; d < MaxDisplacement; d++) {
+                        // all words in free and different slots
+                        int used[MaxBucket] = { }, nUsed(0);
+                        for (int w = first[b]; w >= 0 && nUsed >= 0; w = next[w]) {
+                            int s(slot(hash[w], d));
+                            if (slots[s] >= 0) nUsed = -1;
+                            for (int u = 0; u < nUsed; u++)
+                                if (used[u] == s) nUsed = -1;
+                            if (nUsed >= 0) used[nUsed++] = s;
+                        }
+                        if (nUsed >= 0) break;
+                    }
+                    if (d == MaxDisplacement) { valid = false; return; }
+                    displacement[b] = d;
+                    for (int w = first[b]; w >= 0; w = next[w])
+                        slots[slot(hash[w], d)] = offset[w];
+                }
+        }
+
+        static constexpr int slot(uint32_t hash, int d) {
+            uint32_t x(hash ^ (uint32_t(d) * 0x9e3779b9u));
+            x ^= x >> 16;
+            x *= 0x85ebca6bu;
+            x ^= x >> 13;
+            return x & (Slots - 1);
+        }
+
+        constexpr Identifier search(const char* str, int nStr, uint32_t hash) const {
+            int i(slots[slot(hash, displacement[hash % Buckets])]);
+            if (i < 0) return Identifier::InvalidId;
+            for (int k = 0; k < nStr; k++)
+                if (reservedWords[i + k] != str[k]) return Identifier::InvalidId;
+            return reservedWords[i + nStr] ? Identifier::InvalidId : Identifier(i);
+        }
+
+        template <size_t N>
+        constexpr Identifier search(const char (& str)[N]) const {
+            return search(str, N - 1, hashString(str, N - 1));
+        }
+
+        int slots[Slots];                 // offset of reserved word or -1
+        int displacement[Buckets];
+        int size;                         // of all reserved words including separators
+        bool valid;
+    };
+
+    constexpr ReservedHash reservedHash;
+
+    static_assert(reservedHash.valid, "no perfect hash for reserved words");
+    static_assert(reservedHash.search("Application") == Identifier::Application, "reserved words and identifiers differ");
+    static_assert(reservedHash.search("overscan") == Identifier::overscan, "reserved words and identifiers differ");
+    static_assert(reservedHash.search("query") == Identifier::query, "reserved words and identifiers differ");
+    static_assert(reservedHash.search("+") == Identifier::add, "reserved words and identifiers differ");
+    static_assert(reservedHash.search("-") == Identifier::sub, "reserved words and identifiers differ");
+    static_assert(reservedHash.search("=") == Identifier::assign, "reserved words and identifiers differ");
+    static_assert(reservedHash.search("FLast") == Identifier::FLast, "reserved words and identifiers differ");
+    static_assert(reservedHash.search("move") == Identifier::move, "reserved words and identifiers differ");
+    static_assert(reservedHash.search("overscans") == Identifier::InvalidId, "reserved word false positive");
+
 }
 
 namespace webui {
 
-    void addReservedWords() {
-        const char* rw(reservedWords);
-        while (*rw) {
-            int n(strlen(rw));
-            Context::strMng.add(rw);
-            rw += n + 1;
-        }
-        assert(Context::strMng.search("query").getId() == Identifier::query);
-        assert(Context::strMng.search("+").getId() == Identifier::add);
-        assert(Context::strMng.search("-").getId() == Identifier::sub);
-        assert(Context::strMng.search("=").getId() == Identifier::assign);
+    Identifier searchReservedWord(const char* str, int nStr, uint32_t hash) {
+        return reservedHash.search(str, nStr, hash);
+    }
+
+    const char* getReservedWords(int& size) {
+        size = reservedHash.size;
+        return reservedWords;
     }
 
 }
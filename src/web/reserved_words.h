@@ -9,16 +9,22 @@
 #pragma once
 
 #include <cstring>
+#include <cstdint>
 
 #define OffsetEnum(x) x + constlen(#x)
 
 namespace webui {
 
-    void addReservedWords();
-
     template <size_t N>
     constexpr int constlen(const char (& s)[N]) { return N; }
 
+    // FNV-1a (h continues a previous hash)
+    constexpr uint32_t hashString(const char* str, int nStr, uint32_t h = 2166136261u) {
+        for (int i = 0; i < nStr; i++)
+            h = (h ^ uint8_t(str[i])) * 16777619u;
+        return h;
+    }
+
     enum class Identifier: int {
         InvalidId        = -1,
 
@@ -67,7 +73,8 @@ namespace webui {
         hoverY           = OffsetEnum(hoverX),
         size             = OffsetEnum(hoverY),
         last             = OffsetEnum(size),
-        ALast            = OffsetEnum(last),
+        overscan         = OffsetEnum(last),
+        ALast            = OffsetEnum(overscan),
 
         // property attribute definition
         propInt16        = OffsetEnum(ALast),
@@ -112,7 +119,27 @@ namespace webui {
         div              = OffsetEnum(CLast) + 6,  // /
         mod              = OffsetEnum(CLast) + 8,  // %
         assign           = OffsetEnum(CLast) + 10, // =
-        FLast            = OffsetEnum(CLast) + 15,
+        FLast            = OffsetEnum(CLast) + 12,
+
+        // patch keywords
+        Patch            = OffsetEnum(FLast),
+        seq              = OffsetEnum(Patch),
+        data             = OffsetEnum(seq),
+        path             = OffsetEnum(data),
+        field            = OffsetEnum(path),
+        value            = OffsetEnum(field),
+        row              = OffsetEnum(value),
+        before           = OffsetEnum(row),
+        update           = OffsetEnum(before),
+        insert           = OffsetEnum(update),
+        remove           = OffsetEnum(insert),
+        move             = OffsetEnum(remove),
+        KLast            = OffsetEnum(move),
     };
 
+    // reserved words are the first strings in the string pool (their offset is their identifier), found with
+    // a compile-time perfect hash; InvalidId if str is not a reserved word
+    Identifier searchReservedWord(const char* str, int nStr, uint32_t hash);
+    const char* getReservedWords(int& size); // "\0" separated
+
 }
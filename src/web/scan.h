@@ -0,0 +1,152 @@
+/*  -*- mode: c++; coding: utf-8; c-file-style: "stroustrup"; -*-
+
+    Contributors: Asier Aguirre
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#  define SCAN_SSE2
+#  define SCAN_SIMD
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#  include <arm_neon.h>
+#  define SCAN_NEON
+#  define SCAN_SIMD
+#elif defined(__wasm_simd128__)
+#  include <wasm_simd128.h>
+#  define SCAN_WASM
+#  define SCAN_SIMD
+#endif
+
+namespace webui {
+
+    // character class scanning for the ML tokenizer: classifies 16 bytes at a time when SIMD is available
+    // (SSE2, NEON or wasm SIMD) and falls back to scalar code for the tail of the buffer and other targets;
+    // class predicates are written once over the operations below, that exist both for chars and vectors
+    namespace scan {
+
+        inline bool eq(char c, char v) { return c == v; }
+        inline bool inRange(char c, uint8_t lo, uint8_t hi) { return uint8_t(uint8_t(c) - lo) <= uint8_t(hi - lo); }
+        inline char asLower(char c) { return c | 0x20; }
+        inline bool any(bool a, bool b) { return a || b; }
+
+#if defined(SCAN_SSE2)
+        typedef __m128i Vec;
+        enum { Lanes = 16 };
+        inline Vec load(const char* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+        inline Vec eq(Vec v, char c) { return _mm_cmpeq_epi8(v, _mm_set1_epi8(c)); }
+        inline Vec inRange(Vec v, uint8_t lo, uint8_t hi) {
+            Vec x(_mm_sub_epi8(v, _mm_set1_epi8(char(lo))));
+            return _mm_cmpeq_epi8(_mm_min_epu8(x, _mm_set1_epi8(char(hi - lo))), x);
+        }
+        inline Vec asLower(Vec v) { return _mm_or_si128(v, _mm_set1_epi8(0x20)); }
+        inline Vec any(Vec a, Vec b) { return _mm_or_si128(a, b); }
+        // index of first lane not in class (Lanes if all of them are)
+        inline int firstMiss(Vec v) {
+            unsigned m(~_mm_movemask_epi8(v) & 0xffff);
+            return m ? __builtin_ctz(m) : Lanes;
+        }
+        inline int firstHit(Vec v) {
+            unsigned m(_mm_movemask_epi8(v));
+            return m ? __builtin_ctz(m) : Lanes;
+        }
+#elif defined(SCAN_NEON)
+        typedef uint8x16_t Vec;
+        enum { Lanes = 16 };
+        inline Vec load(const char* p) { return vld1q_u8(reinterpret_cast<const uint8_t*>(p)); }
+        inline Vec eq(Vec v, char c) { return vceqq_u8(v, vdupq_n_u8(uint8_t(c))); }
+        inline Vec inRange(Vec v, uint8_t lo, uint8_t hi) { return vcleq_u8(vsubq_u8(v, vdupq_n_u8(lo)), vdupq_n_u8(hi - lo)); }
+        inline Vec asLower(Vec v) { return vorrq_u8(v, vdupq_n_u8(0x20)); }
+        inline Vec any(Vec a, Vec b) { return vorrq_u8(a, b); }
+        // 4 bits per lane mask (no movemask in NEON)
+        inline uint64_t nibbles(Vec v) {
+            return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(v), 4)), 0);
+        }
+        inline int firstMiss(Vec v) {
+            uint64_t m(~nibbles(v));
+            return m ? __builtin_ctzll(m) >> 2 : Lanes;
+        }
+        inline int firstHit(Vec v) {
+            uint64_t m(nibbles(v));
+            return m ? __builtin_ctzll(m) >> 2 : Lanes;
+        }
+#elif defined(SCAN_WASM)
+        typedef v128_t Vec;
+        enum { Lanes = 16 };
+        inline Vec load(const char* p) { return wasm_v128_load(p); }
+        inline Vec eq(Vec v, char c) { return wasm_i8x16_eq(v, wasm_i8x16_splat(c)); }
+        inline Vec inRange(Vec v, uint8_t lo, uint8_t hi) {
+            return wasm_u8x16_le(wasm_i8x16_sub(v, wasm_i8x16_splat(char(lo))), wasm_i8x16_splat(char(hi - lo)));
+        }
+        inline Vec asLower(Vec v) { return wasm_v128_or(v, wasm_i8x16_splat(0x20)); }
+        inline Vec any(Vec a, Vec b) { return wasm_v128_or(a, b); }
+        inline int firstMiss(Vec v) {
+            unsigned m(~wasm_i8x16_bitmask(v) & 0xffff);
+            return m ? __builtin_ctz(m) : Lanes;
+        }
+        inline int firstHit(Vec v) {
+            unsigned m(wasm_i8x16_bitmask(v));
+            return m ? __builtin_ctz(m) : Lanes;
+        }
+#endif
+
+        // character classes
+        struct Space {
+            template <typename T> inline auto operator()(T v) const { return any(eq(v, ' '), inRange(v, '\t', '\r')); }
+        };
+        struct IdChar {
+            template <typename T> inline auto operator()(T v) const {
+                return any(any(inRange(asLower(v), 'a', 'z'), inRange(v, '0', '9')), eq(v, '_'));
+            }
+        };
+        struct Digit {
+            template <typename T> inline auto operator()(T v) const { return inRange(v, '0', '9'); }
+        };
+        // string contents end at the quote, an escape sequence or a null char
+        struct StringEnd {
+            char quote;
+            template <typename T> inline auto operator()(T v) const { return any(any(eq(v, quote), eq(v, '\x1b')), eq(v, 0)); }
+        };
+
+        // returns the first position in [p, end) not in class
+        template <typename Class>
+        inline const char* skip(const char* p, const char* end, Class inClass) {
+#ifdef SCAN_SIMD
+            while (end - p >= Lanes) {
+                int n(firstMiss(inClass(load(p))));
+                p += n;
+                if (n < Lanes) return p;
+            }
+#endif
+            while (p < end && inClass(*p)) ++p;
+            return p;
+        }
+
+        // returns the first position in [p, end) in class
+        template <typename Class>
+        inline const char* find(const char* p, const char* end, Class inClass) {
+#ifdef SCAN_SIMD
+            while (end - p >= Lanes) {
+                int n(firstHit(inClass(load(p))));
+                p += n;
+                if (n < Lanes) return p;
+            }
+#endif
+            while (p < end && !inClass(*p)) ++p;
+            return p;
+        }
+
+        inline const char* skipSpace(const char* p, const char* end) { return skip(p, end, Space()); }
+        inline const char* skipId(const char* p, const char* end) { return skip(p, end, IdChar()); }
+        inline const char* skipDigits(const char* p, const char* end) { return skip(p, end, Digit()); }
+        inline const char* findStringEnd(const char* p, const char* end, char quote) { return find(p, end, StringEnd{ quote }); }
+
+    }
+
+}
@@ -9,30 +9,139 @@
 #include "string_manager.h"
 #include "compatibility.h"
 #include <cstring>
+#include <algorithm>
+
+using namespace std;
 
 namespace webui {
 
+    StringManager::StringManager(): table(1024, -1), hashes(1024), nStrings(0), deadBytes(0), sorted(false) {
+        // reserved words are not interned (see searchReservedWord)
+        auto* rw(getReservedWords(nReserved));
+        doc.assign(rw, rw + nReserved);
+    }
+
     StringId StringManager::add(const char *str, int nStr) {
         if (!str) return -1;
         if (nStr < 0) nStr = strlen(str);
-        int iIndex(searchNearestIndex(str, nStr));
-        if (iIndex < int(index.size()) &&
-            !strncmp(&doc[index[iIndex]], str, nStr) &&
-            !doc[index[iIndex] + nStr])
-            return index[iIndex];
-
-        // add string
-        auto i(doc.size());
-        doc.resize(doc.size() + nStr + 1);
+        auto h(hashString(str, nStr));
+        auto id(searchReservedWord(str, nStr, h));
+        if (id != Identifier::InvalidId) return id;
+        int slot(findSlot(str, nStr, h));
+        if (table[slot] >= 0) return table[slot];
+
+        // add string (in the room of a released one if possible)
+        int i(doc.size());
+        auto it(freeBySize.find(nStr + 1));
+        if (it != freeBySize.end() && !it->second.empty()) {
+            i = it->second.back();
+            it->second.pop_back();
+            deadBytes -= nStr + 1;
+        } else
+            doc.resize(doc.size() + nStr + 1);
         memcpy(&doc[i], str, nStr);
         doc[i + nStr] = 0;
 
-        // add index
-        index.insert(index.begin() + iIndex, i);
+        // add to hash index (load factor <= 0.5)
+        table[slot] = i;
+        hashes[slot] = h;
+        if (++nStrings * 2 > int(table.size())) grow();
+        sorted = false;
         return i;
     }
 
+    int StringManager::findSlot(const char* str, int nStr, uint32_t h) const {
+        // linear probing: slot of the string or the empty one where it would be
+        int mask(int(table.size()) - 1);
+        for (int slot = h & mask; ; slot = (slot + 1) & mask) {
+            int i(table[slot]);
+            // the terminator first: a shorter string at the end of doc must not be compared past it
+            if (i < 0 || (hashes[slot] == h && i + nStr < int(doc.size()) && !doc[i + nStr] && !memcmp(&doc[i], str, nStr)))
+                return slot;
+        }
+    }
+
+    void StringManager::grow() {
+        vector<int> tableOld(table.size() * 2, -1);
+        vector<uint32_t> hashesOld(table.size() * 2);
+        swap(table, tableOld);
+        swap(hashes, hashesOld);
+        int mask(int(table.size()) - 1);
+        for (size_t j = 0; j < tableOld.size(); j++)
+            if (tableOld[j] >= 0) {
+                int slot(hashesOld[j] & mask);
+                while (table[slot] >= 0) slot = (slot + 1) & mask;
+                table[slot] = tableOld[j];
+                hashes[slot] = hashesOld[j];
+            }
+    }
+
+    void StringManager::beginMark() {
+        marks.assign(doc.size(), false);
+    }
+
+    void StringManager::sweep() {
+        // rebuild hash index with marked strings
+        vector<int> tableOld(table.size(), -1);
+        vector<uint32_t> hashesOld(table.size());
+        swap(table, tableOld);
+        swap(hashes, hashesOld);
+        int mask(int(table.size()) - 1);
+        vector<pair<int, int>> released; // offset, size
+        for (size_t j = 0; j < tableOld.size(); j++) {
+            int i(tableOld[j]);
+            if (i < 0) continue;
+            if (marks[i]) {
+                int slot(hashesOld[j] & mask);
+                while (table[slot] >= 0) slot = (slot + 1) & mask;
+                table[slot] = i;
+                hashes[slot] = hashesOld[j];
+            } else {
+                released.push_back(make_pair(i, int(strlen(&doc[i])) + 1));
+                nStrings--;
+            }
+        }
+        DIAG(
+            for (const auto& r: released) memset(&doc[r.first], Poison, r.second - 1);
+            swap(released, quarantine));
+
+        // room at the end of doc is given back, the rest is kept by size
+        for (const auto& sizeOffsets: freeBySize)
+            for (auto i: sizeOffsets.second)
+                released.push_back(make_pair(i, sizeOffsets.first));
+        std::sort(released.begin(), released.end());
+        while (!released.empty() && released.back().first + released.back().second == int(doc.size())) {
+            doc.resize(released.back().first);
+            released.pop_back();
+        }
+        freeBySize.clear();
+        deadBytes = 0;
+        for (const auto& r: released) {
+            freeBySize[r.second].push_back(r.first);
+            deadBytes += r.second;
+        }
+        DIAG(for (const auto& r: quarantine) deadBytes += r.second);
+        marks.clear();
+        sorted = false;
+    }
+
+    DIAG(const char* StringManager::released(StringId id) const {
+            LOG("stale string id %d: string was released", int(id.getId()));
+            return "(released)";
+        });
+
+    void StringManager::sort() const {
+        index.clear();
+        for (int i = 0; i < nReserved; i += strlen(&doc[i]) + 1)
+            index.push_back(i);
+        for (auto i: table)
+            if (i >= 0) index.push_back(i);
+        std::sort(index.begin(), index.end(), [this](int a, int b) { return strcmp(&doc[a], &doc[b]) < 0; });
+        sorted = true;
+    }
+
     int StringManager::searchNearestIndex(const char *str) const {
+        if (!sorted) sort();
         int ini(0), end(int(index.size()));
         while (end > ini) {
             int mid((ini + end) >> 1);
@@ -42,6 +151,7 @@ namespace webui {
     }
 
     int StringManager::searchNearestIndex(const char* str, int nStr) const {
+        if (!sorted) sort();
         int ini(0), end(int(index.size()));
         while (end > ini) {
             int mid((ini + end) >> 1);
@@ -61,15 +171,13 @@ namespace webui {
     }
 
     StringId StringManager::search(const char *str) const {
-        int ini(searchNearestIndex(str));
-        return (ini < int(index.size()) && !strcmp(&doc[index[ini]], str)) ? index[ini] : -1;
+        return search(str, strlen(str));
     }
 
     StringId StringManager::search(const char* str, int nStr) const {
-        int ini(searchNearestIndex(str, nStr));
-        return (ini < int(index.size()) &&
-                !strncmp(&doc[index[ini]], str, nStr) &&
-                !doc[index[ini] + nStr]) ? index[ini] : -1;
+        auto h(hashString(str, nStr));
+        auto id(searchReservedWord(str, nStr, h));
+        return id != Identifier::InvalidId ? StringId(id) : StringId(table[findSlot(str, nStr, h)]);
     }
 
     StringId StringManager::searchPrefix(const char *str) const {
@@ -79,9 +187,11 @@ namespace webui {
 
     void StringManager::dump() const {
         LOG("size of doc: %8zu", doc.size());
-        LOG("# strings:   %8zu", index.size());
+        LOG("# strings:   %8d", nStrings);
+        LOG("hash slots:  %8zu", table.size());
+        if (!sorted) sort();
         for (auto i: index)
-            LOG("\t%8d {%s}", i, &doc[index[i]]);
+            LOG("\t%8d {%s}", i, &doc[i]);
     }
 
 }
@@ -9,6 +9,8 @@
 #pragma once
 
 #include <vector>
+#include <unordered_map>
+#include <cstdint>
 #include "reserved_words.h"
 
 namespace webui {
@@ -22,6 +24,7 @@ namespace webui {
         inline bool valid() const { return id >= 0; }
         inline std::size_t operator()(StringId id) const { return std::size_t(id.getId()); }
         inline bool operator==(StringId rhs) const { return id == rhs.id; }
+        inline bool operator!=(StringId rhs) const { return id != rhs.id; }
         inline bool operator>=(StringId rhs) const { return id >= rhs.id; }
         inline bool operator<=(StringId rhs) const { return id <= rhs.id; }
 
@@ -33,29 +36,77 @@ namespace webui {
         // string storage
         std::vector<char> doc;
 
-        // index to strings in doc (so that strings are sorted)
-        std::vector<int> index;
+        // open addressing hash index to strings in doc (power of two size, -1 for empty slots)
+        std::vector<int> table;
+        std::vector<uint32_t> hashes;      // hash of the string in each slot
+        int nStrings;
+        int nReserved;                     // reserved words at the beginning of doc (not in the hash index)
+
+        // released strings: room in doc reused by strings of the same size
+        std::unordered_map<int, std::vector<int>> freeBySize;
+        std::vector<bool> marks;
+        int deadBytes;
+
+        // diagnostics: strings released by the last sweep are poisoned and their room is not reused until the
+        // next one, so that a stale id is reported by get() instead of aliasing a new string
+        enum { Poison = 0x7f };
+#ifndef DISABLE_DIAGNOSTICS
+        std::vector<std::pair<int, int>> quarantine; // offset, size
+        const char* released(StringId id) const;
+#endif
+
+        // index to strings in doc so that strings are sorted (only for nearest / prefix searches)
+        mutable std::vector<int> index;
+        mutable bool sorted;
+
+        int findSlot(const char* str, int nStr, uint32_t h) const;
+        void grow();
+        void sort() const;
 
         int searchNearestIndex(const char* str) const;
         int searchNearestIndex(const char* str, int nStr) const;
 
     public:
+        StringManager();
+
         // get closest even if there's no match
+        // O(log(N)), sorting strings after any addition
         StringId searchNearest(const char* str) const;
         StringId searchNearest(const char* str, int nStr) const;
 
         // returns index of string or -1 if string not in pool
-        // O(log(N)
-        // in the case of prefix string, searched string must start by prefix
+        // O(1)
         StringId search(const char* str) const;
         StringId search(const char* str, int nStr) const;
+        // in the case of prefix string, searched string must start by prefix
+        // O(log(N)), sorting strings after any addition
         StringId searchPrefix(const char* prefix) const;
 
         // returns index of newly created string or the index of existing replica
         StringId add(const char* str, int nStr = -1);
 
+        // reclamation: strings not marked between beginMark() and sweep() are released (reserved words are
+        // never released); their ids can be returned by add() for new strings afterwards (one sweep later in
+        // diagnostics builds)
+        void beginMark();
+        inline void mark(StringId id) {
+            int i(int(id.getId()));
+            if (i >= nReserved && i < int(marks.size())) marks[i] = true;
+        }
+        void sweep();
+
+        // statistics (bytes of not reserved strings)
+        inline int getLiveBytes() const { return int(doc.size()) - nReserved - deadBytes; }
+        inline int getDeadBytes() const { return deadBytes; }
+
         // returns the string by doc index or NULL if index==-1
-        inline const char* get(StringId id) const { return id.getId() == Identifier::InvalidId ? nullptr : &doc[int(id.getId())]; }
+        inline const char* get(StringId id) const {
+            if (id.getId() == Identifier::InvalidId) return nullptr;
+#ifndef DISABLE_DIAGNOSTICS
+            if (doc[int(id.getId())] == Poison) return released(id);
+#endif
+            return &doc[int(id.getId())];
+        }
         inline const char* get(Identifier id) const { return get(StringId(int(id))); }
 
         // debug
@@ -9,6 +9,10 @@
 #include "type_widget.h"
 #include "context.h"
 #include "string_manager.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
 
 namespace webui {
 
@@ -52,13 +56,44 @@ namespace webui {
             return buffer;
         });
 
+    TypeWidget::TypeWidget(Identifier type, int size, initializer_list<Entry> properties):
+        type(type), size(size), props(properties), base(nullptr), planned(false) {
+        sort(props.begin(), props.end(), [](const Entry& a, const Entry& b) { return a.id < b.id; });
+    }
+
+    void TypeWidget::inherit(const TypeWidget& base_) {
+        base = &base_;
+        planned = false;
+    }
+
+    bool TypeWidget::add(Identifier id, Property prop) {
+        if (find(id)) return false;
+        auto it(lower_bound(props.begin(), props.end(), id, [](const Entry& e, Identifier id) { return e.id < id; }));
+        props.insert(it, Entry{ id, prop });
+        planned = false;
+        return true;
+    }
+
+    const Property* TypeWidget::find(Identifier id) const {
+        for (auto* t = this; t; t = t->base) {
+            // binary search in a few entries
+            int i(0), j(int(t->props.size()));
+            while (i < j) {
+                int m((i + j) >> 1);
+                if (t->props[m].id < id) i = m + 1; else j = m;
+            }
+            if (i < int(t->props.size()) && t->props[i].id == id) return &t->props[i].prop;
+        }
+        return nullptr;
+    }
+
     long TypeWidget::get(StringId id, const void* data) const {
-        auto it(find(Identifier(id.getId())));
-        if (it == end()) {
+        auto* p(find(Identifier(id.getId())));
+        if (!p) {
             LOG("unknown property in get");
             return 0;
         }
-        const auto& prop(it->second);
+        const auto& prop(*p);
         switch (prop.size) {
         case 0: return unsigned((reinterpret_cast<const uint8_t *>(data)[prop.pos] >> prop.bit) & 1);
         case 1: return unsigned( reinterpret_cast<const uint8_t *>(data)[prop.pos]);
@@ -70,12 +105,12 @@ namespace webui {
     }
 
     void TypeWidget::set(StringId id, void* data, long value) const {
-        auto it(find(Identifier(id.getId())));
-        if (it == end()) {
+        auto* p(find(Identifier(id.getId())));
+        if (!p) {
             LOG("unknown property in set");
             return;
         }
-        const auto& prop(it->second);
+        const auto& prop(*p);
         if (prop.type == Type::Text) {
             reinterpret_cast<char**>(data)[prop.pos] = value ? strdup(*reinterpret_cast<char**>(&value)) : nullptr;
         } else {
@@ -96,14 +131,52 @@ namespace webui {
         }
     }
 
+    void TypeWidget::plan() const {
+        copies.clear();
+        texts.clear();
+        stringIds.clear();
+        for (auto* t = this; t; t = t->base)
+            for (const auto& entry: t->props) {
+                const auto& prop(entry.prop);
+                if (find(entry.id) != &prop) continue; // shadowed
+                uint16_t offset(prop.pos * max(int(prop.size), 1));
+                if (prop.type == Type::Text) texts.push_back(offset);
+                if (prop.type == Type::Id || prop.type == Type::StrId) stringIds.push_back(offset);
+                if (prop.redundant) continue;
+                // same semantic as get / set
+                Copy copy{ offset, uint16_t(prop.size), 0, Type::Unknown };
+                if (prop.type == Type::Text || prop.type == Type::Parser)
+                    copy.type = prop.type;
+                else if (!prop.size) {
+                    copy.type = Type::Bit;
+                    copy.size = 1;
+                    copy.mask = 1 << prop.bit;
+                }
+                copies.push_back(copy);
+            }
+        // merge contiguous raw copies
+        sort(copies.begin(), copies.end(), [](const Copy& a, const Copy& b) { return a.offset < b.offset; });
+        size_t n(0);
+        for (const auto& copy: copies) {
+            auto* prev(n ? &copies[n - 1] : nullptr);
+            if (prev && prev->type == Type::Unknown && copy.type == Type::Unknown && copy.offset <= prev->offset + prev->size)
+                prev->size = max(int(prev->size), copy.offset + copy.size - prev->offset);
+            else
+                copies[n++] = copy;
+        }
+        copies.resize(n);
+        planned = true;
+    }
+
     DIAG(void TypeWidget::dump(int indent, const void* widget) const {
             char buffer[1024];
-            for (const auto& idProp: *this) {
-                const auto& prop(idProp.second);
-                LOG("%*s%-20s: %-16s %4d %2d  " GREEN "%s" RESET,
-                    indent, "", Context::strMng.get(idProp.first), toString(prop.type), prop.pos * prop.size, prop.size,
-                    toString(prop.type, (uint8_t*)widget + prop.pos * prop.size, buffer, sizeof(buffer)));
-            }
+            for (auto* t = this; t; t = t->base)
+                for (const auto& entry: t->props) {
+                    const auto& prop(entry.prop);
+                    LOG("%*s%-20s: %-16s %4d %2d  " GREEN "%s" RESET,
+                        indent, "", Context::strMng.get(entry.id), toString(prop.type), prop.pos * prop.size, prop.size,
+                        toString(prop.type, (uint8_t*)widget + prop.pos * prop.size, buffer, sizeof(buffer)));
+                }
         });
 
 }
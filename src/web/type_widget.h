@@ -10,7 +10,8 @@
 
 #include "compatibility.h"
 #include "reserved_words.h"
-#include <unordered_map>
+#include <vector>
+#include <initializer_list>
 
 #define PROP(class, member, type, size, bit, redundant) \
     uint32_t(int(Type::type) | size << 8 | bit << 12 | redundant << 15 | uint16_t(long(&((class*)nullptr)->member) / size) << 16)
@@ -57,20 +58,59 @@ namespace webui {
         };
     };
 
-    class TypeWidget: public std::unordered_map<Identifier, Property> {
+    // immutable property table of a widget type: own properties sorted by id in a flat array, inherited ones
+    // shared through the base type
+    class TypeWidget {
     public:
-        using Map = std::unordered_map<Identifier, Property>;
+        struct Entry {
+            Identifier id;
+            Property prop;
+        };
 
-        TypeWidget(Identifier type, int size, const Map& properties): Map(properties), type(type), size(size) { }
+        TypeWidget(Identifier type, int size, std::initializer_list<Entry> properties);
 
         Identifier type;
         int size;
 
+        // building the type
+        void inherit(const TypeWidget& base);
+        bool add(Identifier id, Property prop); // false if already defined (the first definition is kept)
+
+        // lookup (own properties first, then base ones); nullptr if not found
+        const Property* find(Identifier id) const;
+
         // generic interface
         long get(StringId id, const void* data) const;
         void set(StringId id, void* data, long value) const;
 
+        // flat copy program of the non-redundant properties of the whole hierarchy (see Widget::copyFrom)
+        struct Copy {
+            uint16_t offset;
+            uint16_t size;       // bytes
+            uint8_t mask;        // bit properties
+            Type type;           // Unknown for raw bytes (contiguous ones merged), Bit, Text or Parser
+        };
+        inline const std::vector<Copy>& getCopies() const { if (!planned) plan(); return copies; }
+        inline const std::vector<uint16_t>& getTexts() const { if (!planned) plan(); return texts; }
+        inline const std::vector<uint16_t>& getStringIds() const { if (!planned) plan(); return stringIds; }
+
+        // own properties and base type (inherited ones)
+        inline const std::vector<Entry>& getProperties() const { return props; }
+        inline const TypeWidget* getBase() const { return base; }
+
         DIAG(void dump(int indent, const void* widget) const);
+
+    private:
+        std::vector<Entry> props;
+        const TypeWidget* base;
+
+        // built on first use
+        mutable bool planned;
+        mutable std::vector<Copy> copies;
+        mutable std::vector<uint16_t> texts; // offsets of text properties (owned by the widget)
+        mutable std::vector<uint16_t> stringIds; // offsets of Id and StrId properties
+
+        void plan() const;
     };
 
 }
@@ -163,6 +163,19 @@ namespace webui {
             if (b.pos.x + b.size.x < pos.x + size.x) size.x = b.pos.x + b.size.x - pos.x;
             if (b.pos.y + b.size.y < pos.y + size.y) size.y = b.pos.y + b.size.y - pos.y;
         }
+        void merge(Box b) {
+            if (b.pos.x + b.size.x > pos.x + size.x) size.x = b.pos.x + b.size.x - pos.x;
+            if (b.pos.y + b.size.y > pos.y + size.y) size.y = b.pos.y + b.size.y - pos.y;
+            if (b.pos.x < pos.x) { size.x += pos.x - b.pos.x; pos.x = b.pos.x; }
+            if (b.pos.y < pos.y) { size.y += pos.y - b.pos.y; pos.y = b.pos.y; }
+        }
+        inline bool overlaps(const Box& b) const {
+            return pos.x < b.pos.x + b.size.x && b.pos.x < pos.x + size.x && pos.y < b.pos.y + b.size.y && b.pos.y < pos.y + size.y;
+        }
+        inline bool contains(const Box& b) const {
+            return pos.x <= b.pos.x && pos.y <= b.pos.y && b.pos.x + b.size.x <= pos.x + size.x && b.pos.y + b.size.y <= pos.y + size.y;
+        }
+        inline bool empty() const { return size.x <= 0 || size.y <= 0; }
         inline bool operator==(const Box& b) const { return x0 == b.x0 && y0 == b.y0 && x1 == b.x1 && y1 == b.y1; }
         inline C& operator[](int i) { return v[i]; }
         inline C operator[](int i) const { return v[i]; }
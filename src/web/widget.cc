@@ -10,16 +10,19 @@
 #include "input.h"
 #include "nanovg.h"
 #include "context.h"
+#include "display_list.h"
 #include <cassert>
 #include <cstdlib>
 #include <cstddef>
+#include <cstring>
 
 using namespace std;
 using namespace webui;
 
 namespace {
 
-    TypeWidget widgetType = {
+    // built-in types are never destroyed (widgets can be destroyed after static objects at exit)
+    TypeWidget& widgetType = *new TypeWidget {
         Identifier::Widget, sizeof(Widget), {
             { Identifier::x,              PROP(Widget, box.pos.x,  Float,        4, 0, 0) },
             { Identifier::y,              PROP(Widget, box.pos.y,  Float,        4, 0, 0) },
@@ -43,26 +46,57 @@ namespace {
         }
     };
 
+    // live widgets by handle slot and their serials (0: free slot)
+    struct Handles {
+        vector<Widget*> widgets;
+        vector<uint32_t> serials;
+        vector<uint32_t> free;
+        uint32_t serial = 0;
+    };
+    Handles& handles = *new Handles;
+
 }
 
 namespace webui {
 
     Widget::Widget(Widget* parent): size { SizeRelative(100.0f, true), SizeRelative(100.0f, true) }, parent(parent),
-                                    all(0x00ff4009), actions(0) {
+                                    all(0x00ff4009), actions(0), displayList(nullptr) {
         typeWidget = &widgetType;
+        setLayoutDirty();
+        if (handles.free.empty()) {
+            handle.slot = handles.widgets.size();
+            handles.widgets.push_back(nullptr);
+            handles.serials.push_back(0);
+        } else {
+            handle.slot = handles.free.back();
+            handles.free.pop_back();
+        }
+        if (!++handles.serial) handles.serial++;
+        handle.serial = handles.serial;
+        handles.widgets[handle.slot] = this;
+        handles.serials[handle.slot] = handle.serial;
     }
 
     Widget::~Widget() {
         // free text properties
-        for (auto& prop: *typeWidget)
-            if (prop.second.type == Type::Text)
-                free(reinterpret_cast<char**>(this)[prop.second.pos]);
+        for (auto offset: typeWidget->getTexts())
+            free(*reinterpret_cast<char**>(reinterpret_cast<char*>(this) + offset));
+        delete displayList;
+        // caches holding this widget do not resolve any more
+        handles.widgets[handle.slot] = nullptr;
+        handles.serials[handle.slot] = 0;
+        handles.free.push_back(handle.slot);
     }
 
     TypeWidget& Widget::getType() {
         return widgetType;
     }
 
+    Widget* Widget::fromHandle(Handle handle) {
+        return handle.slot < handles.serials.size() && handle.serial && handles.serials[handle.slot] == handle.serial ?
+            handles.widgets[handle.slot] : nullptr;
+    }
+
     void Widget::render(int alphaMult) {
         renderChildren(renderBase(alphaMult));
     }
@@ -71,13 +105,26 @@ namespace webui {
         alphaMult = Context::render.multAlpha(alphaMult, alpha);
 
         const auto& actionTable(Context::app.getActionTable(actions));
-        if (actionTable.onRenderActive && (active || (Input::mouseButtonWidget == this && inside)))
-            Context::actions.execute(actionTable.onRenderActive, this);
-        else
-            Context::actions.execute(actionTable.onRender, this);
+        int iAction(actionTable.onRenderActive && (active || (Input::mouseButtonWidget == this && inside)) ?
+                    actionTable.onRenderActive : actionTable.onRender);
+        renderAction(iAction, alphaMult);
         return alphaMult;
     }
 
+    void Widget::renderAction(int iAction, int alphaMult) {
+        if (!iAction) return;
+        if (!displayList) displayList = new DisplayList;
+        auto& render(Context::render);
+        if (render.isDamagePass())
+            displayList->damage(iAction, this, alphaMult);
+        else {
+            // out of the damaged region, what was painted is kept
+            if (!render.isClipped() || box.overlaps(render.getClip()) || !displayList->valid(iAction, this))
+                displayList->render(iAction, this);
+            displayList->setPainted(this, alphaMult);
+        }
+    }
+
     void Widget::renderChildren(int alphaMult) {
         if (alphaMult)
             for (auto* child: children) child->render(alphaMult);
@@ -102,11 +149,26 @@ namespace webui {
     }
 
     bool Widget::layout(const Box4f& boxAvail) {
+        if (!layoutDirty && box == boxAvail) return true;
         bool stable(true);
         box = boxAvail;
         if (visible)
             for (auto* child: children) stable &= child->layout(box); //curPos, child->getSizeTarget(curSize));
-        return animeAlpha() && stable;
+        stable = animeAlpha() && stable;
+        layoutDirty = !stable;
+        return stable;
+    }
+
+    void Widget::setLayoutDirty() {
+        layoutDirty = 1;
+        for (auto* w = parent; w; w = w->parent) w->layoutDirty = w->childrenDirty = 1;
+    }
+
+    bool Widget::updateChildren() {
+        bool executed(false);
+        for (auto* child: children)
+            executed |= child->update();
+        return executed;
     }
 
     bool Widget::setData(int iTpl, int fTpl) {
@@ -119,24 +181,31 @@ namespace webui {
     }
 
     const Property* Widget::getProp(StringId id) const {
-        auto it(typeWidget->find(Identifier(id.getId())));
-        if (it == typeWidget->end()) return nullptr;
-        return &it->second;
+        return typeWidget->find(Identifier(id.getId()));
     }
 
     void Widget::copyFrom(const Widget* widget) {
-        const auto& props = *typeWidget;
-        for (const auto& prop: props)
-            if (!prop.second.redundant) {
-                if (prop.second.type == Type::Parser) {
-                    auto* parserWidget(reinterpret_cast<MLParser*>((char*)widget + prop.second.pos));
-                    auto* parser(reinterpret_cast<MLParser*>((char*)this + prop.second.pos));
-                    parserWidget->copyTo(*parser, 0, parserWidget->size());
-                } else
-                    props.set(prop.first, this, props.get(prop.first, widget));
+        for (const auto& copy: typeWidget->getCopies()) {
+            const char* src(reinterpret_cast<const char*>(widget) + copy.offset);
+            char* dst(reinterpret_cast<char*>(this) + copy.offset);
+            switch (copy.type) {
+            case Type::Parser: {
+                auto* parserWidget(reinterpret_cast<const MLParser*>(src));
+                parserWidget->copyTo(*reinterpret_cast<MLParser*>(dst), parserWidget->firstEntry(), parserWidget->size());
+                break;
+            }
+            case Type::Text: {
+                auto* text(*reinterpret_cast<char* const*>(src));
+                *reinterpret_cast<char**>(dst) = text ? strdup(text) : nullptr;
+                break;
+            }
+            case Type::Bit:    *dst = (*dst & ~copy.mask) | (*src & copy.mask); break;
+            default:           memcpy(dst, src, copy.size); break;
             }
+        }
         actions = widget->actions;
         sharedActions = 1;
+        setLayoutDirty();
         // copy also children
         for (auto child: widget->children) {
             auto* c(Context::app.createWidget(child->type(), this));
@@ -179,13 +248,23 @@ namespace webui {
                 recurse = true;
             }
         }
-        if (recurse)
-            for (auto* child: children)
-                executed |= child->update();
+        if (recurse) executed |= updateChildren();
 
         // specific input actions
-        if (inside && (Input::mouseButtonAction || Input::keyboardAction || Input::scrollAction)) executed |= input();
+        if (inside && (Input::mouseButtonAction || Input::keyboardAction || Input::scrollAction) && input()) {
+            executed = true;
+            setLayoutDirty(); // scroll, drag & drop
+        }
+
+        return executed;
+    }
 
+    bool Widget::leave() {
+        if (!inside) return false;
+        inside = 0;
+        bool executed(Context::actions.executeOrEmpty(Context::app.getActionTable(actions).onLeave, this));
+        for (auto* child: children)
+            executed |= child->leave();
         return executed;
     }
 
@@ -20,9 +20,16 @@
 namespace webui {
 
     struct Property;
+    class DisplayList;
 
     class Widget {
     public:
+        // reference that outlives the widget (caches of actions and display lists): resolves to null once the
+        // widget is destroyed, even if another widget takes its memory
+        struct Handle {
+            uint32_t slot, serial;
+        };
+
         Widget(Widget* parent);
         virtual ~Widget();
 
@@ -43,9 +50,11 @@ namespace webui {
         virtual bool layout(const Box4f& box);    // returns true if stable
         virtual bool setData(int iTpl, int fTpl); // returns true if ok
         virtual const char* queryParams(char* buffer, int nBuffer);
+        virtual bool updateChildren();            // returns true if actions were executed
 
         // render utils
         int renderBase(int alphaMult);
+        void renderAction(int iAction, int alphaMult); // renders or damage-checks (damage pass) an action
         void renderChildren(int alphaMult);
 
         // get a property or null
@@ -56,9 +65,12 @@ namespace webui {
 
         // update widget status
         bool update(); // returns true if actions were executed (affecting application)
+        bool leave();  // cursor is not inside any more (without checking the box)
 
         // getters
         inline const StringId getId() const { return id; }
+        inline Handle getHandle() const { return handle; }
+        static Widget* fromHandle(Handle handle); // null if destroyed
         inline V2s getSizeTarget(V2s s) const { return V2s(size[0].get(s.x), size[1].get(s.y)); }
         inline bool isVisible() const { return visible; }
         inline bool isSharingActions() const { return sharedActions; }
@@ -67,8 +79,12 @@ namespace webui {
 
         // setters
         inline void setId(StringId id_) { id = id_; }
-        inline void setVisible(bool v) { visible = v; }
-        inline void toggleVisible() { visible ^= 1; }
+        inline void setVisible(bool v) { visible = v; setLayoutDirty(); }
+        inline void toggleVisible() { visible ^= 1; setLayoutDirty(); }
+
+        // layout is recalculated for dirty widgets; marks also the ancestors as their layout depends on it
+        void setLayoutDirty();
+        inline bool isLayoutDirty() const { return layoutDirty; }
 
         // utils
         void translate(V2f t);
@@ -107,10 +123,14 @@ namespace webui {
                 uint8_t zoom;
                 uint8_t alpha;
                 uint8_t scrollable:1;     // if widget (mostly layouts) declares that content can be scrolled around
-                uint8_t reserved:7;
+                uint8_t layoutDirty:1;    // layout has to be recalculated (changed or not stable)
+                uint8_t childrenDirty:1;  // some descendant has been marked as layout dirty
+                uint8_t reserved:5;
             };
         };
         int actions;
+        DisplayList* displayList; // render action recorded
+        Handle handle;
     };
 
 }
@@ -18,7 +18,7 @@ using namespace webui;
 
 namespace {
 
-    TypeWidget widgetApplicationType = {
+    TypeWidget& widgetApplicationType = *new TypeWidget {
         Identifier::Application, sizeof(WidgetApplication), {
             { Identifier::background,     PROP(WidgetApplication, background, Color,        4, 0, 0) },
             { Identifier::mouseX,         PROP(WidgetApplication, cursor.x,   Float,        4, 0, 0) },
@@ -42,11 +42,13 @@ namespace webui {
 
     void WidgetApplication::render(int alphaMult) {
         assert(visible);
-        glClearColor(background.rf(), background.gf(), background.bf(), background.af());
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+        if (!Context::render.isDamagePass())
+            Context::render.clear(background);
+        else if (background.rgba() != Context::render.getClearColor().rgba())
+            Context::render.damageAll();
 
         const auto& actionTable(Context::app.getActionTable(actions));
-        Context::actions.execute(actionTable.onRender, this);
+        renderAction(actionTable.onRender, alphaMult);
 
         // visibility of layouts
         Context::renderVisibilityBox.pos.assign(0, 0);
@@ -12,21 +12,23 @@
 #include "context.h"
 #include "type_widget.h"
 #include <cmath>
+#include <algorithm>
 
 using namespace std;
 using namespace webui;
 
 namespace {
 
-    TypeWidget widgetLayoutHorType = {
+    TypeWidget& widgetLayoutHorType = *new TypeWidget {
         Identifier::LayoutHor, sizeof(WidgetLayout), { }
     };
 
-    TypeWidget widgetLayoutVerType = {
+    TypeWidget& widgetLayoutVerType = *new TypeWidget {
         Identifier::LayoutVer, sizeof(WidgetLayout), {
             { Identifier::margin,         PROP(WidgetLayout, margin,     Float,        4, 0, 0) },
             { Identifier::size,           PROP(WidgetLayout, cyclicSize, Int32,        4, 0, 0) },
             { Identifier::last,           PROP(WidgetLayout, cyclicLast, Int32,        4, 0, 0) },
+            { Identifier::overscan,       PROP(WidgetLayout, overscan,   Float,        4, 0, 0) },
         }
     };
 
@@ -35,8 +37,9 @@ namespace {
 namespace webui {
 
     WidgetLayout::WidgetLayout(Widget* parent, int coord):
-        Widget(parent), margin(0), cyclicSize(0), cyclicLast(0),
-        scrolling(false), coord(coord), positionTarget(1e10f), dragDrop(nullptr) {
+        Widget(parent), margin(0), cyclicSize(0), cyclicLast(0), overscan(-1.0f),
+        scrolling(false), coord(coord), positionTarget(1e10f), dragDrop(nullptr), rowAvail(-1.0f),
+        first(0), last(0), insideChild(nullptr), insideIdx(0) {
         typeWidget = coord ? &widgetLayoutVerType : &widgetLayoutHorType;
     }
 
@@ -56,14 +59,15 @@ namespace webui {
             Context::renderVisibilityBox.intersect(box);
 
             float maxCoord(Context::renderVisibilityBox.pos[coord] + Context::renderVisibilityBox.size[coord]);
-            size_t cyclic(cyclicLast & ((1 << cyclicSize) - 1)/*mask*/); // cyclic arrangements
-            for (size_t i = 0; i < children.size(); i++, cyclic++) {
-                if (cyclic >= children.size()) cyclic -= children.size();
-                auto child(children[cyclic]);
+            size_t n(lastArranged());
+            for (size_t i = findArranged(Context::renderVisibilityBox.pos[coord], first, n); i < n; i++) {
+                auto child(arranged(i));
                 if (child->box.pos[coord] >= maxCoord) break;
                 child->render(alphaMult);
             }
-            if (dragDrop) {
+            if (dragDrop && Context::render.isDamagePass())
+                Context::render.damageAll();
+            else if (dragDrop) {
                 alphaMult = Context::render.multAlpha(alphaMult, alpha);
                 dragDrop->translate(Input::cursor - Input::cursorLeftPress);
                 dragDrop->render(alphaMult >> 1);
@@ -105,7 +109,7 @@ namespace webui {
 
         // drag & drop
         if (Input::mouseButtonWidget && Input::cursorLeftPress.manhatan(Input::cursor) > 16) {
-            if (draggable && !dragDrop) {
+            if (draggable && !dragDrop && !isVirtual()) {
                 // check if clicked in one of layout widgets
                 for (size_t idx = 0; idx < children.size(); idx++)
                     if (children[idx] == Input::mouseButtonWidget) {
@@ -124,69 +128,16 @@ namespace webui {
     }
 
     bool WidgetLayout::layout(const Box4f& boxAvail) {
+        if (!layoutDirty && box == boxAvail) return true;
         bool stable(true);
         box = boxAvail;
         if (visible && box.size[coord] >= 0) {
             // margin (only once)
             if (positionTarget == 1e10f) position = positionTarget = margin;
             int coord2(coord ^ 1);
-            // drag & drop
-            float prevCoord(0);
-            if (dragDrop) {
-                // remove from list
-                for (size_t idx = 0; idx < children.size(); idx++)
-                    if (children[idx] == dragDrop)
-                        children.erase(children.begin() + idx);
-                // find position
-                float midCoord(dragDrop->box.pos[coord] + (dragDrop->box.size[coord] * 0.5f) + Input::cursor[coord] - Input::cursorLeftPress[coord]);
-                float last(numeric_limits<float>::min());
-                size_t pos(children.size());
-                for (size_t idx = 0; idx < children.size(); idx++) {
-                    auto* child(children[idx]);
-                    float mid(child->box.pos[coord] + (child->box.size[coord] * 0.5f));
-                    if (midCoord >= last && midCoord < mid) {
-                        pos = idx;
-                        break;
-                    }
-                    last = mid;
-                }
-                // add it in correct position
-                children.insert(children.begin() + pos, dragDrop);
-                prevCoord = dragDrop->box.pos[coord];
-            }
+            float requiredSize(isVirtual() ? layoutVirtual(boxAvail, stable) : layoutAll(boxAvail, stable));
 
-            // use linear arrangement util
-            LinearArrangement<float>::Elem elems[children.size() + 1];
-            LinearArrangement<float> la(elems, boxAvail.pos[coord] + position);
-            size_t cyclic(cyclicLast & ((1 << cyclicSize) - 1)/*mask*/); // cyclic arrangements
-            for (size_t i = 0; i < children.size(); i++, cyclic++) {
-                if (cyclic >= children.size()) cyclic -= children.size();
-                auto child(children[cyclic]);
-                if (child->isVisible())
-                    la.add(child->box.size[coord], child->size[coord].get(boxAvail.size[coord]), child->size[coord].relative);
-                else
-                    la.add(child->box.size[coord], 0, true);
-            }
-            stable = la.calculate(boxAvail.size[coord]);
-
-            float lastCoord(la.get(0));
-            for (size_t idx = 0; idx < children.size(); idx++, cyclic++) {
-                if (cyclic >= children.size()) cyclic -= children.size();
-                auto* child(children[cyclic]);
-                Box4f b;
-                float newCoord = la.get(idx + 1);
-                // calculate children box
-                b.pos[coord]   = lastCoord;
-                b.pos[coord2]  = box.pos[coord2];
-                b.size[coord]  = newCoord - lastCoord;
-                b.size[coord2] = child->size[coord2].get(box.size[coord2]);
-                lastCoord      = newCoord;
-
-                // recurse layout
-                stable &= child->layout(b);
-            }
             // adaptative size
-            float requiredSize(elems[children.size()].posTarget - elems[0].posTarget);
             if (size[coord].adapt) {
                 size[coord].size = requiredSize; // total space required
                 scrollable = 0;
@@ -209,18 +160,147 @@ namespace webui {
                 }
             }
             if (size[coord2].adapt) {
-                if (children.empty())
+                if (first >= last)
                     size[coord2].size = 0;
                 else
-                    size[coord2].size = children[0]->box.size[coord2]; // TODO: take max of all children?
+                    size[coord2].size = arranged(first)->box.size[coord2]; // TODO: take max of all children?
                 if (size[coord2].size != box.size[coord2]) stable = false;
             }
+        }
+        stable = animeAlpha() && stable;
+        layoutDirty = !stable;
+        return stable;
+    }
+
+    float WidgetLayout::layoutAll(const Box4f& boxAvail, bool& stable) {
+        int coord2(coord ^ 1);
+        // drag & drop
+        float prevCoord(0);
+        if (dragDrop) {
+            // remove from list
+            for (size_t idx = 0; idx < children.size(); idx++)
+                if (children[idx] == dragDrop)
+                    children.erase(children.begin() + idx);
+            // find position
+            float midCoord(dragDrop->box.pos[coord] + (dragDrop->box.size[coord] * 0.5f) + Input::cursor[coord] - Input::cursorLeftPress[coord]);
+            float last(numeric_limits<float>::min());
+            size_t pos(children.size());
+            for (size_t idx = 0; idx < children.size(); idx++) {
+                auto* child(children[idx]);
+                float mid(child->box.pos[coord] + (child->box.size[coord] * 0.5f));
+                if (midCoord >= last && midCoord < mid) {
+                    pos = idx;
+                    break;
+                }
+                last = mid;
+            }
+            // add it in correct position
+            children.insert(children.begin() + pos, dragDrop);
+            prevCoord = dragDrop->box.pos[coord];
+        }
+
+        // use linear arrangement util
+        elems.resize(children.size() + 1);
+        LinearArrangement<float> la(elems.data(), boxAvail.pos[coord] + position);
+        for (size_t i = 0; i < children.size(); i++) {
+            auto child(arranged(i));
+            if (child->isVisible())
+                la.add(child->box.size[coord], child->size[coord].get(boxAvail.size[coord]), child->size[coord].relative);
+            else
+                la.add(child->box.size[coord], 0, true);
+        }
+        stable &= la.calculate(boxAvail.size[coord]);
+
+        float lastCoord(la.get(0));
+        for (size_t idx = 0; idx < children.size(); idx++) {
+            auto* child(arranged(idx));
+            Box4f b;
+            float newCoord = la.get(idx + 1);
+            // calculate children box
+            b.pos[coord]   = lastCoord;
+            b.pos[coord2]  = box.pos[coord2];
+            b.size[coord]  = newCoord - lastCoord;
+            b.size[coord2] = child->size[coord2].get(box.size[coord2]);
+            lastCoord      = newCoord;
+
+            // recurse layout
+            stable &= child->layout(b);
+        }
+        first = 0;
+        last = children.size();
+
+        // drag & drop
+        if (dragDrop)
+            Input::cursorLeftPress[coord] += dragDrop->box.pos[coord] - prevCoord;
+        return elems[children.size()].posTarget - elems[0].posTarget;
+    }
+
+    float WidgetLayout::layoutVirtual(const Box4f& boxAvail, bool& stable) {
+        int coord2(coord ^ 1);
+        int n(children.size());
+
+        // row positions: only recalculated if children or available size changed
+        if (childrenDirty || rowPos.size() != size_t(n + 1) || rowAvail != boxAvail.size[coord]) {
+            rowPos.resize(n + 1);
+            rowPos[0] = 0.0f;
+            for (int i = 0; i < n; i++) {
+                auto* child(arranged(i));
+                rowPos[i + 1] = rowPos[i] + (child->isVisible() ? child->size[coord].get(boxAvail.size[coord]) : 0.0f);
+            }
+            rowAvail = boxAvail.size[coord];
+            childrenDirty = 0;
+        }
+
+        // visible part plus overscan
+        float from(-position - overscan), to(box.size[coord] - position + overscan);
+        first = max(int(upper_bound(rowPos.begin(), rowPos.end(), from) - rowPos.begin()) - 1, 0);
+        last = min(int(lower_bound(rowPos.begin(), rowPos.end(), to) - rowPos.begin()), n);
+
+        float base(boxAvail.pos[coord] + position);
+        for (int i = first; i < last; i++) {
+            auto* child(arranged(i));
+            Box4f b;
+            b.pos[coord]   = base + rowPos[i];
+            b.pos[coord2]  = box.pos[coord2];
+            b.size[coord]  = rowPos[i + 1] - rowPos[i];
+            b.size[coord2] = child->size[coord2].get(box.size[coord2]);
+            stable &= child->layout(b);
+        }
+        return rowPos[n];
+    }
+
+    bool WidgetLayout::updateChildren() {
+        bool executed(false);
+        if (insideChild && (insideIdx >= children.size() || children[insideIdx] != insideChild)) {
+            // children changed
+            insideChild = nullptr;
+            for (auto* child: children)
+                executed |= child->leave();
+        }
+
+        // only the child under the cursor and the one the cursor was inside
+        size_t n(lastArranged()), idx(findArranged(Input::cursor[coord], first, n));
+        Widget* child(idx < n ? arranged(idx) : nullptr);
+        if (child) executed |= child->update();
+        if (insideChild && insideChild != child) executed |= insideChild->leave();
+        insideChild = nullptr;
+        if (child && child->inside) {
+            insideChild = child;
+            insideIdx = childIndex(idx);
+        }
+        return executed;
+    }
 
-            // drag & drop
-            if (dragDrop)
-                Input::cursorLeftPress[coord] += dragDrop->box.pos[coord] - prevCoord;
+    size_t WidgetLayout::findArranged(float pos, size_t from, size_t to) const {
+        while (from < to) {
+            size_t mid((from + to) >> 1);
+            auto* child(arranged(mid));
+            if (child->box.pos[coord] + child->box.size[coord] <= pos)
+                from = mid + 1;
+            else
+                to = mid;
         }
-        return animeAlpha() && stable;
+        return from;
     }
 
     const char* WidgetLayout::queryParams(char* buffer, int nBuffer) {
@@ -8,8 +8,10 @@
 
 #pragma once
 
+#include "util.h"
 #include "types.h"
 #include "widget.h"
+#include <vector>
 
 namespace webui {
 
@@ -26,6 +28,13 @@ namespace webui {
         virtual bool input() final override; // returns true if actions were executed (affecting application)
         virtual bool layout(const Box4f& box) final override; // returns true if stable
         virtual const char* queryParams(char* buffer, int nBuffer) final override;
+        virtual bool updateChildren() final override;
+
+        // child about to be destroyed
+        inline void forget(const Widget* child) {
+            if (dragDrop == child) dragDrop = nullptr;
+            if (insideChild == child) insideChild = nullptr;
+        }
 
         float margin;         // amount of pixels before and after content
 
@@ -33,12 +42,42 @@ namespace webui {
         uint32_t cyclicSize;  // 0 means no incremental and no cyclic, otherwise, the circular buffer size as: 1 << cyclicSize
         uint32_t cyclicLast;  // last update received
 
+        // virtualized: only children in the visible part plus overscan pixels are laid out, rendered and
+        // updated (negative: all children)
+        float overscan;
+
     private:
         bool scrolling;
         int coord;
         float position;       // when scrollable (content bigger than widget size), position of content
         float positionTarget; // smoothly converge to definitive position
         Widget* dragDrop;
+
+        // not virtualized: arrangement of all children (reused between layouts)
+        std::vector<LinearArrangement<float>::Elem> elems;
+
+        // virtualized: cached row positions (not animated)
+        std::vector<float> rowPos;
+        float rowAvail;
+
+        // range of arranged children laid out and child with the cursor inside
+        int first, last;
+        Widget* insideChild;
+        size_t insideIdx;
+
+        // children are sorted along coord: arranged index of the first one in [from, to) ending after pos
+        size_t findArranged(float pos, size_t from, size_t to) const;
+
+        inline bool isVirtual() const { return overscan >= 0.0f; }
+        inline size_t childIndex(size_t idx) const { // index of the child at position idx of the (cyclic) arrangement
+            idx += cyclicLast & ((1 << cyclicSize) - 1);
+            if (idx >= children.size()) idx -= children.size();
+            return idx;
+        }
+        inline Widget* arranged(size_t idx) const { return children[childIndex(idx)]; }
+        inline size_t lastArranged() const { return std::min(size_t(last), children.size()); }
+        float layoutAll(const Box4f& boxAvail, bool& stable); // return required size
+        float layoutVirtual(const Box4f& boxAvail, bool& stable);
     };
 
 }
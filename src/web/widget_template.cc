@@ -14,7 +14,7 @@ using namespace webui;
 
 namespace {
 
-    TypeWidget widgetTemplateType = {
+    TypeWidget& widgetTemplateType = *new TypeWidget {
         Identifier::Template, sizeof(WidgetTemplate), {
             { Identifier::InvalidId,      PROP(WidgetTemplate, parser,  Parser,        1, 0, 0) },
         }
@@ -24,7 +24,7 @@ namespace {
 
 namespace webui {
 
-    WidgetTemplate::WidgetTemplate(Widget* parent): Widget(parent) {
+    WidgetTemplate::WidgetTemplate(Widget* parent): Widget(parent), seq(0), hash(0) {
         typeWidget = &widgetTemplateType;
     }
 
@@ -33,7 +33,11 @@ namespace webui {
     }
 
     bool WidgetTemplate::setData(int iTpl, int fTpl) {
-        return Context::app.updateTemplate(this, iTpl, fTpl);
+        // plain data restarts the patch sequence (and its hash, if any, is set by the caller once applied)
+        hash = 0;
+        if (!Context::app.updateTemplate(this, iTpl, fTpl)) return false;
+        seq = 0;
+        return true;
     }
 
 }
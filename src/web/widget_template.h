@@ -28,6 +28,8 @@ namespace webui {
 
     public:
         MLParser parser;
+        int seq;        // last template data patch applied (0 after plain data, -1 when out of sequence)
+        uint32_t hash;  // of the last plain data applied (0 after a patch): identical data is not applied again
     };
 
 }
@@ -15,7 +15,7 @@ using namespace webui;
 
 namespace {
 
-    TypeWidget widgetTimerType = {
+    TypeWidget& widgetTimerType = *new TypeWidget {
         Identifier::Timer, sizeof(WidgetTimer), {
             { Identifier::repeat,            PROP(WidgetTimer, repeat,  Uint8,        1, 0, 0) },
             { Identifier::delay,             PROP(WidgetTimer, delay,   Int32,        4, 0, 0) },
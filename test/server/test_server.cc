@@ -0,0 +1,134 @@
+/*  -*- mode: c++; coding: utf-8; c-file-style: "stroustrup"; -*-
+
+    Contributors: Asier Aguirre
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include "catch.hpp"
+#include "server.h"
+#include <chrono>
+#include <string>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+using namespace std;
+using namespace server;
+
+namespace {
+
+    const uint16_t Port(19091);
+    string docRoot;
+
+    void writeFile(const string& name, const string& content) {
+        FILE* f(fopen((docRoot + '/' + name).c_str(), "wb"));
+        REQUIRE(f);
+        fwrite(content.data(), 1, content.size(), f);
+        fclose(f);
+    }
+
+    // one request per connection: head (without the empty line) and body of the response
+    bool get(const char* path, const char* acceptEncoding, string& head, string& body) {
+        int fd(socket(AF_INET, SOCK_STREAM, 0));
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(Port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        timeval timeout{ 5, 0 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        string request("GET "s + path + " HTTP/1.1\r\nHost: localhost\r\n" +
+                       (acceptEncoding ? "Accept-Encoding: "s + acceptEncoding + "\r\n" : "") + "\r\n");
+        bool ok(!connect(fd, (sockaddr*)&addr, sizeof(addr)) &&
+                send(fd, request.data(), request.size(), MSG_NOSIGNAL) == int(request.size()));
+        string response;
+        size_t headEnd(string::npos), length(0);
+        char buffer[4096];
+        int n;
+        while (ok && (headEnd == string::npos || response.size() < headEnd + 4 + length) &&
+               (n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+            response.append(buffer, n);
+            if (headEnd == string::npos && (headEnd = response.find("\r\n\r\n")) != string::npos) {
+                string lower(response, 0, headEnd);
+                for (auto& c: lower) c = tolower(c);
+                auto pos(lower.find("content-length:"));
+                length = pos == string::npos ? 0 : atoi(lower.c_str() + pos + 15);
+            }
+        }
+        close(fd);
+        if (!ok || headEnd == string::npos) return false;
+        head = response.substr(0, headEnd + 2);
+        body = response.substr(headEnd + 4);
+        return body.size() == length;
+    }
+
+    void startServer() {
+        static bool started(false);
+        if (started) return;
+        char dir[] = "/tmp/nanoweb_server_XXXXXX";
+        REQUIRE(mkdtemp(dir));
+        docRoot = dir;
+        writeFile("doc.ml", "[ plain ]");
+        writeFile("doc.ml.gz", "\x1f\x8b gzip variant");
+        writeFile("both.ml", "[ plain ]");
+        writeFile("both.ml.gz", "\x1f\x8b gzip variant");
+        writeFile("both.ml.zz", "\x78\x9c deflate variant");
+        thread([]() { (new Server)->run(Port, docRoot); }).detach();
+        string head, body;
+        for (int i = 0; i < 100 && !get("/doc.ml", nullptr, head, body); i++)
+            this_thread::sleep_for(chrono::milliseconds(20));
+        started = true;
+    }
+
+}
+
+TEST_CASE("accept encoding quality", "[server]") {
+    CHECK(Server::encodingQuality("gzip, deflate", "gzip") == 1);
+    CHECK(Server::encodingQuality("deflate,gzip", "gzip") == 1);
+    CHECK(Server::encodingQuality("GZip; q=0.5", "gzip") == Approx(0.5));
+    CHECK(Server::encodingQuality("gzip;q=0, deflate", "gzip") == 0);
+    CHECK(Server::encodingQuality("gzip;q=0.000", "gzip") == 0);
+    CHECK(Server::encodingQuality("gzip;level=1;q=0.2", "gzip") == Approx(0.2));
+    CHECK(Server::encodingQuality("*;q=0.3, deflate;q=0", "gzip") == Approx(0.3));
+    CHECK(Server::encodingQuality("*;q=0.3, deflate;q=0", "deflate") == 0);
+    CHECK(Server::encodingQuality("gzip;q=0, *", "gzip") == 0);
+    CHECK(Server::encodingQuality("xgzip, gzip-old, identity", "gzip") == 0);
+    CHECK(Server::encodingQuality("", "gzip") == 0);
+    CHECK(Server::encodingQuality(" , ;q=1,", "gzip") == 0);
+}
+
+TEST_CASE("precompressed documents", "[server]") {
+    startServer();
+    string head, body;
+
+    // gzip sibling
+    REQUIRE(get("/doc.ml", "gzip, deflate", head, body));
+    CHECK(head.find("200 OK") != string::npos);
+    CHECK(head.find("\r\nContent-Encoding: gzip\r\n") != string::npos);
+    CHECK(head.find("\r\nVary: Accept-Encoding\r\n") != string::npos);
+    CHECK(body == "\x1f\x8b gzip variant");
+
+    // refused or not accepted: identity
+    REQUIRE(get("/doc.ml", "gzip;q=0, deflate", head, body));
+    CHECK(head.find("Content-Encoding") == string::npos);
+    CHECK(body == "[ plain ]");
+    REQUIRE(get("/doc.ml", nullptr, head, body));
+    CHECK(head.find("Content-Encoding") == string::npos);
+    CHECK(body == "[ plain ]");
+
+    // preferred variant
+    REQUIRE(get("/both.ml", "gzip;q=0.5, deflate", head, body));
+    CHECK(head.find("\r\nContent-Encoding: deflate\r\n") != string::npos);
+    CHECK(body == "\x78\x9c deflate variant");
+    REQUIRE(get("/both.ml", "deflate;q=0.5, gzip", head, body));
+    CHECK(head.find("\r\nContent-Encoding: gzip\r\n") != string::npos);
+    CHECK(body == "\x1f\x8b gzip variant");
+}
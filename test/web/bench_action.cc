@@ -0,0 +1,118 @@
+/*  -*- mode: c++; coding: utf-8; c-file-style: "stroustrup"; -*-
+
+    Contributors: Asier Aguirre
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include "action.h"
+#include "widget.h"
+#include "context.h"
+#include "application.h"
+#include "display_list.h"
+#include <chrono>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+using namespace webui;
+
+// microbenchmark of the action interpreter: executes onRender / onRenderActive programs of an application,
+// then renders frames with nothing, one widget or the whole window damaged
+// use: bench_action [<application.ml> [<rounds>]]
+
+namespace {
+
+    struct Program {
+        int iAction;
+        Widget* widget;
+    };
+
+    void collectPrograms(Widget* widget, vector<Program>& programs) {
+        if (widget->actions) {
+            const auto& table(Context::app.getActionTable(widget->actions));
+            if (table.onRender) programs.push_back(Program{ table.onRender, widget });
+            if (table.onRenderActive) programs.push_back(Program{ table.onRenderActive, widget });
+        }
+        for (auto* child: widget->getChildren())
+            collectPrograms(child, programs);
+    }
+
+    char* readFile(const char* path, int& n) {
+        FILE* f(fopen(path, "rb"));
+        if (!f) return nullptr;
+        fseek(f, 0, SEEK_END);
+        n = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        char* data((char*)malloc(n));
+        if (fread(data, 1, n, f) != size_t(n)) n = 0;
+        fclose(f);
+        return data;
+    }
+
+}
+
+int main(int argc, char* argv[]) {
+    const char* path(argc >= 2 ? argv[1] : "example/hello_world/application.ml");
+    int rounds(argc >= 3 ? atoi(argv[2]) : 20000);
+
+    int n(0);
+    char* data(readFile(path, n));
+    if (!data || !n) {
+        LOG("cannot read %s", path);
+        return 1;
+    }
+    ctx.initialize(DIAG(true, false));
+    if (!Context::app.onLoad(new RequestXHR(Identifier::Application, StringId(), data, n))) {
+        LOG("cannot load application %s", path);
+        return 1;
+    }
+    free(data);
+
+    vector<Program> programs;
+    collectPrograms(Context::app.getRoot(), programs);
+    LOG("%s: %d render programs, %d rounds", path, int(programs.size()), rounds);
+
+    // execute all programs once per round, as a frame would do
+    int64_t ns(0);
+    for (int r = 0; r < rounds; r++) {
+        Context::render.beginFrame();
+        auto t0(chrono::steady_clock::now());
+        for (const auto& program: programs)
+            if (!Context::actions.execute(program.iAction, program.widget)) {
+                LOG("error executing program %d", program.iAction);
+                return 1;
+            }
+        ns += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - t0).count();
+        Context::render.endFrame();
+    }
+    LOG("%.1f ns / program, %.3f ms / round",
+        double(ns) / (double(rounds) * programs.size()), double(ns) * 1e-6 / rounds);
+
+    // frames: layout, damage pass, display lists and render
+    int frames(rounds / 10);
+    for (int f = 0; f < 100000 && Context::app.render(); f++) ; // until animations settle
+    Widget* widget(nullptr); // a painted leaf widget
+    for (auto it = programs.rbegin(); !widget && it != programs.rend(); ++it)
+        if (it->widget->displayList) widget = it->widget;
+    if (!widget) {
+        LOG("no painted widget");
+        return 1;
+    }
+    for (int mode = 0; mode < 3; mode++) {
+        static const char* modes[] = { "idle", "one widget changed", "whole window" };
+        int rendered(0);
+        auto t0(chrono::steady_clock::now());
+        for (int f = 0; f < frames; f++) {
+            if (mode == 1) widget->displayList->invalidate();
+            if (mode == 2) Context::render.damageAll();
+            rendered += Context::app.render();
+        }
+        ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - t0).count();
+        LOG("%s: %.3f ms / frame, %d frames rendered, widgets replayed %d, executed %d (last frame)",
+            modes[mode], double(ns) * 1e-6 / frames, rendered, DisplayList::getReplayed(), DisplayList::getExecuted());
+    }
+    return 0;
+}
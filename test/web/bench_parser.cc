@@ -0,0 +1,109 @@
+/*  -*- mode: c++; coding: utf-8; c-file-style: "stroustrup"; -*-
+
+    Contributors: Asier Aguirre
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include "ml_parser.h"
+#include <chrono>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+using namespace std;
+using namespace webui;
+
+// parse throughput benchmark: generates a template response (list of rows with ids, numbers, strings and
+// colors) and an application-like document (indented objects with comments), and parses them repeatedly
+// use: bench_parser [<megabytes> [<rounds>]]
+
+namespace {
+
+    string generateTemplate(int bytes) {
+        string ml("[\n");
+        char buffer[256];
+        for (int i = 0; int(ml.size()) < bytes; i++) {
+            snprintf(buffer, sizeof(buffer),
+                     "  [ row_%d, %d, %d.%d, \"description of the element number %d in this list\", #%06x, %s ],\n",
+                     i, i * 7, i % 1000, i % 10, i, (i * 2654435761u) & 0xffffff, i & 1 ? "true" : "false");
+            ml += buffer;
+        }
+        ml += "  [ last ]\n]\n";
+        return ml;
+    }
+
+    string generateApplication(int bytes) {
+        string ml("Application {\n    id: app\n");
+        char buffer[512];
+        for (int i = 0; int(ml.size()) < bytes; i++) {
+            snprintf(buffer, sizeof(buffer),
+                     "    // row %d\n"
+                     "    LayoutHor {\n"
+                     "        id: layout_%d\n"
+                     "        height: 30\n"
+                     "        [\n"
+                     "            Widget {\n"
+                     "                id: label_%d\n"
+                     "                width: 120\n"
+                     "                background: #204060ff\n"
+                     "                text: 'label number %d'\n"
+                     "                onRender: roundedRect(x + 2, y + 2, w - 4, h - 4, 3)\n"
+                     "            }\n"
+                     "        ]\n"
+                     "    }\n", i, i, i, i);
+            ml += buffer;
+        }
+        ml += "}\n";
+        return ml;
+    }
+
+    bool bench(const char* name, const string& ml, int rounds) {
+        MLParser parser;
+        int64_t ns(0);
+        for (int r = 0; r < rounds; r++) {
+            auto t0(chrono::steady_clock::now());
+            if (!parser.parse(ml.data(), ml.size())) {
+                LOG("%s: parse error", name);
+                return false;
+            }
+            ns += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - t0).count();
+        }
+        LOG("%s: %.2f MB, %d entries, %.3f ms / parse, %.1f MB/s", name, ml.size() * 1e-6, parser.size(),
+            double(ns) * 1e-6 / rounds, double(ml.size()) * rounds * 1e3 / double(ns));
+
+        // incremental, as received from the network
+        const int chunk(16 * 1024);
+        ns = 0;
+        for (int r = 0; r < rounds; r++) {
+            auto t0(chrono::steady_clock::now());
+            parser.begin();
+            for (int i = 0; i < int(ml.size()); i += chunk)
+                if (!parser.feed(ml.data() + i, min(chunk, int(ml.size()) - i))) {
+                    LOG("%s: incremental parse error", name);
+                    return false;
+                }
+            if (!parser.end()) {
+                LOG("%s: incremental parse error", name);
+                return false;
+            }
+            ns += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - t0).count();
+        }
+        LOG("%s: %d KB chunks, %.3f ms / parse, %.1f MB/s", name, chunk / 1024,
+            double(ns) * 1e-6 / rounds, double(ml.size()) * rounds * 1e3 / double(ns));
+        return true;
+    }
+
+}
+
+int main(int argc, char* argv[]) {
+    double megabytes(argc >= 2 ? atof(argv[1]) : 4);
+    int rounds(argc >= 3 ? atoi(argv[2]) : 10);
+    int bytes(megabytes * 1e6);
+    if (!bench("template", generateTemplate(bytes), rounds) ||
+        !bench("application", generateApplication(bytes), rounds))
+        return 1;
+    return 0;
+}
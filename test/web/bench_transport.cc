@@ -0,0 +1,175 @@
+/*  -*- mode: c++; coding: utf-8; c-file-style: "stroustrup"; -*-
+
+    Contributors: Asier Aguirre
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include "context.h"
+#include "application.h"
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <zlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+using namespace std;
+using namespace webui;
+
+// compressed transport benchmark: serves a document root on a throttled local link, identity and gzip encoded
+// (compressed once, as precompressed files would be), and loads its application.ml with the desktop requests,
+// reporting bytes on the wire and time to the first frame and to the end of all requests
+// use: bench_transport [<document root> [<KB/s>]]
+
+namespace {
+
+    string docRoot("example/hello_world");
+    int bytesPerSecond(64 * 1024);
+    atomic<int> wireBytes(0);
+
+    bool readFile(const string& path, string& content) {
+        FILE* f(fopen(path.c_str(), "rb"));
+        if (!f) return false;
+        char buffer[4096];
+        size_t n;
+        content.clear();
+        while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+            content.append(buffer, n);
+        fclose(f);
+        return true;
+    }
+
+    string gzip(const string& content) {
+        z_stream zs;
+        memset(&zs, 0, sizeof(zs));
+        deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY); // gzip header
+        string out(deflateBound(&zs, content.size()) + 32, '\0');
+        zs.next_in = (Bytef*)content.data();
+        zs.avail_in = content.size();
+        zs.next_out = (Bytef*)&out[0];
+        zs.avail_out = out.size();
+        deflate(&zs, Z_FINISH);
+        out.resize(zs.total_out);
+        deflateEnd(&zs);
+        return out;
+    }
+
+    // sends at most bytesPerSecond, in 10 ms slices
+    void sendThrottled(int fd, const string& data) {
+        int slice(max(1, bytesPerSecond / 100));
+        for (size_t pos = 0; pos < data.size(); pos += slice) {
+            int n(min(size_t(slice), data.size() - pos));
+            if (send(fd, data.data() + pos, n, MSG_NOSIGNAL) != n) return;
+            wireBytes += n;
+            this_thread::sleep_for(chrono::milliseconds(10));
+        }
+    }
+
+    // one request per connection
+    void serve(int listenFd, bool compress) {
+        while (true) {
+            int fd(accept(listenFd, nullptr, nullptr));
+            if (fd < 0) return;
+            string request;
+            char buffer[4096];
+            int n;
+            while (request.find("\r\n\r\n") == string::npos && (n = recv(fd, buffer, sizeof(buffer), 0)) > 0)
+                request.append(buffer, n);
+            wireBytes += request.size();
+            // path without query
+            auto start(request.find(' ') + 1), end(request.find_first_of(" ?", start));
+            string path(request.substr(start, end - start)), content, head;
+            if (readFile(docRoot + path, content)) {
+                const char* encoding(nullptr);
+                if (compress && strcasestr(request.c_str(), "accept-encoding:") && strstr(request.c_str(), "gzip")) {
+                    content = gzip(content);
+                    encoding = "gzip";
+                }
+                head = "HTTP/1.1 200 OK\r\n"s + (encoding ? "Content-Encoding: gzip\r\n" : "") +
+                    "Content-Length: " + to_string(content.size()) + "\r\nConnection: close\r\n\r\n";
+            } else {
+                content.clear();
+                head = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+            }
+            sendThrottled(fd, head + content);
+            close(fd);
+        }
+    }
+
+    int run(bool compress) {
+        int listenFd(socket(AF_INET, SOCK_STREAM, 0));
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t addrLen(sizeof(addr));
+        if (bind(listenFd, (sockaddr*)&addr, sizeof(addr)) || listen(listenFd, 16) ||
+            getsockname(listenFd, (sockaddr*)&addr, &addrLen)) {
+            LOG("cannot listen");
+            return 1;
+        }
+        thread(serve, listenFd, compress).detach();
+
+        char server[32];
+        snprintf(server, sizeof(server), "127.0.0.1:%d", ntohs(addr.sin_port));
+        char* args[] = { (char*)"bench_transport", server };
+        setCommandLine(2, args);
+
+        auto t0(chrono::steady_clock::now());
+        auto ms = [&t0]() { return chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count(); };
+        ctx.initialize(DIAG(true, false));
+        DIAG(new RequestXHR(Identifier::Application, Context::strMng.add("application.ml")));
+        // first frame: first render() that painted (not just the application root created)
+        double firstFrame(0), allRequests(0);
+        int firstFrameBytes(0), allRequestsBytes(0);
+        while ((!firstFrame || !allRequests) && ms() < 60000) {
+            ctx.mainIteration();
+            if (!firstFrame && ctx.getLoopStats().frames) {
+                firstFrame = ms();
+                firstFrameBytes = wireBytes;
+            }
+            if (!allRequests && RequestXHR::getPending().empty()) {
+                allRequests = ms();
+                allRequestsBytes = wireBytes;
+            }
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }
+        if (!firstFrame || !allRequests) {
+            LOG("cannot load and render %s/application.ml", docRoot.c_str());
+            return 1;
+        }
+        LOG("%-8s first frame: %8.1f ms %8d bytes on the wire    all requests: %8.1f ms %8d bytes on the wire",
+            compress ? "gzip" : "identity", firstFrame, firstFrameBytes, allRequests, allRequestsBytes);
+        return 0;
+    }
+
+}
+
+int main(int argc, char* argv[]) {
+    if (argc >= 2) docRoot = argv[1];
+    if (argc >= 3) bytesPerSecond = atoi(argv[2]) * 1024;
+    LOG("%s at %d KB/s", docRoot.c_str(), bytesPerSecond / 1024);
+
+    // each mode in its own process (the application cannot be loaded twice)
+    for (bool compress: { false, true }) {
+        fflush(stdout);
+        pid_t pid(fork());
+        if (!pid) {
+            int dev(run(compress));
+            fflush(stdout);
+            _exit(dev); // without exit handlers of the parent
+        }
+        int status(1);
+        if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status)) return 1;
+    }
+    return 0;
+}
@@ -12,6 +12,7 @@
 #include "widget.h"
 #include "ml_parser.h"
 #include "application.h"
+#include "display_list.h"
 
 using namespace std;
 using namespace webui;
@@ -48,13 +49,14 @@ namespace {
         Fixture(): widget() {
             ctx.initialize(false, false);
             auto& ws(Context::app.getWidgets());
-            ws[Context::strMng.add("alpha")] = Context::app.createWidget(Identifier::Widget, nullptr);
-            ws[Context::strMng.add("omega")] = Context::app.createWidget(Identifier::Widget, nullptr);
+            for (auto* name: { "alpha", "omega" }) {
+                auto* w(Context::app.createWidget(Identifier::Widget, nullptr));
+                w->setId(Context::strMng.add(name));
+                ws[w->getId()] = w;
+            }
 
             // inheritance for widget test
-            auto begin(Widget::getType().begin());
-            auto end(Widget::getType().end());
-            widgetTest.insert(begin, end);
+            widgetTest.inherit(Widget::getType());
         }
 
         bool addAction(const char* str) {
@@ -251,3 +253,185 @@ TEST_CASE_METHOD(Fixture, "action: triple dispatch", "[action]") {
     CHECK(executeAction());
     CHECK(ws[Context::strMng.search("omega")]->box.pos.x == 4490);
 }
+
+TEST_CASE_METHOD(Fixture, "action: stack capacity", "[action]") {
+    // right-nested sums keep every left operand in the stack
+    string expr("1");
+    for (int i = 0; i < Stack::Capacity / 2; i++) expr = "1 + (" + expr + ")";
+    CHECK(addAction(expr.c_str()));
+    CHECK(executeAction());
+    CHECK(getStack().size() == 1);
+    CHECK(getStack()[0].f == float(Stack::Capacity / 2 + 1));
+    for (int i = 0; i < Stack::Capacity / 2; i++) expr = "1 + (" + expr + ")";
+    CHECK(!addAction(expr.c_str()));
+}
+
+TEST_CASE_METHOD(Fixture, "action: optimize constant folding", "[action]") {
+    CHECK(addAction("x = (12 + 21) / 2"));
+    CHECK(Context::actions.execute<true>(iAction, &widget));
+    CHECK(Context::actions.optimize(iAction) == 3); // push ptr, push constant, assign
+    Context::actions.dump(iAction);
+    CHECK(Context::actions.execute(iAction, &widget));
+    CHECK(widget.box.pos.x == 16.5f);
+}
+
+TEST_CASE_METHOD(Fixture, "action: optimize superinstructions", "[action]") {
+    // render calls (recorded, not drawn) and their arguments are the same before and after the optimization
+    auto record = [this](DisplayList& list) {
+        Context::render.setRecording(&list, false);
+        bool ok(Context::actions.execute(iAction, &widget));
+        Context::render.setRecording(nullptr);
+        return ok;
+    };
+    widget.box = Box4f(10, 20, 30, 40);
+    widget.background = RGBA(0x11223344);
+    const struct {
+        const char* action;
+        int optimized, recorded;
+    } cases[] = {
+        // x, 1, add, y, w, h, 4, background, fused call
+        { "[beginPath(), roundedRect(x + 1, y, w, h, 2 * 2), fillColor(background), fill()]", 9, 1 + 6 + 2 + 1 },
+        { "[beginPath(), roundedRect(x, y, w, h, 3), fillVertGrad(y, h, background, background % 50), fill()]", 12, 1 + 6 + 5 + 1 },
+        { "[beginPath(), roundedRect(x, y, w, h, 3), strokeColor(background), stroke()]", 7, 1 + 6 + 2 + 1 },
+        { "[beginPath(), moveto(x, y), lineto(w, h), strokeColor(background), stroke()]", 9, 1 + 3 + 3 + 2 + 1 },
+    };
+    for (const auto& c: cases) {
+        CHECK(addAction(c.action));
+        CHECK(Context::actions.execute<true>(iAction, &widget));
+        DisplayList before, after;
+        CHECK(record(before));
+        CHECK(Context::actions.optimize(iAction) == c.optimized);
+        Context::actions.dump(iAction);
+        CHECK(record(after));
+        CHECK(int(before.getCommands().size()) == c.recorded);
+        CHECK(before.getCommands() == after.getCommands());
+    }
+}
+
+TEST_CASE_METHOD(Fixture, "action: double dispatch cache", "[action]") {
+    auto& ws(Context::app.getWidgets());
+    auto* alpha(ws[Context::strMng.search("alpha")]);
+    auto* omega(ws[Context::strMng.search("omega")]);
+    widget.id = Context::strMng.search("alpha");
+    CHECK(addAction("id.y = 7 + id.y"));
+    CHECK(executeAction());
+    CHECK(Context::actions.execute(iAction, &widget));
+    CHECK(alpha->box.pos.y == 14);
+    // the cache follows changes of the variable
+    widget.id = Context::strMng.search("omega");
+    CHECK(Context::actions.execute(iAction, &widget));
+    CHECK(omega->box.pos.y == 7);
+    CHECK(alpha->box.pos.y == 14);
+    // and is invalidated when widgets are replaced
+    auto handle(omega->getHandle());
+    omega->~Widget(); // its arena memory is not reused here
+    CHECK(!Widget::fromHandle(handle));
+    auto* omega2(Context::app.createWidget(Identifier::Widget, nullptr));
+    omega2->setId(widget.id);
+    ws[widget.id] = omega2;
+    CHECK(Context::actions.execute(iAction, &widget));
+    CHECK(omega2->box.pos.y == 7);
+    // the previous variable again
+    widget.id = Context::strMng.search("alpha");
+    CHECK(Context::actions.execute(iAction, &widget));
+    CHECK(alpha->box.pos.y == 21);
+}
+
+TEST_CASE_METHOD(Fixture, "action: display list validity", "[action]") {
+    // no render calls (no render context in tests), but dependencies are tracked the same way
+    DisplayList list;
+    CHECK(addAction("[x + y * 2, background % 50]"));
+    CHECK(Context::actions.execute<true>(iAction, &widget));
+    CHECK(list.render(iAction, &widget));
+    CHECK(list.valid(iAction, &widget));
+    CHECK(!list.valid(iAction + 1, &widget));
+    widget.background = RGBA(0x11223344);
+    CHECK(!list.valid(iAction, &widget));
+    CHECK(list.render(iAction, &widget));
+    CHECK(list.valid(iAction, &widget));
+    widget.box.size.x = 10; // box
+    CHECK(!list.valid(iAction, &widget));
+    CHECK(list.render(iAction, &widget));
+    CHECK(list.valid(iAction, &widget));
+
+    // foreign widgets: valid while alive, whatever else is created or destroyed
+    auto& ws(Context::app.getWidgets());
+    auto* alpha(ws[Context::strMng.search("alpha")]);
+    CHECK(addAction("[alpha.x + 1]"));
+    CHECK(Context::actions.execute<true>(iAction, &widget));
+    CHECK(list.render(iAction, &widget));
+    CHECK(list.valid(iAction, &widget));
+    delete new Widget(nullptr);
+    CHECK(list.valid(iAction, &widget));
+    ws.erase(alpha->getId());
+    alpha->~Widget();
+    CHECK(!list.valid(iAction, &widget));
+
+    // actions with side effects are always executed
+    CHECK(addAction("x = 4"));
+    CHECK(Context::actions.execute<true>(iAction, &widget));
+    CHECK(list.render(iAction, &widget));
+    CHECK(!list.valid(iAction, &widget));
+    CHECK(widget.box.pos.x == 4);
+}
+
+TEST_CASE_METHOD(Fixture, "action: damage tracking", "[action]") {
+    auto& render(Context::render);
+    const float m(Render::DamageMargin);
+    DisplayList list;
+    CHECK(addAction("[x + y * 2]"));
+    CHECK(Context::actions.execute<true>(iAction, &widget));
+    widget.box = Box4f(10, 20, 30, 40);
+
+    // painted frame
+    DisplayList::beginFrame();
+    CHECK(list.render(iAction, &widget));
+    list.setPainted(&widget, 0x100);
+    render.resetDamage();
+
+    // nothing changed
+    DisplayList::beginDamagePass();
+    list.damage(iAction, &widget, 0x100);
+    DisplayList::endDamagePass();
+    CHECK(!render.isDamaged());
+
+    // alpha changed: same box
+    DisplayList::beginDamagePass();
+    list.damage(iAction, &widget, 0x80);
+    DisplayList::endDamagePass();
+    CHECK(render.getDamage() == Box4f(10 - m, 20 - m, 30 + 2 * m, 40 + 2 * m));
+    render.resetDamage();
+
+    // moved: old and new boxes
+    widget.box.pos.x = 100;
+    DisplayList::beginDamagePass();
+    list.damage(iAction, &widget, 0x100);
+    DisplayList::endDamagePass();
+    CHECK(render.getDamage() == Box4f(10 - m, 20 - m, 120 + 2 * m, 40 + 2 * m));
+    render.resetDamage();
+
+    // not painted any more: old box
+    DisplayList::beginDamagePass();
+    DisplayList::endDamagePass();
+    CHECK(render.getDamage() == Box4f(10 - m, 20 - m, 30 + 2 * m, 40 + 2 * m));
+    render.resetDamage();
+
+    // destroyed: its painted box only
+    auto* destroyed(new DisplayList);
+    DisplayList::beginFrame();
+    CHECK(list.render(iAction, &widget));
+    list.setPainted(&widget, 0x100);
+    CHECK(destroyed->render(iAction, &widget));
+    widget.box.pos.x = 200;
+    destroyed->setPainted(&widget, 0x100);
+    widget.box.pos.x = 100;
+    render.resetDamage();
+    delete destroyed;
+    CHECK(!render.isDamagedAll());
+    CHECK(render.getDamage() == Box4f(200 - m, 20 - m, 30 + 2 * m, 40 + 2 * m));
+    render.resetDamage();
+    DisplayList::beginDamagePass();
+    list.damage(iAction, &widget, 0x100);
+    DisplayList::endDamagePass();
+    CHECK(!render.isDamaged());
+}
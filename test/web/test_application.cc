@@ -7,9 +7,13 @@
 */
 
 #include "catch.hpp"
+#include "image.h"
 #include "widget.h"
+#include "widget_template.h"
 #include "context.h"
 #include "application.h"
+#include "input.h"
+#include "display_list.h"
 #include <string>
 
 #define _ "\n"
@@ -67,6 +71,43 @@ TEST_CASE("application: definition", "[application]") {
     CHECK(child[1]->typeWidget->get(Context::strMng.search("width").getId(), child[1]) == 333);
 }
 
+TEST_CASE("application: definition inheritance", "[application]") {
+    ctx.initialize(false, false);
+    CHECK(Context::app.onLoad(mlApp(
+                                  "Application{"
+                                  _"  Widget {"
+                                  _"    define: Base"
+                                  _"    propInt16: count"
+                                  _"    propText: label"
+                                  _"    count: 7"
+                                  _"    label: \"base\""
+                                  _"    width: 12"
+                                  _"  }"
+                                  _"  Base {"
+                                  _"    define: Derived"
+                                  _"    propFloat: ratio"
+                                  _"    propInt16: count     // already in base: ignored"
+                                  _"    ratio: 0.5"
+                                  _"  }"
+                                  _"  Derived {"
+                                  _"    count: 9"
+                                  _"  }"
+                                  _"}")));
+    auto root(Context::app.getRoot());
+    REQUIRE(root);
+    auto& child(root->getChildren());
+    REQUIRE(child.size() == 1);
+    auto* w(child[0]);
+    CHECK(string(Context::strMng.get(w->type())) == "Derived");
+    CHECK(w->typeWidget->get(Context::strMng.search("count").getId(), w) == 9);
+    CHECK(!strcmp((char*)w->typeWidget->get(Context::strMng.search("label").getId(), w), "base"));
+    CHECK(w->typeWidget->get(Context::strMng.search("width").getId(), w) == 12);
+    auto* ratio(w->getProp(Context::strMng.search("ratio")));
+    REQUIRE(ratio);
+    CHECK(reinterpret_cast<float*>(w)[ratio->pos] == 0.5f);
+    CHECK(w->getProp(Context::strMng.search("width")) == Widget::getType().find(Identifier::width)); // shared
+}
+
 TEST_CASE("application: template", "[application]") {
     ctx.initialize(false, false);
     CHECK(Context::app.onLoad(mlApp(
@@ -214,14 +255,14 @@ TEST_CASE("application: template reload blocks with ids", "[application]") {
     // reload
     CHECK(Context::app.onLoad(mlTemplate("[ [ [ another, 99 ], [ id10, 11 ], [ id20, 22 ] ] ]", "template")));
     REQUIRE(tpl.size() == 3);
-    CHECK(tpl[0]->id == Context::strMng.add("id10"));
-    CHECK(tpl[0]->box.pos.x == 11);
-    CHECK(tpl[0]->box.pos.y == 100);
-    CHECK(tpl[1]->id == Context::strMng.add("id20"));
-    CHECK(tpl[1]->box.pos.x == 22);
-    CHECK(tpl[1]->box.pos.y == 200);
-    CHECK(tpl[2]->id == Context::strMng.add("another"));
-    CHECK(tpl[2]->box.pos.x == 99);
+    CHECK(tpl[0]->id == Context::strMng.add("another"));
+    CHECK(tpl[0]->box.pos.x == 99);
+    CHECK(tpl[1]->id == Context::strMng.add("id10"));
+    CHECK(tpl[1]->box.pos.x == 11);
+    CHECK(tpl[1]->box.pos.y == 100);
+    CHECK(tpl[2]->id == Context::strMng.add("id20"));
+    CHECK(tpl[2]->box.pos.x == 22);
+    CHECK(tpl[2]->box.pos.y == 200);
     // reload updating just one (others dissapear)
     CHECK(Context::app.onLoad(mlTemplate("[ [ [ id20, 24 ] ] ]", "template")));
     REQUIRE(tpl.size() == 1);
@@ -230,6 +271,90 @@ TEST_CASE("application: template reload blocks with ids", "[application]") {
     CHECK(tpl[0]->box.pos.y == 200);
 }
 
+TEST_CASE("application: template rows recycled", "[application]") {
+    ctx.initialize(false, false);
+    CHECK(Context::app.onLoad(mlApp(
+                                  "Application{"
+                                  _"  Template {"
+                                  _"    id: template"
+                                  _"    ["
+                                  _"      Widget {"
+                                  _"        id: @"
+                                  _"        x: @"
+                                  _"        Widget { }"
+                                  _"      }"
+                                  _"    ]"
+                                  _"  }"
+                                  _"}")));
+    const auto& arena(Context::app.getArena());
+    CHECK(Context::app.onLoad(mlTemplate("[ [ [ a, 1 ], [ b, 2 ], [ c, 3 ] ] ]", "template")));
+    int live(arena.getLive()), slabs(arena.getSlabs());
+    // rows disappear: memory goes to the free lists and ids are released
+    CHECK(Context::app.onLoad(mlTemplate("[ [ [ b, 2 ] ] ]", "template")));
+    CHECK(arena.getLive() == live - 4);
+    CHECK(Context::app.getWidgets().count(Context::strMng.add("a")) == 0);
+    // rows appear again: recycled, no new slabs
+    int recycled(arena.getRecycled());
+    CHECK(Context::app.onLoad(mlTemplate("[ [ [ a, 5 ], [ b, 6 ], [ c, 7 ] ] ]", "template")));
+    CHECK(arena.getLive() == live);
+    CHECK(arena.getRecycled() == recycled + 4);
+    CHECK(arena.getSlabs() == slabs);
+    REQUIRE(Context::app.getRoot()->getChildren()[0]->getChildren().size() == 3);
+    auto& widgets(Context::app.getWidgets());
+    REQUIRE(widgets.count(Context::strMng.add("a")));
+    CHECK(widgets[Context::strMng.add("a")]->box.pos.x == 5);
+    CHECK(widgets[Context::strMng.add("c")]->box.pos.x == 7);
+}
+
+TEST_CASE("application: memory compaction", "[application]") {
+    ctx.initialize(false, false);
+    CHECK(Context::app.onLoad(mlApp(
+                                  "Application{"
+                                  _"  Template {"
+                                  _"    id: template"
+                                  _"    ["
+                                  _"      Widget {"
+                                  _"        id: @"
+                                  _"        onRender: roundedRect(x, y, @, h, 1)"
+                                  _"      }"
+                                  _"    ]"
+                                  _"  }"
+                                  _"}")));
+    CHECK(Context::app.onLoad(mlTemplate("[ [ [ row1, 10 ], [ row2, 20 ], [ row3, 30 ] ] ]", "template")));
+    CHECK(Context::app.onLoad(mlTemplate("[ [ [ row4, 40 ] ] ]", "template")));
+    auto row1(Context::strMng.search("row1"));
+    REQUIRE(row1.valid());
+    int commands(Context::actions.size());
+    Context::app.compact();
+    const auto& stats(Context::app.getMemoryStats());
+    CHECK(stats.actionsDead > 0);
+    CHECK(stats.stringsDead > 0);
+    CHECK(Context::actions.size() < commands);
+    // removed rows released, remaining one still works
+    CHECK(!Context::strMng.search("row1").valid());
+    auto& widgets(Context::app.getWidgets());
+    auto it(widgets.find(Context::strMng.search("row4")));
+    REQUIRE(it != widgets.end());
+    auto* row4(it->second);
+    const auto& table(Context::app.getActionTable(row4->actions));
+    REQUIRE(table.onRender);
+    CHECK(Context::actions.execute(table.onRender, row4));
+    // a stale id is reported instead of resolving to a new string of the same size
+    Context::strMng.add("row9");
+    CHECK(strcmp(Context::strMng.get(row1), "row9"));
+    CHECK(!strcmp(Context::strMng.get(row1), "(released)"));
+    // room of released strings is reused (after the next sweep)
+    Context::app.compact();
+    int dead(Context::strMng.getDeadBytes());
+    CHECK(dead >= 5);
+    Context::strMng.add("row5");
+    CHECK(Context::strMng.getDeadBytes() == dead - 5);
+    // nothing else to release
+    Context::app.compact();
+    CHECK(stats.actionsDead == 0);
+    CHECK(stats.tablesDead == 0);
+}
+
 TEST_CASE("application: template reload block sequences", "[application]") {
     ctx.initialize(false, false);
     CHECK(Context::app.onLoad(mlApp(
@@ -342,6 +467,162 @@ TEST_CASE("application: double dispatch", "[application]") {
     CHECK(string(Context::strMng.get(child[0]->type())) == "Props");
 }
 
+TEST_CASE("application: layout dirty", "[application]") {
+    ctx.initialize(false, false);
+    CHECK(Context::app.onLoad(mlApp(
+                                  "Application {"
+                                  _"  LayoutVer {"
+                                  _"    Widget { height: 20 }"
+                                  _"    Widget { height: 30  onClick: [ height = 40 ] }"
+                                  _"  }"
+                                  _"}")));
+    auto root(Context::app.getRoot());
+    REQUIRE(root);
+    auto* layout(root->getChildren()[0]);
+    auto* first(layout->getChildren()[0]);
+    auto* second(layout->getChildren()[1]);
+    CHECK(root->isLayoutDirty());
+    Box4f window(0, 0, 100, 100);
+    for (int i = 0; i < 1000 && !root->layout(window); i++) ;
+    CHECK(!root->isLayoutDirty());
+    CHECK(!layout->isLayoutDirty());
+    CHECK(root->layout(window)); // clean: skipped
+
+    // assignment marks the widget and its ancestors
+    CHECK(Context::actions.execute(Context::app.getActionTable(second->actions).onClick, second));
+    CHECK(second->isLayoutDirty());
+    CHECK(layout->isLayoutDirty());
+    CHECK(root->isLayoutDirty());
+    CHECK(!first->isLayoutDirty());
+    for (int i = 0; i < 1000 && !root->layout(window); i++) ;
+    CHECK(!root->isLayoutDirty());
+    CHECK(second->box.size.y == 40);
+
+    // visibility
+    first->setVisible(false);
+    CHECK(root->isLayoutDirty());
+    CHECK(!second->isLayoutDirty());
+}
+
+TEST_CASE("application: idle time", "[application]") {
+    ctx.initialize(false, false);
+    CHECK(Context::app.onLoad(mlApp(
+                                  "Application {"
+                                  _"  Widget { height: 20 }"
+                                  _"  Timer {"
+                                  _"    delay: 300"
+                                  _"    repeat: 0"
+                                  _"    onTimeout: height = 10"
+                                  _"  }"
+                                  _"}")));
+    auto root(Context::app.getRoot());
+    REQUIRE(root);
+
+    // animation frames until the layout is stable, then the timer
+    CHECK(root->isLayoutDirty());
+    CHECK(Context::app.getIdleMs() <= 16);
+    Box4f window(0, 0, 100, 100);
+    for (int i = 0; i < 1000 && !root->layout(window); i++) ;
+    REQUIRE(!root->isLayoutDirty());
+    auto idle(Context::app.getIdleMs());
+    CHECK(idle > 200);
+    CHECK(idle <= 300);
+
+    // hover trigger
+    Input::hoverTime = getTimeNowMs() + 50;
+    CHECK(Context::app.getIdleMs() <= 51);
+    Input::hoverTime = 0;
+}
+
+TEST_CASE("application: render assignments settle", "[application]") {
+    ctx.initialize(false, false);
+    CHECK(Context::app.onLoad(mlApp(
+                                  "Application {"
+                                  _"  Widget {"
+                                  _"    define: Counter"
+                                  _"    propInt16: value"
+                                  _"    onRender: [ height = 20, value = 5 ]"
+                                  _"    onClick: value = value + 1"
+                                  _"  }"
+                                  _"  Counter { }"
+                                  _"}")));
+    auto root(Context::app.getRoot());
+    REQUIRE(root);
+    auto* w(root->getChildren()[0]);
+    const auto& table(Context::app.getActionTable(w->actions));
+    auto value(Context::strMng.search("value"));
+    Box4f window(0, 0, 100, 100);
+
+    // first render changes the height
+    CHECK(Context::actions.execute(table.onRender, w));
+    CHECK(root->isLayoutDirty());
+    for (int i = 0; i < 1000 && !root->layout(window); i++) ;
+    REQUIRE(!root->isLayoutDirty());
+
+    // same values: nothing dirty
+    CHECK(Context::actions.execute(table.onRender, w));
+    CHECK(!root->isLayoutDirty());
+    CHECK(Context::app.getIdleMs() > 16);
+
+    // user property: painted, not laid out
+    CHECK(Context::actions.execute(table.onClick, w));
+    CHECK(w->typeWidget->get(value, w) == 6);
+    CHECK(!root->isLayoutDirty());
+}
+
+TEST_CASE("application: virtualized layout", "[application]") {
+    ctx.initialize(false, false);
+    string ml("Application { LayoutVer { overscan: 10");
+    for (int i = 0; i < 200; i++) ml += " Widget { height: 20 }";
+    ml += " } }";
+    CHECK(Context::app.onLoad(mlApp(ml.c_str())));
+    auto root(Context::app.getRoot());
+    REQUIRE(root);
+    auto* layout(root->getChildren()[0]);
+    const auto& rows(layout->getChildren());
+    REQUIRE(rows.size() == 200);
+    Box4f window(0, 0, 100, 100);
+    for (int i = 0; i < 1000 && !root->layout(window); i++) ;
+    CHECK(!root->isLayoutDirty());
+    CHECK(layout->scrollable);
+    // only visible rows plus overscan are laid out
+    CHECK(!rows[5]->isLayoutDirty());
+    CHECK(rows[5]->box.pos.y == 100);
+    CHECK(rows[6]->isLayoutDirty());
+    CHECK(rows[199]->isLayoutDirty());
+}
+
+TEST_CASE("application: layout hit-testing", "[application]") {
+    ctx.initialize(false, false);
+    string ml("Application { LayoutVer { size: 3 last: 5");
+    for (int i = 0; i < 8; i++) ml += " Widget { height: 20 }";
+    ml += " } }";
+    CHECK(Context::app.onLoad(mlApp(ml.c_str())));
+    auto root(Context::app.getRoot());
+    REQUIRE(root);
+    const auto& rows(root->getChildren()[0]->getChildren());
+    REQUIRE(rows.size() == 8);
+    Box4f window(0, 0, 100, 100);
+    for (int i = 0; i < 1000 && !root->layout(window); i++) ;
+    // cyclic arrangement starts at child 5
+    CHECK(rows[5]->box.pos.y == 0);
+    CHECK(rows[6]->box.pos.y == 20);
+    CHECK(rows[1]->box.pos.y == 80);
+
+    Input::cursor = V2f(50, 30);
+    root->update();
+    CHECK(rows[6]->inside);
+    Input::cursor = V2f(50, 90);
+    root->update();
+    CHECK(!rows[6]->inside);
+    CHECK(rows[1]->inside);
+    Input::cursor = V2f(150, 90);
+    root->update();
+    CHECK(!rows[1]->inside);
+    CHECK(!root->inside);
+    Input::cursor = V2f(0, 0);
+}
+
 TEST_CASE("application: failing case", "[application]") {
     ctx.initialize(false, false);
     CHECK(Context::app.onLoad(mlApp(
@@ -392,6 +673,343 @@ TEST_CASE("application: template definition", "[application]") {
     CHECK(tp2[2]->box.pos.x == 555);
 }
 
+TEST_CASE("application: template copies share their source", "[application]") {
+    ctx.initialize(false, false);
+    CHECK(Context::app.onLoad(mlApp(
+                                  "Application {"
+                                  _"  Template {"
+                                  _"    define: Tree"
+                                  _"    ["
+                                  _"      Widget {"
+                                  _"        x: @"
+                                  _"      }"
+                                  _"    ]"
+                                  _"  }"
+                                  _"  Tree {"
+                                  _"    id: tree"
+                                  _"  }"
+                                  _"  Tree {"
+                                  _"    id: tree2"
+                                  _"  }"
+                                  _"}")));
+    auto root(Context::app.getRoot());
+    REQUIRE(root);
+    auto& child(root->getChildren());
+    REQUIRE(child.size() == 2);
+    auto& parser(reinterpret_cast<WidgetTemplate*>(child[0])->getParser());
+    auto& parser2(reinterpret_cast<WidgetTemplate*>(child[1])->getParser());
+    REQUIRE(!parser.empty());
+    CHECK(parser.size() - parser.firstEntry() == parser2.size() - parser2.firstEntry());
+    CHECK(parser[parser.firstEntry()].pos == parser2[parser2.firstEntry()].pos);
+    // a copy outlives its origin
+    {
+        MLParser copy;
+        parser.copyTo(copy, parser.firstEntry(), parser.size());
+        CHECK(copy[copy.firstEntry()].pos == parser[parser.firstEntry()].pos);
+        Context::app.clear();
+        CHECK(copy.asId(copy.firstEntry() + 1) == Identifier::Widget);
+    }
+}
+
+TEST_CASE("application: keyed template rows", "[application]") {
+    ctx.initialize(false, false);
+    CHECK(Context::app.onLoad(mlApp(
+                                  "Application {"
+                                  _"  Template {"
+                                  _"    id: list"
+                                  _"    ["
+                                  _"      Widget {"
+                                  _"        id: @"
+                                  _"        x: @"
+                                  _"      }"
+                                  _"    ]"
+                                  _"  }"
+                                  _"}")));
+    auto root(Context::app.getRoot());
+    REQUIRE(root);
+    auto& rows(root->getChildren()[0]->getChildren());
+    auto ids = [&rows]() {
+        string ids;
+        for (auto* row: rows) ids += string(Context::strMng.get(row->getId())) + ":" + to_string(int(row->box.pos.x)) + " ";
+        return ids;
+    };
+    auto& stats(Context::app.getReconcileStats());
+    CHECK(Context::app.onLoad(mlTemplate("[ [ [ a, 1 ], [ b, 2 ], [ c, 3 ] ] ]", "list")));
+    CHECK(ids() == "a:1 b:2 c:3 ");
+    CHECK(stats.created == 3);
+    auto rowsBefore(rows);
+
+    // insertion at the top: rows are kept
+    CHECK(Context::app.onLoad(mlTemplate("[ [ [ n, 0 ], [ a, 1 ], [ b, 2 ], [ c, 3 ] ] ]", "list")));
+    CHECK(ids() == "n:0 a:1 b:2 c:3 ");
+    REQUIRE(rows.size() == 4);
+    CHECK(rows[1] == rowsBefore[0]);
+    CHECK(rows[2] == rowsBefore[1]);
+    CHECK(rows[3] == rowsBefore[2]);
+    CHECK(stats.reused == 3);
+    CHECK(stats.created == 1);
+    CHECK(stats.moved == 0);
+    CHECK(stats.destroyed == 0);
+
+    // reordering and removal
+    CHECK(Context::app.onLoad(mlTemplate("[ [ [ c, 30 ], [ a, 10 ], [ b, 20 ] ] ]", "list")));
+    CHECK(ids() == "c:30 a:10 b:20 ");
+    REQUIRE(rows.size() == 3);
+    CHECK(rows[0] == rowsBefore[2]);
+    CHECK(rows[1] == rowsBefore[0]);
+    CHECK(stats.reused == 3);
+    CHECK(stats.created == 0);
+    CHECK(stats.moved == 1);
+    CHECK(stats.destroyed == 1);
+    CHECK(!Context::app.getWidgets().count(Context::strMng.search("n")));
+}
+
+TEST_CASE("application: unchanged template data", "[application]") {
+    ctx.initialize(false, false);
+    CHECK(Context::app.onLoad(mlApp(
+                                  "Application {"
+                                  _"  Template {"
+                                  _"    id: list"
+                                  _"    ["
+                                  _"      Widget {"
+                                  _"        x: @"
+                                  _"      }"
+                                  _"    ]"
+                                  _"  }"
+                                  _"}")));
+    auto root(Context::app.getRoot());
+    REQUIRE(root);
+    auto& rows(root->getChildren()[0]->getChildren());
+    CHECK(Context::app.onLoad(mlTemplate("[ [ [ 1 ], [ 2 ] ] ]", "list")));
+    REQUIRE(rows.size() == 2);
+    rows[0]->box.pos.x = 99;
+
+    // identical data (like a revalidated cached response) is not applied again
+    CHECK(Context::app.onLoad(mlTemplate("[ [ [ 1 ], [ 2 ] ] ]", "list")));
+    CHECK(rows[0]->box.pos.x == 99);
+
+    CHECK(Context::app.onLoad(mlTemplate("[ [ [ 1 ], [ 3 ] ] ]", "list")));
+    CHECK(rows[0]->box.pos.x == 1);
+    CHECK(rows[1]->box.pos.x == 3);
+
+    // data of several templates changes it too: the last single data is applied again
+    CHECK(Context::app.onLoad(mlTemplate("data { list: [ [ [ 5 ] ] ] }", "other")));
+    REQUIRE(rows.size() == 1);
+    CHECK(rows[0]->box.pos.x == 5);
+    CHECK(Context::app.onLoad(mlTemplate("[ [ [ 1 ], [ 3 ] ] ]", "list")));
+    REQUIRE(rows.size() == 2);
+    CHECK(rows[1]->box.pos.x == 3);
+}
+
+TEST_CASE("application: template patches", "[application]") {
+    ctx.initialize(false, false);
+    CHECK(Context::app.onLoad(mlApp(
+                                  "Application {"
+                                  _"  Template {"
+                                  _"    id: list"
+                                  _"    ["
+                                  _"      Widget {"
+                                  _"        id: @"
+                                  _"        x: @"
+                                  _"        ["
+                                  _"          Widget {"
+                                  _"            id: @"
+                                  _"            y: @"
+                                  _"          }"
+                                  _"        ]"
+                                  _"      }"
+                                  _"    ]"
+                                  _"  }"
+                                  _"}")));
+    auto root(Context::app.getRoot());
+    REQUIRE(root);
+    auto* list(reinterpret_cast<WidgetTemplate*>(root->getChildren()[0]));
+    auto& rows(list->getChildren());
+    auto widget = [](const char* id) {
+        auto it(Context::app.getWidgets().find(Context::strMng.search(id)));
+        return it == Context::app.getWidgets().end() ? nullptr : it->second;
+    };
+    auto ids = [](const vector<Widget*>& rows) {
+        string ids;
+        for (auto* row: rows) ids += string(Context::strMng.get(row->getId())) + " ";
+        return ids;
+    };
+    CHECK(Context::app.onLoad(mlTemplate("[ [ [ a, 1, [ [ a1, 10 ], [ a2, 20 ] ] ], [ b, 2, [ ] ] ] ]", "list")));
+    CHECK(list->seq == 0);
+    auto* a(widget("a"));
+    auto* a2(widget("a2"));
+    REQUIRE(a);
+    REQUIRE(a2);
+
+    // values of rows at any level
+    CHECK(Context::app.onLoad(mlTemplate("Patch {"
+                                         _"  seq: 1"
+                                         _"  update { path: [ 0, a ] field: 1 value: 5 }"
+                                         _"  update { path: [ 0, a, 2, a2 ] field: 1 value: 25 }"
+                                         _"}", "list")));
+    CHECK(list->seq == 1);
+    CHECK(widget("a") == a);
+    CHECK(a->box.pos.x == 5);
+    CHECK(a2->box.pos.y == 25);
+    CHECK(Context::app.getReconcileStats().created == 0);
+
+    // stale and out of order
+    CHECK(!Context::app.onLoad(mlTemplate("Patch { seq: 1 update { path: [ 0, a ] field: 1 value: 6 } }", "list")));
+    CHECK(!Context::app.onLoad(mlTemplate("Patch { seq: 3 update { path: [ 0, a ] field: 1 value: 6 } }", "list")));
+    CHECK(a->box.pos.x == 5);
+    CHECK(list->seq == 1);
+
+    // rows
+    CHECK(Context::app.onLoad(mlTemplate("Patch {"
+                                         _"  seq: 2"
+                                         _"  insert { path: [ 0 ] row: [ c, 3, [ [ c1, 30 ] ] ] before: b }"
+                                         _"  move { path: [ 0, b ] before: a }"
+                                         _"  remove { path: [ 0, a, 2, a1 ] }"
+                                         _"}", "list")));
+    CHECK(list->seq == 2);
+    CHECK(ids(rows) == "b a c ");
+    CHECK(ids(a->getChildren()) == "a2 ");
+    CHECK(!widget("a1"));
+    REQUIRE(widget("c1"));
+    CHECK(widget("c1")->box.pos.y == 30);
+    CHECK(rows[1] == a);
+    auto& stats(Context::app.getReconcileStats());
+    CHECK(stats.created == 2);
+    CHECK(stats.moved == 1);
+    CHECK(stats.destroyed == 1);
+
+    // a failed patch needs a snapshot
+    CHECK(!Context::app.onLoad(mlTemplate("Patch { seq: 3 remove { path: [ 0, nothing ] } }", "list")));
+    CHECK(list->seq == -1);
+    CHECK(!Context::app.onLoad(mlTemplate("Patch { seq: 4 remove { path: [ 0, a ] } }", "list")));
+    CHECK(rows.size() == 3);
+    CHECK(Context::app.onLoad(mlTemplate("Patch { seq: 5 data: [ [ [ a, 7, [ ] ] ] ] }", "list")));
+    CHECK(list->seq == 5);
+    CHECK(ids(rows) == "a ");
+    CHECK(rows[0] == a);
+    CHECK(a->box.pos.x == 7);
+}
+
+TEST_CASE("application: request scheduling", "[application]") {
+    ctx.initialize(false, false);
+    CHECK(Context::app.onLoad(mlApp(
+                                  "Application {"
+                                  _"  Template { id: rq1 }"
+                                  _"  Template { id: rq2 }"
+                                  _"  Template { id: rq3 }"
+                                  _"  Template { id: rq4 }"
+                                  _"  Template { id: rqHidden visible: 0 }"
+                                  _"  Template { id: rq5 }"
+                                  _"}")));
+    auto& app(Context::app);
+    auto id = [](const char* str) { return Context::strMng.add(str); };
+    auto inFlight = [](StringId id, StringId req) -> RequestXHR* {
+        for (auto* xhr: RequestXHR::getPending())
+            if (xhr->getId() == id && xhr->getReq() == req) return xhr;
+        return nullptr;
+    };
+    auto tree(id("tree.ml")), other(id("other.ml"));
+
+    // identical requests are collapsed
+    for (int i = 0; i < 3; i++)
+        CHECK(app.executeQuery(tree, id("rq1")));
+    CHECK(app.getRequestStats().sent == 1);
+    CHECK(app.getRequestStats().collapsed == 2);
+    CHECK(app.getRequestStats().inFlight == 1);
+
+    // a different query supersedes the previous one: its response is discarded
+    CHECK(app.executeQuery(other, id("rq1")));
+    CHECK(app.getRequestStats().superseded == 1);
+    CHECK(app.getRequestStats().inFlight == 2);
+    auto* old(inFlight(id("rq1"), tree));
+    REQUIRE(old);
+    CHECK(app.onLoad(old)); // without data: it would fail if it were applied
+    CHECK(app.getRequestStats().inFlight == 1);
+
+    // limited requests in flight, visible widgets first
+    CHECK(app.executeQuery(tree, id("rq2")));
+    CHECK(app.executeQuery(tree, id("rq3")));
+    CHECK(app.executeQuery(tree, id("rq4")));
+    CHECK(app.executeQuery(tree, id("rqHidden")));
+    CHECK(app.executeQuery(tree, id("rq5")));
+    CHECK(app.getRequestStats().inFlight == 4);
+    CHECK(app.getRequestStats().queued == 2);
+    auto* done(inFlight(id("rq2"), tree));
+    REQUIRE(done);
+    app.onError(done);
+    CHECK(inFlight(id("rq5"), tree));
+    CHECK(!inFlight(id("rqHidden"), tree));
+    CHECK(app.getRequestStats().queued == 1);
+}
+
+TEST_CASE("application: template streaming", "[application]") {
+    ctx.initialize(false, false);
+    CHECK(Context::app.onLoad(mlApp(
+                                  "Application {"
+                                  _"  Template {"
+                                  _"    define: Tree"
+                                  _"    ["
+                                  _"      Widget {"
+                                  _"        x: @"
+                                  _"      }"
+                                  _"    ]"
+                                  _"  }"
+                                  _"  Tree {"
+                                  _"    id: tree"
+                                  _"  }"
+                                  _"  Tree {"
+                                  _"    id: tree2"
+                                  _"  }"
+                                  _"}")));
+    auto root(Context::app.getRoot());
+    REQUIRE(root);
+    auto& tpl(root->getChildren()[0]->getChildren());
+    auto& tp2(root->getChildren()[1]->getChildren());
+    // received in small chunks: first template is instantiated before the rest arrives
+    string data("data {\n  tree: [ [ [ 111 ], [ 222 ] ] ] // ]\n  tree2: [ [ [ 333 ], [ 444 ], [ 555 ] ] ]\n}");
+    auto* xhr(mlTemplate("", "tree"));
+    int half(data.find("tree2"));
+    for (int i = 0; i < half; i += 3)
+        CHECK(Context::app.onProgress(xhr, data.data() + i, min(3, half - i)));
+    REQUIRE(tpl.size() == 2);
+    CHECK(tpl[0]->box.pos.x == 111);
+    CHECK(tpl[1]->box.pos.x == 222);
+    CHECK(tp2.size() == 0);
+    // rows of the second one as they arrive
+    int row(data.find("[ 555"));
+    for (int i = half; i < row; i += 3)
+        CHECK(Context::app.onProgress(xhr, data.data() + i, min(3, row - i)));
+    REQUIRE(tp2.size() == 2);
+    CHECK(tp2[1]->box.pos.x == 444);
+    CHECK(Context::app.onProgress(xhr, data.data() + row, data.size() - row));
+    CHECK(Context::app.onLoad(xhr));
+    REQUIRE(tp2.size() == 3);
+    CHECK(tp2[2]->box.pos.x == 555);
+    // single template: first rows replace the previous ones, the next are appended
+    xhr = mlTemplate("", "tree");
+    CHECK(Context::app.onProgress(xhr, "[ [ [ 7", 7));
+    CHECK(tpl.size() == 2);
+    CHECK(Context::app.onProgress(xhr, "77 ], [ 8", 9));
+    REQUIRE(tpl.size() == 1);
+    CHECK(tpl[0]->box.pos.x == 777);
+    CHECK(Context::app.onProgress(xhr, "88 ], [ 999 ]", 13));
+    REQUIRE(tpl.size() == 2);
+    CHECK(tpl[1]->box.pos.x == 888);
+    CHECK(Context::app.onProgress(xhr, " ] ]", 4));
+    REQUIRE(tpl.size() == 3);
+    CHECK(tpl[2]->box.pos.x == 999);
+    CHECK(Context::app.onLoad(xhr));
+    CHECK(tpl.size() == 3);
+    // same data again: rows are reused
+    auto* first(tpl[0]);
+    xhr = mlTemplate("", "tree");
+    const char* same("[ [ [ 777 ], [ 888 ], [ 999 ] ] ]");
+    CHECK(Context::app.onProgress(xhr, same, strlen(same)));
+    CHECK(Context::app.onLoad(xhr));
+    REQUIRE(tpl.size() == 3);
+    CHECK(tpl[0] == first);
+}
+
 TEST_CASE("application: hierarchy properties", "[application]") {
     ctx.initialize(false, false);
     CHECK(Context::app.onLoad(mlApp(
@@ -461,6 +1079,107 @@ TEST_CASE("application: double dispatch in ancestor", "[application]") {
     CHECK(child[0]->typeWidget->get(Context::strMng.search("value").getId(), child[0]) == 3333);
 }
 
+TEST_CASE("application: double dispatch to re-registered id", "[application]") {
+    ctx.initialize(false, false);
+    CHECK(Context::app.onLoad(mlApp(
+                                  "Application {"
+                                  _"  Template {"
+                                  _"    id: list"
+                                  _"    ["
+                                  _"      Widget {"
+                                  _"        id: @"
+                                  _"        x: @"
+                                  _"      }"
+                                  _"    ]"
+                                  _"  }"
+                                  _"  Widget {"
+                                  _"    define: Caller"
+                                  _"    propId: ref"
+                                  _"    ref: list            // any widget for the dry run"
+                                  _"    onClick: ref.x = 77"
+                                  _"  }"
+                                  _"  Template {"
+                                  _"    id: caller"
+                                  _"    Caller {"
+                                  _"      ref: @"
+                                  _"    }"
+                                  _"  }"
+                                  _"}")));
+    auto root(Context::app.getRoot());
+    REQUIRE(root);
+    auto& rows(root->getChildren()[0]->getChildren());
+    CHECK(Context::app.onLoad(mlTemplate("[ [ [ a, 1 ] ] ]", "list")));
+    CHECK(Context::app.onLoad(mlTemplate("[ a ]", "caller")));
+    REQUIRE(root->getChildren()[1]->getChildren().size() == 1);
+    auto* caller(root->getChildren()[1]->getChildren()[0]);
+    auto onClick(Context::app.getActionTable(caller->actions).onClick);
+    auto x = [](const char* id) { return int(Context::app.getWidgets()[Context::strMng.search(id)]->box.pos.x); };
+    CHECK(Context::actions.execute(onClick, caller));
+    CHECK(x("a") == 77);
+
+    // 'a' is destroyed (its memory reused by other rows) and registered again as another widget
+    CHECK(Context::app.onLoad(mlTemplate("[ [ [ b, 2 ], [ c, 3 ] ] ]", "list")));
+    CHECK(Context::app.onLoad(mlTemplate("[ [ [ b, 2 ], [ c, 3 ], [ a, 4 ] ] ]", "list")));
+    REQUIRE(rows.size() == 3);
+    CHECK(x("a") == 4);
+    CHECK(Context::actions.execute(onClick, caller));
+    CHECK(x("a") == 77);
+    CHECK(x("b") == 2);
+    CHECK(x("c") == 3);
+}
+
+TEST_CASE("application: foreign widget destroyed", "[application]") {
+    ctx.initialize(false, false);
+    CHECK(Context::app.onLoad(mlApp(
+                                  "Application {"
+                                  _"  Template {"
+                                  _"    id: list"
+                                  _"    ["
+                                  _"      Widget {"
+                                  _"        id: @"
+                                  _"        x: @"
+                                  _"      }"
+                                  _"    ]"
+                                  _"  }"
+                                  _"  Template {"
+                                  _"    id: caller"
+                                  _"    Widget {"
+                                  _"      onClick: a.x = 77"
+                                  _"      onRender: roundedRect(a.x, 0, 10, 10, 1)"
+                                  _"    }"
+                                  _"  }"
+                                  _"}")));
+    auto root(Context::app.getRoot());
+    REQUIRE(root);
+    CHECK(Context::app.onLoad(mlTemplate("[ [ [ a, 1 ] ] ]", "list")));
+    CHECK(Context::app.onLoad(mlTemplate("[ ]", "caller")));
+    REQUIRE(root->getChildren()[1]->getChildren().size() == 1);
+    auto* caller(root->getChildren()[1]->getChildren()[0]);
+    const auto& table(Context::app.getActionTable(caller->actions));
+    auto x = [](const char* id) { return int(Context::app.getWidgets()[Context::strMng.search(id)]->box.pos.x); };
+    CHECK(Context::actions.execute<true>(table.onClick, caller)); // recodes a.x as foreign dispatch
+    CHECK(Context::actions.execute<true>(table.onRender, caller));
+    CHECK(Context::actions.execute(table.onClick, caller));
+    CHECK(x("a") == 77);
+    DisplayList list;
+    CHECK(Context::actions.addDependencies(table.onRender, caller, list));
+
+    // 'a' destroyed and its memory reused by other rows: the reference does not resolve
+    CHECK(Context::app.onLoad(mlTemplate("[ [ [ b, 2 ], [ c, 3 ] ] ]", "list")));
+    CHECK(!Context::actions.execute(table.onClick, caller));
+    CHECK(!list.valid(table.onRender, caller));
+    CHECK(x("b") == 2);
+    CHECK(x("c") == 3);
+
+    // registered again
+    CHECK(Context::app.onLoad(mlTemplate("[ [ [ b, 2 ], [ c, 3 ], [ a, 4 ] ] ]", "list")));
+    CHECK(x("a") == 4);
+    CHECK(Context::actions.execute(table.onClick, caller));
+    CHECK(x("a") == 77);
+    CHECK(x("b") == 2);
+    CHECK(x("c") == 3);
+}
+
 TEST_CASE("application: explicit parent dispatcher", "[application]") {
     ctx.initialize(false, false);
     CHECK(Context::app.onLoad(mlApp(
@@ -484,3 +1203,113 @@ TEST_CASE("application: explicit parent dispatcher", "[application]") {
     auto& actionTable(Context::app.getActionTable(chil2[0]->actions));
     CHECK(Context::actions.execute(actionTable.onClick, chil2[0]));
 }
+
+TEST_CASE("application: image", "[application]") {
+    ctx.initialize(false, false);
+    CHECK(Context::app.onLoad(mlApp(
+                                  "Application {"
+                                  _"  Widget {"
+                                  _"    define: Target"
+                                  _"    propInt16: value"
+                                  _"    value: 1111"
+                                  _"    propText: caption"
+                                  _"  }"
+                                  _"  Target {"
+                                  _"    id: target"
+                                  _"    caption: 'some text'"
+                                  _"  }"
+                                  _"  LayoutVer {"
+                                  _"    Widget {"
+                                  _"      onClick: [ target.value = 3333, x = 2.5 * 3, query(\"tree\", \"tree\") ]"
+                                  _"      onRender: text(x, y, \"label\")"
+                                  _"    }"
+                                  _"  }"
+                                  _"  Template {"
+                                  _"    define: Tree"
+                                  _"    ["
+                                  _"      Widget {"
+                                  _"        x: @"
+                                  _"      }"
+                                  _"    ]"
+                                  _"  }"
+                                  _"  Tree {"
+                                  _"    id: tree"
+                                  _"  }"
+                                  _"  Timer {"
+                                  _"    delay: 100"
+                                  _"    repeat: 1"
+                                  _"    onTimeout: target.value = 4444"
+                                  _"  }"
+                                  _"}")));
+    vector<char> image;
+    REQUIRE(Image::save(image));
+
+    // load in a clean application
+    ctx.initialize(false, false);
+    REQUIRE(Image::isImage(image.data(), image.size()));
+    CHECK(Context::app.onLoad(new RequestXHR(Identifier::Application, StringId(), image.data(), image.size())));
+    auto root(Context::app.getRoot());
+    REQUIRE(root);
+    auto& child(root->getChildren());
+    REQUIRE(child.size() == 4);
+    CHECK(child[0]->type() == Context::strMng.search("Target").getId());
+    CHECK(child[0]->getId() == Context::strMng.search("target"));
+    CHECK(Context::app.getWidgets()[Context::strMng.search("target")] == child[0]);
+    CHECK(child[1]->baseType() == Identifier::LayoutVer);
+    CHECK(child[3]->baseType() == Identifier::Timer);
+    auto valueId(Context::strMng.search("value").getId());
+    CHECK(child[0]->typeWidget->get(valueId, child[0]) == 1111);
+    auto caption((const char*)child[0]->typeWidget->get(Context::strMng.search("caption"), child[0]));
+    REQUIRE(caption);
+    CHECK(string(caption) == "some text");
+
+    // programs with relocated strings, texts and widgets
+    auto& button(child[1]->getChildren());
+    REQUIRE(button.size() == 1);
+    REQUIRE(button[0]->parent == child[1]);
+    auto& actionTable(Context::app.getActionTable(button[0]->actions));
+    CHECK(Context::actions.execute(actionTable.onRender, button[0]));
+    CHECK(Context::actions.execute(actionTable.onClick, button[0]));
+    CHECK(child[0]->typeWidget->get(valueId, child[0]) == 3333);
+    CHECK(button[0]->box.pos.x == 7.5f);
+    CHECK(Context::actions.execute(Context::app.getActionTable(child[3]->actions).onEnter, child[3]));
+    CHECK(child[0]->typeWidget->get(valueId, child[0]) == 4444);
+
+    // template definition keeps its parsed description
+    CHECK(Context::app.onLoad(mlTemplate("[ [ [ 111 ], [ 222 ] ] ]", "tree")));
+    auto& tpl(child[2]->getChildren());
+    REQUIRE(tpl.size() == 2);
+    CHECK(tpl[0]->box.pos.x == 111);
+    CHECK(tpl[1]->box.pos.x == 222);
+
+    // images from other layouts are rejected
+    image[4] ^= 1;
+    ctx.initialize(false, false);
+    CHECK(!Context::app.onLoad(new RequestXHR(Identifier::Application, StringId(), image.data(), image.size())));
+    image[4] ^= 1;
+
+    // truncated images are rejected without leaving anything behind
+    for (int n: { 40, int(image.size()) / 2, int(image.size()) - 1 }) {
+        ctx.initialize(false, false);
+        int commands(Context::actions.size());
+        CHECK(!Context::app.onLoad(new RequestXHR(Identifier::Application, StringId(), image.data(), n)));
+        CHECK(!Context::app.getRoot());
+        CHECK(Context::app.getWidgets().empty());
+        CHECK(Context::actions.size() == commands);
+    }
+
+    // corrupted counts (nWidgets and nCommands in the header) are rejected before allocating
+    for (int offset: { 20, 28 })
+        for (int32_t count: { -1, 0x7fffffff, 0x10000000 }) {
+            auto corrupted(image);
+            memcpy(&corrupted[offset], &count, sizeof(count));
+            ctx.initialize(false, false);
+            CHECK(!Context::app.onLoad(new RequestXHR(Identifier::Application, StringId(), corrupted.data(), corrupted.size())));
+            CHECK(Context::app.getWidgets().empty());
+        }
+
+    // the original image still loads
+    ctx.initialize(false, false);
+    CHECK(Context::app.onLoad(new RequestXHR(Identifier::Application, StringId(), image.data(), image.size())));
+    CHECK(Context::app.getRoot());
+}
@@ -0,0 +1,147 @@
+/*  -*- mode: c++; coding: utf-8; c-file-style: "stroustrup"; -*-
+
+    Contributors: Asier Aguirre
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include "catch.hpp"
+#include "http_cache.h"
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace webui;
+
+namespace {
+
+    HttpCache::Entry response(const char* headers, const char* body) {
+        // header lines separated by '|'
+        HttpCache::Entry entry;
+        string all(headers);
+        for (size_t pos = 0; pos <= all.size(); ) {
+            auto end(all.find('|', pos));
+            if (end == string::npos) end = all.size();
+            HttpCache::parseHeader(entry, all.substr(pos, end - pos));
+            pos = end + 1;
+        }
+        entry.body.assign(body, body + strlen(body));
+        return entry;
+    }
+
+    string body(const HttpCache::Entry* entry) {
+        return entry ? string(entry->body.begin(), entry->body.end()) : "(none)";
+    }
+
+    int countFiles(const string& dir) {
+        int n(0);
+        DIR* d(opendir(dir.c_str()));
+        while (auto* e = readdir(d)) n += e->d_name[0] != '.';
+        closedir(d);
+        return n;
+    }
+
+    string tempDir() {
+        char dir[] = "/tmp/nanoweb_cache_XXXXXX";
+        REQUIRE(mkdtemp(dir));
+        return dir;
+    }
+
+}
+
+TEST_CASE("http cache: revalidation", "[http_cache]") {
+    auto dir(tempDir());
+    {
+        HttpCache cache;
+        cache.setDirectory(dir);
+        CHECK(!cache.onResponse("http://h/a", 200, response("HTTP/1.1 200 OK|ETag: \"1\"", "body a")));
+        CHECK(!cache.onResponse("http://h/b", 200, response("HTTP/1.1 200 OK", "no validators")));
+        CHECK(cache.size() == 1);
+        CHECK(countFiles(dir) == 1);
+        REQUIRE(cache.find("http://h/a"));
+        CHECK(cache.find("http://h/a")->etag == "\"1\"");
+        // not modified: cached body
+        CHECK(body(cache.onResponse("http://h/a", 304, HttpCache::Entry())) == "body a");
+        CHECK(!cache.onResponse("http://h/b", 304, HttpCache::Entry()));
+    }
+    {
+        // from the directory
+        HttpCache cache;
+        cache.setDirectory(dir);
+        CHECK(cache.size() == 1);
+        CHECK(body(cache.onResponse("http://h/a", 304, HttpCache::Entry())) == "body a");
+        // left-over of an interrupted store is removed, the complete file is kept
+        FILE* f(fopen((dir + "/0000abcd.tmp").c_str(), "wb"));
+        REQUIRE(f);
+        fputs("http://h/x\n", f);
+        fclose(f);
+        HttpCache reopened;
+        reopened.setDirectory(dir);
+        CHECK(countFiles(dir) == 1);
+        CHECK(reopened.getBytes() == cache.getBytes());
+        cache.remove("http://h/a");
+        CHECK(countFiles(dir) == 0);
+    }
+    rmdir(dir.c_str());
+}
+
+TEST_CASE("http cache: no-store", "[http_cache]") {
+    auto dir(tempDir());
+    HttpCache cache;
+    cache.setDirectory(dir);
+    cache.onResponse("http://h/a", 200, response("HTTP/1.1 200 OK|Last-Modified: Mon, 1 Jan 2018 00:00:00 GMT", "v1"));
+    REQUIRE(cache.find("http://h/a"));
+
+    // the new version cannot be stored: the previous one is dropped too
+    auto entry(response("HTTP/1.1 200 OK|ETag: \"2\"|cache-control: max-age=0, No-Store", "v2"));
+    CHECK(entry.noStore);
+    CHECK(!entry.cacheable());
+    CHECK(!cache.onResponse("http://h/a", 200, move(entry)));
+    CHECK(!cache.find("http://h/a"));
+    CHECK(!cache.onResponse("http://h/a", 304, HttpCache::Entry()));
+    CHECK(countFiles(dir) == 0);
+
+    // no-cache is stored (every use is revalidated), look-alike directives are not no-store
+    CHECK(response("HTTP/1.1 200 OK|ETag: \"3\"|Cache-Control: no-cache", "").cacheable());
+    CHECK(response("HTTP/1.1 200 OK|ETag: \"3\"|Cache-Control: no-stored, x=no-store", "").cacheable());
+    // a redirection response does not leak its directives
+    CHECK(response("HTTP/1.1 302 Found|Cache-Control: no-store|HTTP/1.1 200 OK|ETag: \"3\"", "").cacheable());
+    rmdir(dir.c_str());
+}
+
+TEST_CASE("http cache: size limit", "[http_cache]") {
+    auto dir(tempDir());
+    {
+        HttpCache cache(100); // about two entries
+        cache.setDirectory(dir);
+        string body40(40 - 10 - 3 - 3, '.'); // url, etag and separators
+        cache.onResponse("http://h/1", 200, response("ETag: \"1\"", body40.c_str()));
+        cache.onResponse("http://h/2", 200, response("ETag: \"2\"", body40.c_str()));
+        CHECK(cache.getBytes() == 80);
+        CHECK(cache.find("http://h/1")); // most recent now
+        cache.onResponse("http://h/3", 200, response("ETag: \"3\"", body40.c_str()));
+        CHECK(cache.size() == 2);
+        CHECK(cache.getBytes() == 80);
+        CHECK(cache.find("http://h/1"));
+        CHECK(!cache.find("http://h/2"));
+        CHECK(countFiles(dir) == 2);
+
+        // larger than the cache
+        cache.onResponse("http://h/1", 200, response("ETag: \"4\"", string(200, '.').c_str()));
+        CHECK(!cache.find("http://h/1"));
+        CHECK(cache.size() == 1);
+    }
+    {
+        // the budget applies to the directory as well
+        HttpCache cache(30);
+        cache.setDirectory(dir);
+        CHECK(cache.size() == 0);
+        CHECK(countFiles(dir) == 0);
+    }
+    rmdir(dir.c_str());
+}
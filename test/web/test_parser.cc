@@ -8,6 +8,9 @@
 
 #include "catch.hpp"
 #include "ml_parser.h"
+#include "string_manager.h"
+#include "scan.h"
+#include <cctype>
 
 #define _ "\n"
 
@@ -232,3 +235,129 @@ TEST_CASE("parser: complex object properties", "[parser]") {
     CHECK(ml[2].next == 5);
     CHECK(ml[6].next == 11);
 }
+
+TEST_CASE("parser: level endings and token sizes", "[parser]") {
+    MLParser ml;
+    const char* str("A { a: f(x, y) + 1 * g(2)  b: (1 + 2) * 3  c: 'str'  [ B { } ] }");
+    REQUIRE(ml.parse(str, strlen(str)));
+    DUMP(ml.dumpTree());
+    REQUIRE(ml.size() == 20);
+    const int next[] = { 20, 2, 10, 4, 10, 10, 7, 10, 10, 10, 11, 16, 14, 14, 16, 16, 17, 18, 20, 20 };
+    const int size[] = { 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 5, 1, 1 };
+    for (int i = 0; i < ml.size(); i++) {
+        CHECK(ml[i].next == next[i]);
+        CHECK(ml.size(i) == size[i]);
+    }
+}
+
+TEST_CASE("parser: scan classes", "[parser]") {
+    // every char, both in the vector and in the scalar (tail) paths
+    char buffer[40];
+    for (int c = 0; c < 256; c++) {
+        memset(buffer, c, sizeof(buffer));
+        for (int n: { 32, 3 }) {
+            const char* end(buffer + n);
+            CHECK((scan::skipSpace(buffer, end) == end) == bool(isspace(c)));
+            CHECK((scan::skipId(buffer, end) == end) == (isalnum(c) || c == '_'));
+            CHECK((scan::skipDigits(buffer, end) == end) == bool(isdigit(c)));
+            CHECK((scan::findStringEnd(buffer, end, '"') == buffer) == (c == '"' || c == 0x1b || !c));
+        }
+    }
+}
+
+TEST_CASE("parser: long tokens", "[parser]") {
+    MLParser ml;
+    const char* str("[ identifier_longer_than_a_vector_of_chars0123456789,\t\t\t                   \n"
+                    "  // comment longer than a vector of chars\n"
+                    "  123456789012345678901234567890.123456789, \"a string longer than 16 chars with \x1b" "1\"34 escape\",\n"
+                    "  x                                                                                                 ]");
+    REQUIRE(ml.parse(str, strlen(str)));
+    DUMP(ml.dumpTree());
+    REQUIRE(ml.size() == 5);
+    CHECK(stringCompare("identifier_longer_than_a_vector_of_chars0123456789", ml[1].pos, ml.size(1)));
+    CHECK(ml[2].type() == MLParser::EntryType::Number);
+    CHECK(stringCompare("123456789012345678901234567890.123456789", ml[2].pos, ml.size(2)));
+    CHECK(ml[3].type() == MLParser::EntryType::String);
+    CHECK(stringCompare("\"a string longer than 16 chars with \x1b" "1\"34 escape\"", ml[3].pos, ml.size(3)));
+    CHECK(stringCompare("x", ml[4].pos, ml.size(4)));
+}
+
+TEST_CASE("parser: incremental", "[parser]") {
+    const char* docs[] = {
+        "[ [ a, 1, 'text ] with, \x1b" "1'34 brackets' ], // comment ] [ ,\n  f(x, y) + 2, #12345678, [ ] ]",
+        "data {\n  tree: [ [ [ 111 ], [ -222.5 ] ] ] // tree ]\n  value: 7\n  obj { a: \"}\" }\n  [ b: [ 1 ] ]\n  tree2: [ ]\n}\n",
+        "  12 + 3 ",
+    };
+    for (auto* doc: docs) {
+        MLParser ml;
+        REQUIRE(ml.parse(doc, strlen(doc)));
+        for (int chunk = 1; chunk < 8; chunk++) {
+            MLParser inc;
+            inc.begin();
+            for (int i = 0, n = strlen(doc); i < n; i += chunk)
+                REQUIRE(inc.feed(doc + i, min(chunk, n - i)));
+            REQUIRE(inc.end());
+            REQUIRE(inc.size() == ml.size());
+            for (int i = 0; i < ml.size(); i++) {
+                CHECK(inc[i].type() == ml[i].type());
+                CHECK(inc[i].next == ml[i].next);
+                CHECK(stringCompare(string(ml[i].pos, ml.size(i)).c_str(), inc[i].pos, inc.size(i)));
+            }
+        }
+    }
+    // rows of a nested list are parsed as they arrive (list still open)
+    {
+        const char* rows("data { tree: [ [ [ 1, a ], [ 2, b ], [ 3");
+        MLParser inc;
+        inc.begin();
+        REQUIRE(inc.feed(rows, strlen(rows)));
+        REQUIRE(inc.size() == 10);
+        CHECK(inc[3].type() == MLParser::EntryType::List);
+        CHECK(inc[3].next == 0);
+        CHECK(inc[4].next == 7);
+        CHECK(inc[7].next == 10);
+        CHECK(stringCompare("b", inc[9].pos, inc.size(9)));
+        REQUIRE(inc.feed(" ] ] ] }", 8));
+        REQUIRE(inc.end());
+        CHECK(inc.size() == 12);
+        CHECK(inc[3].next == 12);
+    }
+    // errors
+    const char* bad("[ a, b c ]");
+    MLParser inc;
+    inc.begin();
+    CHECK(!inc.feed(bad, strlen(bad)));
+    inc.begin();
+    CHECK(inc.feed(bad, 5));
+    CHECK(!inc.end());
+}
+
+TEST_CASE("string manager: interning", "[parser]") {
+    StringManager sm;
+    auto a(sm.add("zalpha"));
+    auto b(sm.add("zbeta", 5));
+    CHECK(sm.add("zalpha") == a);
+    CHECK(sm.add("zbetamax", 5) == b);
+    CHECK(sm.search("zbeta") == b);
+    CHECK(!sm.search("zbet").valid());
+    CHECK(!sm.search("zbetas").valid());
+    // force growth of the hash index
+    char buffer[16];
+    for (int i = 0; i < 5000; i++)
+        sm.add(buffer, snprintf(buffer, sizeof(buffer), "@%x", i));
+    CHECK(sm.search("@1f4") == sm.add("@1f4"));
+    CHECK(sm.search("zalpha") == a);
+    // reserved words are not interned
+    CHECK(sm.add("onRender").getId() == Identifier::onRender);
+    CHECK(sm.search("width", 5).getId() == Identifier::width);
+    CHECK(!strcmp(sm.get(Identifier::overscan), "overscan"));
+    CHECK(sm.search("Patch", 5).getId() == Identifier::Patch);
+    CHECK(!strcmp(sm.get(Identifier::move), "move"));
+    CHECK(sm.searchPrefix("onRenderA").getId() == Identifier::onRenderActive);
+    // sorted searches
+    CHECK(sm.searchNearest("zalphabet") == b);
+    CHECK(sm.searchPrefix("zalp") == a);
+    CHECK(!sm.searchPrefix("zgamma").valid());
+    auto g(sm.add("zgamma"));
+    CHECK(sm.searchPrefix("zgam") == g);
+}